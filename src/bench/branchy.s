@@ -0,0 +1,32 @@
+# Data-dependent branches on a xorshift32 sequence, 1M iterations.
+# Checksum in $v1.
+	.set noreorder
+	.text
+	li	$s0, 1000000
+	li	$s1, 2463534242		# xorshift state
+	li	$v1, 0
+loop:
+	sll	$t0, $s1, 13
+	xor	$s1, $s1, $t0
+	srl	$t0, $s1, 17
+	xor	$s1, $s1, $t0
+	sll	$t0, $s1, 5
+	xor	$s1, $s1, $t0
+	andi	$t1, $s1, 1
+	beq	$t1, $zero, even
+	addiu	$v1, $v1, 3
+	b	next
+even:
+	addiu	$v1, $v1, -1
+next:
+	andi	$t1, $s1, 6
+	bne	$t1, $zero, skip
+	xor	$v1, $v1, $s1
+skip:
+	bltz	$s1, negative
+	addiu	$v1, $v1, 1
+negative:
+	addiu	$s0, $s0, -1
+	bgtz	$s0, loop
+	addiu	$v0, $zero, 10
+	syscall
@@ -0,0 +1,41 @@
+# Walk a 4096-node linked list scattered over 4 MB, 1000 times.
+# Node j lives at 0x10010000 + 1028 * j as {next, value} and links
+# to node (5j + 1) mod 4096, which visits every node once per lap.
+# Checksum (sum of the values seen) in $v1.
+	.set noreorder
+	.text
+	lui	$s0, 0x1001
+	move	$t0, $zero		# j
+build:
+	sll	$t1, $t0, 10
+	sll	$t2, $t0, 2
+	addu	$t1, $t1, $t2
+	addu	$t1, $t1, $s0		# &node[j]
+	sll	$t3, $t0, 2
+	addu	$t3, $t3, $t0
+	addiu	$t3, $t3, 1
+	andi	$t3, $t3, 4095		# next index
+	sll	$t4, $t3, 10
+	sll	$t5, $t3, 2
+	addu	$t4, $t4, $t5
+	addu	$t4, $t4, $s0		# &node[next]
+	sw	$t4, 0($t1)
+	sw	$t0, 4($t1)
+	addiu	$t0, $t0, 1
+	slti	$t6, $t0, 4096
+	bne	$t6, $zero, build
+	li	$s1, 1000
+	li	$v1, 0
+lap:
+	move	$t0, $s0
+	li	$t1, 4096
+walk:
+	lw	$t2, 4($t0)
+	addu	$v1, $v1, $t2
+	lw	$t0, 0($t0)
+	addiu	$t1, $t1, -1
+	bgtz	$t1, walk
+	addiu	$s1, $s1, -1
+	bgtz	$s1, lap
+	addiu	$v0, $zero, 10
+	syscall
@@ -0,0 +1,20 @@
+# Tight ALU loop, 8 instructions per iteration.
+# Checksum in $v1.
+	.set noreorder
+	.text
+	li	$s0, 2000000
+	li	$s1, 0
+	li	$s2, 1
+	li	$s3, 0
+loop:
+	addu	$s1, $s1, $s2
+	sll	$t0, $s1, 3
+	xor	$s2, $s2, $t0
+	srl	$t1, $s2, 5
+	or	$s3, $s3, $t1
+	and	$s4, $s3, $s1
+	addiu	$s0, $s0, -1
+	bgtz	$s0, loop
+	addu	$v1, $s2, $s4
+	addiu	$v0, $zero, 10
+	syscall
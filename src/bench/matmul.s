@@ -0,0 +1,60 @@
+# 32x32 integer matrix multiply C = A * B, repeated 40 times.
+# A at 0x10010000, B at 0x10011000, C at 0x10012000, row-major.
+# Checksum (sum of C) in $v1.
+	.set noreorder
+	.text
+	lui	$s0, 0x1001
+	addiu	$s1, $s0, 0x1000
+	addiu	$s2, $s0, 0x2000
+	li	$t0, 1024
+	move	$t1, $s0
+	li	$t2, 7
+init:
+	sw	$t2, 0($t1)		# A[i] = 7 + 3i
+	addu	$t3, $t2, $t2
+	sw	$t3, 0x1000($t1)	# B[i] = 2 * A[i]
+	addiu	$t2, $t2, 3
+	addiu	$t1, $t1, 4
+	addiu	$t0, $t0, -1
+	bgtz	$t0, init
+	li	$s7, 40
+rep:
+	move	$s3, $zero		# i * 128
+	move	$s6, $s2		# &C[i][j]
+iloop:
+	move	$s4, $zero		# j * 4
+jloop:
+	addu	$t0, $s0, $s3		# &A[i][0]
+	addu	$t1, $s1, $s4		# &B[0][j]
+	li	$t2, 32
+	move	$t3, $zero
+kloop:
+	lw	$t4, 0($t0)
+	lw	$t5, 0($t1)
+	mult	$t4, $t5
+	mflo	$t6
+	addu	$t3, $t3, $t6
+	addiu	$t0, $t0, 4
+	addiu	$t1, $t1, 128
+	addiu	$t2, $t2, -1
+	bgtz	$t2, kloop
+	sw	$t3, 0($s6)
+	addiu	$s6, $s6, 4
+	addiu	$s4, $s4, 4
+	slti	$t7, $s4, 128
+	bne	$t7, $zero, jloop
+	addiu	$s3, $s3, 128
+	slti	$t7, $s3, 4096
+	bne	$t7, $zero, iloop
+	addiu	$s7, $s7, -1
+	bgtz	$s7, rep
+	move	$t0, $s2
+	addiu	$t3, $s2, 0x1000
+	li	$v1, 0
+sum:
+	lw	$t4, 0($t0)
+	addu	$v1, $v1, $t4
+	addiu	$t0, $t0, 4
+	bne	$t0, $t3, sum
+	addiu	$v0, $zero, 10
+	syscall
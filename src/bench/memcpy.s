@@ -0,0 +1,47 @@
+# Copy a 16 KB buffer word by word, then its first 1 KB byte by
+# byte, 500 times. Checksum (sum of the destination) in $v1.
+	.set noreorder
+	.text
+	lui	$s0, 0x1001		# source 0x10010000
+	lui	$s1, 0x1002		# destination 0x10020000
+	li	$t0, 4096
+	move	$t1, $s0
+	li	$t2, 0x9e3779b9
+fill:
+	sw	$t2, 0($t1)
+	addu	$t2, $t2, $t0
+	addiu	$t1, $t1, 4
+	addiu	$t0, $t0, -1
+	bgtz	$t0, fill
+	li	$s2, 500
+rep:
+	move	$t0, $s0
+	move	$t1, $s1
+	addiu	$t3, $s0, 16384
+words:
+	lw	$t4, 0($t0)
+	sw	$t4, 0($t1)
+	addiu	$t0, $t0, 4
+	addiu	$t1, $t1, 4
+	bne	$t0, $t3, words
+	move	$t0, $s0
+	addiu	$t1, $s1, 16384
+	addiu	$t3, $s0, 1024
+bytes:
+	lb	$t4, 0($t0)
+	sb	$t4, 0($t1)
+	addiu	$t0, $t0, 1
+	addiu	$t1, $t1, 1
+	bne	$t0, $t3, bytes
+	addiu	$s2, $s2, -1
+	bgtz	$s2, rep
+	move	$t0, $s1
+	addiu	$t3, $s1, 17408
+	li	$v1, 0
+sum:
+	lw	$t4, 0($t0)
+	addu	$v1, $v1, $t4
+	addiu	$t0, $t0, 4
+	bne	$t0, $t3, sum
+	addiu	$v0, $zero, 10
+	syscall
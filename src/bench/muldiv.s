@@ -0,0 +1,29 @@
+# Signed and unsigned multiply/divide, 1M iterations.
+# Checksum in $v1.
+	.set noreorder
+	.text
+	li	$s0, 1000000
+	li	$s1, 12345
+	li	$s2, -7
+	li	$v1, 0
+loop:
+	mult	$s1, $s2
+	mflo	$t0
+	multu	$s1, $s1
+	mfhi	$t1
+	addu	$v1, $v1, $t0
+	addu	$v1, $v1, $t1
+	div	$t0, $s2
+	mflo	$t2
+	mfhi	$t3
+	ori	$t4, $s0, 1
+	divu	$v1, $t4
+	mfhi	$t5
+	addu	$v1, $v1, $t2
+	xor	$v1, $v1, $t3
+	addu	$v1, $v1, $t5
+	addiu	$s1, $s1, 7
+	addiu	$s0, $s0, -1
+	bgtz	$s0, loop
+	addiu	$v0, $zero, 10
+	syscall
@@ -0,0 +1,101 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <sys/resource.h>
+
+#include "mu-mips.h"
+#include "mu-block.h"
+#include "mu-bench.h"
+
+/* kernel name: the file name without directory or extension */
+static void kernel_name(const char *path, char *name, size_t size)
+{
+	const char *base = strrchr(path, '/');
+	char *dot;
+
+	snprintf(name, size, "%s", base ? base + 1 : path);
+	if ((dot = strrchr(name, '.')) != NULL && dot != name) {
+		*dot = '\0';
+	}
+}
+
+static long peak_rss_kb()
+{
+	struct rusage usage;
+
+	if (getrusage(RUSAGE_SELF, &usage) != 0) {
+		return -1;
+	}
+	return usage.ru_maxrss;
+}
+
+/***************************************************************/
+/* Time one run of the program at path. Loading is not timed. */
+/* Returns FALSE if the program can't be loaded. */
+/***************************************************************/
+static int bench_run(const sim_context *config, char *path, uint32_t *instructions, double *seconds)
+{
+	sim_context *ctx = sim_create();
+	double start;
+	int loaded;
+
+	ctx->PROG_FORMAT = config->PROG_FORMAT;
+	ctx->ENGINE = config->ENGINE;
+	ctx->VERBOSITY = VERBOSITY_QUIET;
+	ctx->prog_file = path;
+
+	if ((loaded = load_program(ctx))) {
+		ctx->CURRENT_STATE.PC = ctx->PROGRAM_ENTRY;
+		ctx->NEXT_STATE = ctx->CURRENT_STATE;
+		ctx->RUN_FLAG = TRUE;
+
+		start = now_seconds();
+		runAll(ctx);
+		*seconds = now_seconds() - start;
+		*instructions = ctx->INSTRUCTION_COUNT;
+	}
+	sim_destroy(ctx);
+	return loaded;
+}
+
+/***************************************************************/
+/* Benchmark every program runs times with the engine and format */
+/* of config. Returns the number of programs that couldn't be run. */
+/***************************************************************/
+int run_benchmarks(const sim_context *config, char **programs, int num_programs, int runs)
+{
+	char name[64];
+	int failed = 0, i, r;
+
+	printf("kernel,engine,runs,instructions,best_s,mean_s,mips,ns_per_instr,peak_rss_kb\n");
+	for (i = 0; i < num_programs; i++) {
+		uint32_t instructions = 0;
+		double best = 0, total = 0, seconds;
+
+		for (r = 0; r < runs; r++) {
+			if (!bench_run(config, programs[i], &instructions, &seconds)) {
+				break;
+			}
+			if (r == 0 || seconds < best) {
+				best = seconds;
+			}
+			total += seconds;
+		}
+		if (r < runs) {
+			failed++;
+			continue;
+		}
+		if (best <= 0) {
+			best = 1e-9;
+		}
+
+		kernel_name(programs[i], name, sizeof(name));
+		printf("%s,%s,%d,%u,%.6f,%.6f,%.2f,%.3f,%ld\n", name,
+				engine_name(config->ENGINE), runs, instructions,
+				best, total / runs, instructions / best / 1e6, best * 1e9 / (instructions ? instructions : 1),
+				peak_rss_kb());
+		fflush(stdout);
+	}
+	return failed;
+}
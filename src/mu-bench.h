@@ -0,0 +1,17 @@
+#ifndef MU_BENCH_H
+#define MU_BENCH_H
+
+#include "mu-mips.h"
+
+/***************************************************************/
+/* Throughput harness. Runs each program to completion several */
+/* times with runAll() and prints one CSV row per program: */
+/* kernel,engine,runs,instructions,best_s,mean_s,mips,ns_per_instr,peak_rss_kb */
+/* mips and ns_per_instr come from the best run; peak_rss_kb is */
+/* the peak resident size of the whole process so far. */
+/***************************************************************/
+#define BENCH_DEFAULT_RUNS 5
+
+int run_benchmarks(const sim_context *config, char **programs, int num_programs, int runs);
+
+#endif
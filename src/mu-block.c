@@ -0,0 +1,373 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "mu-mips.h"
+#include "mu-block.h"
+#include "mu-jit.h"
+#include "mu-debug.h"
+#include "mu-cache.h"
+#include "mu-profile.h"
+#include "mu-trace.h"
+
+static const char* const ENGINE_NAMES[] = { "interp", "block", "jit" };
+
+const char* engine_name(int engine)
+{
+	return ENGINE_NAMES[engine];
+}
+
+/***************************************************************/
+/* Mark every block stale. Called when text is written; blocks */
+/* are freed the next time the engine is between blocks. */
+/***************************************************************/
+void block_cache_invalidate(sim_context *ctx)
+{
+	if (ctx->ALL_BLOCKS != NULL || ctx->BLOCK_MAP_SIZE != ctx->DECODE_CACHE_SIZE) {
+		ctx->BLOCKS_STALE = TRUE;
+		ctx->BLOCK_GENERATION++;
+	}
+}
+
+/***************************************************************/
+/* Free every translated block and resize the block map to the */
+/* decode cache. */
+/***************************************************************/
+void block_cache_flush(sim_context *ctx)
+{
+	block_stats_fold(ctx);
+	while (ctx->ALL_BLOCKS != NULL) {
+		block_t *next = ctx->ALL_BLOCKS->all_next;
+		free(ctx->ALL_BLOCKS);
+		ctx->ALL_BLOCKS = next;
+	}
+	jit_cache_reset(ctx);
+	if (ctx->BLOCK_MAP_SIZE != ctx->DECODE_CACHE_SIZE) {
+		free(ctx->BLOCK_MAP);
+		ctx->BLOCK_MAP = NULL;
+		ctx->BLOCK_MAP_SIZE = 0;
+		if (ctx->DECODE_CACHE_SIZE != 0) {
+			ctx->BLOCK_MAP = malloc(ctx->DECODE_CACHE_SIZE * sizeof(block_t *));
+			if (ctx->BLOCK_MAP == NULL) {
+				printf("Error: Can't allocate block map\n");
+				exit(-1);
+			}
+			ctx->BLOCK_MAP_SIZE = ctx->DECODE_CACHE_SIZE;
+		}
+	}
+	if (ctx->BLOCK_MAP != NULL) {
+		memset(ctx->BLOCK_MAP, 0, ctx->BLOCK_MAP_SIZE * sizeof(block_t *));
+	}
+	ctx->BLOCKS_STALE = FALSE;
+}
+
+/***************************************************************/
+/* Blocks count whole executions only; add those counts to the */
+/* per-op and per-PC statistics and clear them. */
+/***************************************************************/
+void block_stats_fold(sim_context *ctx)
+{
+	block_t *b;
+	uint32_t i;
+
+	for (b = ctx->ALL_BLOCKS; b != NULL; b = b->all_next) {
+		uint32_t index = (b->start_pc - MEM_TEXT_BEGIN) >> 2;
+
+		if (b->exec_count == 0) {
+			continue;
+		}
+		for (i = 0; i < b->num_instrs; i++) {
+			ctx->OP_COUNT[b->instrs[i].op] += b->exec_count;
+			if (index + i < ctx->DECODE_CACHE_SIZE) {
+				*stats_pc_count(ctx, index + i) += b->exec_count;
+			}
+		}
+		/* compiled code doesn't dispatch, so its runs fused nothing */
+		for (i = 0; b->num_fused != 0 && i < b->num_instrs; i += b->ops[i].length) {
+			if (b->ops[i].fusion >= 0) {
+				ctx->FUSED_COUNT[b->ops[i].fusion] += b->exec_count - b->jit_count;
+			}
+		}
+		ctx->NATIVE_COUNT += b->jit_count * b->num_instrs;
+		ctx->OP_REDIRECTS[b->instrs[b->num_instrs - 1].op] += b->exit_redirects;
+		b->exec_count = 0;
+		b->jit_count = 0;
+		b->exit_redirects = 0;
+	}
+}
+
+#if MU_STATS
+/* a block cut short or run unfused: count the instructions it did run one by one */
+static void block_count_partial(sim_context *ctx, block_t *b, uint32_t n, uint32_t next_pc, int native, int split)
+{
+	uint32_t index = (b->start_pc - MEM_TEXT_BEGIN) >> 2;
+	uint32_t i;
+
+	for (i = 0; i < n; i++) {
+		ctx->OP_COUNT[b->instrs[i].op]++;
+		if (index + i < ctx->DECODE_CACHE_SIZE) {
+			(*stats_pc_count(ctx, index + i))++;
+		}
+	}
+	if (native) {
+		ctx->NATIVE_COUNT += n;
+	}
+	/* a pair cut in two by the instruction limit ran unfused */
+	for (i = 0; !native && !split && b->num_fused != 0 && i + b->ops[i].length <= n; i += b->ops[i].length) {
+		if (b->ops[i].fusion >= 0) {
+			ctx->FUSED_COUNT[b->ops[i].fusion]++;
+		}
+	}
+	if (n != 0) {
+		ctx->OP_REDIRECTS[b->instrs[n - 1].op] += next_pc != b->start_pc + 4 * n;
+	}
+}
+#endif
+
+int ends_block(uint8_t op)
+{
+	switch (op) {
+		case OP_BEQ: case OP_BNE: case OP_BLEZ: case OP_BLTZ: case OP_BGEZ: case OP_BGTZ:
+		case OP_J: case OP_JR: case OP_JAL: case OP_JALR:
+		case OP_SYSCALL:
+			return TRUE;
+		default:
+			return FALSE;
+	}
+}
+
+/***************************************************************/
+/* Translate the block starting at pc. Returns NULL if pc is not */
+/* in decoded text. */
+/***************************************************************/
+static block_t* block_translate(sim_context *ctx, uint32_t pc)
+{
+	uint32_t index = (pc - MEM_TEXT_BEGIN) >> 2;
+	uint32_t n = 0;
+	block_t *b;
+
+	if ((pc & 3) != 0 || index >= ctx->BLOCK_MAP_SIZE) {
+		return NULL;
+	}
+	while (n < BLOCK_MAX_INSTRS && index + n < ctx->BLOCK_MAP_SIZE) {
+		if (n != 0 && ctx->DEBUG != NULL && debug_breakpoint(ctx->DEBUG, pc + 4 * n)) {
+			break;
+		}
+		n++;
+		if (ends_block(fetch_decoded(ctx, pc + 4 * (n - 1))->op)) {
+			break;
+		}
+	}
+
+	b = malloc(sizeof(block_t) + n * (sizeof(MIPS) + sizeof(block_op_t)));
+	if (b == NULL) {
+		printf("Error: Can't allocate translated block\n");
+		exit(-1);
+	}
+	b->start_pc = pc;
+	b->num_instrs = n;
+	b->succ_pc[0] = b->succ_pc[1] = 0;
+	b->succ[0] = b->succ[1] = NULL;
+	b->exec_count = b->jit_count = b->exit_redirects = 0;
+	b->num_fused = 0;
+	b->heat = 0;
+	b->jit = NULL;
+	b->ops = (block_op_t *)&b->instrs[n];
+	for (index = 0; index < n; index++) {
+		b->instrs[index] = *fetch_decoded(ctx, pc + 4 * index);
+		b->ops[index].handler = EXEC_TABLE[b->instrs[index].op];
+		b->ops[index].length = 1;
+		b->ops[index].fusion = -1;
+	}
+#if MU_FUSE
+	/* pair up greedily from the start of the block; not while */
+	/* debugging, so that a watchpoint stops between the two */
+	for (index = 0; ctx->DEBUG == NULL && index + 1 < n; index += b->ops[index].length) {
+		int fusion = find_fusion(b->instrs[index].op, b->instrs[index + 1].op);
+
+		if (fusion >= 0) {
+			b->ops[index].handler = FUSION_TABLE[fusion].handler;
+			b->ops[index].length = 2;
+			b->ops[index].fusion = fusion;
+			b->num_fused++;
+		}
+	}
+#endif
+
+	b->all_next = ctx->ALL_BLOCKS;
+	ctx->ALL_BLOCKS = b;
+	ctx->BLOCK_MAP[(pc - MEM_TEXT_BEGIN) >> 2] = b;
+	ctx->BLOCKS_TRANSLATED++;
+	return b;
+}
+
+static block_t* block_lookup(sim_context *ctx, uint32_t pc)
+{
+	uint32_t index = (pc - MEM_TEXT_BEGIN) >> 2;
+
+	if ((pc & 3) == 0 && index < ctx->BLOCK_MAP_SIZE && ctx->BLOCK_MAP[index] != NULL) {
+		return ctx->BLOCK_MAP[index];
+	}
+	return block_translate(ctx, pc);
+}
+
+/***************************************************************/
+/* Follow (or create) the chain from b to the block at pc. */
+/***************************************************************/
+static block_t* block_chain(sim_context *ctx, block_t *b, uint32_t pc)
+{
+	int slot;
+
+	if (b->succ[0] != NULL && b->succ_pc[0] == pc) {
+		return b->succ[0];
+	}
+	if (b->succ[1] != NULL && b->succ_pc[1] == pc) {
+		return b->succ[1];
+	}
+	slot = (pc == b->start_pc + 4 * b->num_instrs) ? 0 : 1;
+	b->succ_pc[slot] = pc;
+	b->succ[slot] = block_lookup(ctx, pc);
+	return b->succ[slot];
+}
+
+/***************************************************************/
+/* Run the first n instructions of b for the recorder: one at a */
+/* time, fused pairs split, so each gets its record. Stops where */
+/* the handler loop would. Returns how many ran, with the next */
+/* PC in CURRENT_STATE. */
+/***************************************************************/
+static __attribute__((noinline)) uint32_t run_recorded(sim_context *ctx, block_t *b, uint32_t n, uint32_t generation)
+{
+	CPU_State *s = &ctx->CURRENT_STATE;
+	uint32_t pc = b->start_pc;
+	uint32_t i;
+
+	for (i = 0; i < n; ) {
+		const MIPS *instr = &b->instrs[i];
+		trace_record_t *record = trace_begin(ctx, instr, pc);
+
+		s->PC = pc;
+		pc = EXEC_TABLE[instr->op](ctx, s, instr);
+		s->REGS[0] = 0;
+		trace_end(ctx, instr, record);
+		i++;
+		if (generation != ctx->BLOCK_GENERATION) {
+			break;
+		}
+	}
+	s->PC = pc;
+	return i;
+}
+
+/***************************************************************/
+/* Execute up to max_instrs instructions from ctx->CURRENT_STATE.PC, */
+/* block at a time. Code outside decoded text is interpreted. */
+/* Returns the number of instructions executed. */
+/***************************************************************/
+uint32_t run_blocks(sim_context *ctx, uint32_t max_instrs)
+{
+	CPU_State *s = &ctx->CURRENT_STATE;
+	uint32_t executed = 0;
+	block_t *b = NULL;
+
+	ctx->CURRENT_STATE = ctx->NEXT_STATE;
+	if (ctx->BLOCKS_STALE || ctx->BLOCK_MAP_SIZE != ctx->DECODE_CACHE_SIZE) {
+		block_cache_flush(ctx);
+	}
+
+	while (ctx->RUN_FLAG && executed < max_instrs) {
+		if (ctx->BLOCKS_STALE) {
+			block_cache_flush(ctx);
+			b = NULL;
+		}
+		if (ctx->DEBUG != NULL && debug_stop_at(ctx, s->PC)) {
+			break;
+		}
+		if (b == NULL && (b = block_lookup(ctx, s->PC)) == NULL) {
+			ctx->NEXT_STATE = ctx->CURRENT_STATE;
+			cycle(ctx);
+			executed++;
+			continue;
+		}
+
+#if MU_JIT
+		if (ctx->ENGINE == ENGINE_JIT && b->jit == NULL && ++b->heat == JIT_THRESHOLD) {
+			jit_compile(ctx, b);
+		}
+#endif
+
+		uint32_t generation = ctx->BLOCK_GENERATION;
+		uint32_t pc = b->start_pc;
+		uint32_t n = b->num_instrs;
+		uint32_t i, length;
+		int native;
+
+		if (n > max_instrs - executed) {
+			n = max_instrs - executed;
+		}
+		/* the compiled code doesn't stop for the recorder, so recorded blocks use the handlers */
+		native = b->jit != NULL && n == b->num_instrs && ctx->ENGINE == ENGINE_JIT && ctx->RECORDER == NULL;
+		if (ctx->CACHES != NULL) {
+			ctx->CACHES->fetch_pc = pc;
+		}
+		if (native) {
+			pc = b->jit(ctx, s, &i);
+		}
+		else if (__builtin_expect(ctx->RECORDER != NULL, 0)) {
+			i = run_recorded(ctx, b, n, generation);
+			pc = s->PC;
+		}
+		else {
+			for (i = 0; i < n; i += length) {
+				mips_handler_t handler = b->ops[i].handler;
+
+				length = b->ops[i].length;
+				if (length > n - i) {
+					/* the limit falls inside a fused pair: run its first half alone */
+					handler = EXEC_TABLE[b->instrs[i].op];
+					length = 1;
+				}
+				s->PC = pc;
+				pc = handler(ctx, s, &b->instrs[i]);
+				s->REGS[0] = 0;
+				if (generation != ctx->BLOCK_GENERATION) {
+					/* this block just rewrote translated text */
+					i += length;
+					break;
+				}
+			}
+		}
+		s->PC = pc;
+		if (ctx->CACHES != NULL && !cache_fetch_hit(ctx->CACHES, b->start_pc + 4 * i)) {
+			/* whatever the loads and stores have not fetched yet */
+			cache_fetch(ctx->CACHES, b->start_pc + 4 * i);
+		}
+		if (ctx->PROFILER != NULL && i != 0) {
+			profile_block(ctx, b->start_pc, i, &b->instrs[i - 1], pc);
+		}
+		executed += i;
+		ctx->INSTRUCTION_COUNT += i;
+		ctx->BLOCKS_EXECUTED++;
+#if MU_STATS
+		if (i == b->num_instrs && ctx->RECORDER == NULL) {
+			b->exec_count++;
+			b->jit_count += native;
+			b->exit_redirects += pc != b->start_pc + 4 * i;
+		}
+		else {
+			block_count_partial(ctx, b, i, pc, native, ctx->RECORDER != NULL);
+		}
+#endif
+
+		if (i < b->num_instrs || generation != ctx->BLOCK_GENERATION) {
+			b = NULL;
+		}
+		else {
+			b = block_chain(ctx, b, pc);
+		}
+	}
+
+	ctx->NEXT_STATE = ctx->CURRENT_STATE;
+	return executed;
+}
@@ -0,0 +1,54 @@
+#ifndef MU_BLOCK_H
+#define MU_BLOCK_H
+
+#include "mu-mips.h"
+
+/***************************************************************/
+/* Basic-block translation cache. */
+/* The text segment is split into blocks that end at a branch, */
+/* jump or SYSCALL. Each block is translated once into an array */
+/* of pre-bound handler calls, and remembers the blocks it last */
+/* exited to so the next block is found without a lookup. Common */
+/* pairs of adjacent instructions are fused into one call. */
+/***************************************************************/
+#define ENGINE_INTERP 0	/* reference interpreter: cycle() per instruction */
+#define ENGINE_BLOCK  1	/* translated basic blocks */
+#define ENGINE_JIT    2	/* blocks, hot ones compiled to x86-64 (mu-jit.c) */
+
+#define BLOCK_MAX_INSTRS 256
+
+/* one dispatch: a single instruction, or a fused pair (FUSION_TABLE) */
+typedef struct {
+	mips_handler_t handler;
+	uint8_t length;			/* instructions it runs */
+	int8_t fusion;			/* FUSION_TABLE index, -1 if not fused */
+} block_op_t;
+
+struct block_struct;
+/* native code for a block: returns the next PC and sets executed */
+typedef uint32_t (*jit_code_t)(sim_context *ctx, CPU_State *s, uint32_t *executed);
+
+typedef struct block_struct {
+	uint32_t start_pc;
+	uint32_t num_instrs;
+	uint32_t succ_pc[2];			/* chained successors: [0] fall-through, [1] other */
+	struct block_struct *succ[2];
+	struct block_struct *all_next;	/* list of every translated block */
+	uint64_t exec_count;			/* complete executions, not yet in the stats (MU_STATS) */
+	uint64_t jit_count;			/* of those, runs of the compiled code */
+	uint64_t exit_redirects;		/* of those, exits not to start_pc + 4 * num_instrs */
+	uint32_t num_fused;			/* fused pairs among the ops */
+	uint32_t heat;				/* executions counted toward JIT_THRESHOLD */
+	jit_code_t jit;				/* compiled code, or NULL */
+	block_op_t *ops;			/* [num_instrs], indexed by instruction; the second of a pair is skipped */
+	MIPS instrs[];
+} block_t;
+
+const char* engine_name(int engine);
+int ends_block(uint8_t op);
+void block_cache_invalidate(sim_context *ctx);
+void block_cache_flush(sim_context *ctx);
+void block_stats_fold(sim_context *ctx);
+uint32_t run_blocks(sim_context *ctx, uint32_t max_instrs);
+
+#endif
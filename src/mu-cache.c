@@ -0,0 +1,496 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "mu-mips.h"
+#include "mu-cache.h"
+
+static const char* const CACHE_NAMES[NUM_CACHES] = { "L1I", "L1D", "L2" };
+
+static int is_power_of_two(uint32_t n)
+{
+	return n != 0 && (n & (n - 1)) == 0;
+}
+
+static int log2_of(uint32_t n)
+{
+	int bits = 0;
+	while ((1u << bits) < n) {
+		bits++;
+	}
+	return bits;
+}
+
+/* a byte count with an optional k or m suffix, 0 if malformed */
+static uint32_t parse_size(const char *text)
+{
+	char *end;
+	unsigned long n = strtoul(text, &end, 0);
+
+	if (*end == 'k' || *end == 'K') {
+		n <<= 10;
+		end++;
+	}
+	else if (*end == 'm' || *end == 'M') {
+		n <<= 20;
+		end++;
+	}
+	return *end == '\0' && n <= UINT32_MAX ? n : 0;
+}
+
+/***************************************************************/
+/* Size the tag arrays of an enabled cache and empty it. */
+/***************************************************************/
+static void cache_build(cache_t *c)
+{
+	uint32_t lines = c->size / c->line;
+
+	free(c->tag);
+	free(c->dirty);
+	free(c->stamp);
+	free(c->plru);
+	free(c->mru);
+	c->line_bits = log2_of(c->line);
+	c->set_mask = lines / c->ways - 1;
+	c->tag = malloc(lines * sizeof(uint32_t));
+	c->dirty = malloc(lines);
+	c->stamp = malloc(lines * sizeof(uint64_t));
+	c->plru = malloc((c->set_mask + 1) * sizeof(uint64_t));
+	c->mru = malloc((c->set_mask + 1) * sizeof(uint32_t));
+	if (c->tag == NULL || c->dirty == NULL || c->stamp == NULL || c->plru == NULL || c->mru == NULL) {
+		printf("Error: Can't allocate cache tags\n");
+		exit(-1);
+	}
+}
+
+/***************************************************************/
+/* Set up one level from "<size>:<ways>:<line>" followed by any of */
+/* lru, plru, random, wb, wt and a latency in cycles. Returns */
+/* FALSE, leaving the level alone, if the geometry is impossible. */
+/***************************************************************/
+static int cache_parse_level(cache_t *c, char *fields, char **save)
+{
+	cache_t config = *c;
+	char *token;
+	int n = 0;
+
+	config.enabled = TRUE;
+	config.replacement = CACHE_LRU;
+	config.write_back = TRUE;
+	config.latency = 0;
+	for (token = fields; token != NULL; token = strtok_r(NULL, ":", save), n++) {
+		if (n == 0) {
+			config.size = parse_size(token);
+		}
+		else if (n == 1) {
+			config.ways = strtoul(token, NULL, 0);
+		}
+		else if (n == 2) {
+			config.line = parse_size(token);
+		}
+		else if (!strcmp(token, "lru")) {
+			config.replacement = CACHE_LRU;
+		}
+		else if (!strcmp(token, "plru")) {
+			config.replacement = CACHE_PLRU;
+		}
+		else if (!strcmp(token, "random")) {
+			config.replacement = CACHE_RANDOM;
+		}
+		else if (!strcmp(token, "wb")) {
+			config.write_back = TRUE;
+		}
+		else if (!strcmp(token, "wt")) {
+			config.write_back = FALSE;
+		}
+		else if (token[0] >= '0' && token[0] <= '9') {
+			config.latency = strtoul(token, NULL, 0);
+		}
+		else {
+			return FALSE;
+		}
+	}
+	if (n < 3 || !is_power_of_two(config.line) || config.line < 4
+			|| config.ways == 0 || config.ways > CACHE_MAX_WAYS
+			|| config.size % (config.ways * config.line) != 0
+			|| !is_power_of_two(config.size / (config.ways * config.line))
+			|| (config.replacement == CACHE_PLRU && !is_power_of_two(config.ways))) {
+		return FALSE;
+	}
+	*c = config;
+	cache_build(c);
+	return TRUE;
+}
+
+/***************************************************************/
+/* Configure the hierarchy from one spec: */
+/*   on            16k 4-way 32-byte L1I and L1D, no L2 */
+/*   off           no cache model */
+/*   l1i|l1d|l2:<size>:<ways>:<line>[:lru|plru|random][:wb|wt][:<latency>] */
+/*   l1i|l1d|l2:off */
+/*   mem:<latency> */
+/* Specs add to what is configured already. Returns FALSE for a */
+/* bad spec. Changing anything empties every cache. */
+/***************************************************************/
+int cache_configure(sim_context *ctx, const char *spec)
+{
+	cache_hierarchy_t *h = ctx->CACHES;
+	char buffer[128], *name, *fields, *save;
+	int level, ok = TRUE;
+
+	if (!strcmp(spec, "off")) {
+		cache_free(h);
+		ctx->CACHES = NULL;
+		return TRUE;
+	}
+	if (h == NULL) {
+		h = calloc(1, sizeof(cache_hierarchy_t));
+		if (h == NULL) {
+			printf("Error: Can't allocate cache model\n");
+			exit(-1);
+		}
+		h->memory_latency = CACHE_DEFAULT_MEMORY_LATENCY;
+	}
+
+	snprintf(buffer, sizeof(buffer), "%s", spec);
+	name = strtok_r(buffer, ":", &save);
+	fields = strtok_r(NULL, ":", &save);
+	if (name == NULL) {
+		ok = FALSE;
+	}
+	else if (!strcmp(name, "on") && fields == NULL) {
+		char l1i[] = "16k:4:32", l1d[] = "16k:4:32";
+		char *unused;
+		cache_parse_level(&h->level[CACHE_L1I], strtok_r(l1i, ":", &unused), &unused);
+		cache_parse_level(&h->level[CACHE_L1D], strtok_r(l1d, ":", &unused), &unused);
+	}
+	else if (!strcmp(name, "mem") && fields != NULL) {
+		h->memory_latency = strtoul(fields, NULL, 0);
+	}
+	else {
+		for (level = 0; level < NUM_CACHES && strcasecmp(name, CACHE_NAMES[level]); level++);
+		if (level == NUM_CACHES || fields == NULL) {
+			ok = FALSE;
+		}
+		else if (!strcmp(fields, "off")) {
+			h->level[level].enabled = FALSE;
+		}
+		else {
+			ok = cache_parse_level(&h->level[level], fields, &save);
+		}
+	}
+
+	if (!ok) {
+		if (ctx->CACHES == NULL) {
+			cache_free(h);
+		}
+		return FALSE;
+	}
+	ctx->CACHES = h;
+	cache_reset(h);
+	return TRUE;
+}
+
+/***************************************************************/
+/* Empty every cache and zero the counts, keeping the config. */
+/***************************************************************/
+void cache_reset(cache_hierarchy_t *h)
+{
+	uint32_t lines, set;
+	int i;
+
+	for (i = 0; i < NUM_CACHES; i++) {
+		cache_t *c = &h->level[i];
+		if (c->tag == NULL) {
+			continue;
+		}
+		lines = c->size / c->line;
+		memset(c->tag, 0xFF, lines * sizeof(uint32_t));
+		memset(c->dirty, 0, lines);
+		memset(c->stamp, 0, lines * sizeof(uint64_t));
+		memset(c->plru, 0, (c->set_mask + 1) * sizeof(uint64_t));
+		c->clock = 0;
+		c->random = 2463534242u;
+		for (set = 0; set <= c->set_mask; set++) {
+			c->mru[set] = set * c->ways;
+		}
+		c->reads = c->writes = 0;
+		c->read_misses = c->write_misses = 0;
+		c->writebacks = 0;
+	}
+	h->memory_reads = h->memory_writes = 0;
+	h->stall_cycles = 0;
+	h->instructions = 0;
+}
+
+void cache_free(cache_hierarchy_t *h)
+{
+	int i;
+
+	if (h == NULL) {
+		return;
+	}
+	for (i = 0; i < NUM_CACHES; i++) {
+		free(h->level[i].tag);
+		free(h->level[i].dirty);
+		free(h->level[i].stamp);
+		free(h->level[i].plru);
+		free(h->level[i].mru);
+	}
+	free(h);
+}
+
+/***************************************************************/
+/* Replacement state. A PLRU tree bit of 1 says the victim is */
+/* in the upper half below that node. */
+/***************************************************************/
+static void cache_touch(cache_t *c, uint32_t set, uint32_t way)
+{
+	uint32_t node = 1;
+	int level;
+
+	if (c->replacement == CACHE_LRU) {
+		c->stamp[set * c->ways + way] = ++c->clock;
+	}
+	else if (c->replacement == CACHE_PLRU) {
+		for (level = c->ways > 1 ? log2_of(c->ways) - 1 : -1; level >= 0; level--) {
+			uint32_t upper = (way >> level) & 1;
+			if (upper) {
+				c->plru[set] &= ~(1ull << node);
+			}
+			else {
+				c->plru[set] |= 1ull << node;
+			}
+			node = 2 * node + upper;
+		}
+	}
+}
+
+static uint32_t cache_victim(cache_t *c, uint32_t set)
+{
+	uint32_t base = set * c->ways;
+	uint32_t way, victim = 0, node = 1;
+	int level;
+
+	for (way = 0; way < c->ways; way++) {
+		if (c->tag[base + way] == CACHE_NO_LINE) {
+			return way;
+		}
+	}
+	switch (c->replacement) {
+		case CACHE_PLRU:
+			for (level = log2_of(c->ways) - 1; level >= 0; level--) {
+				uint32_t upper = (c->plru[set] >> node) & 1;
+				victim = 2 * victim + upper;
+				node = 2 * node + upper;
+			}
+			return victim;
+		case CACHE_RANDOM:
+			c->random ^= c->random << 13;
+			c->random ^= c->random >> 17;
+			c->random ^= c->random << 5;
+			return c->random % c->ways;
+		default:
+			for (way = 1; way < c->ways; way++) {
+				if (c->stamp[base + way] < c->stamp[base + victim]) {
+					victim = way;
+				}
+			}
+			return victim;
+	}
+}
+
+static inline uint32_t cache_access(cache_hierarchy_t *h, int level, uint32_t address, int write);
+
+/* the level below level */
+static uint32_t cache_next(cache_hierarchy_t *h, int level, uint32_t address, int write)
+{
+	if (level != CACHE_L2 && h->level[CACHE_L2].enabled) {
+		return cache_access(h, CACHE_L2, address, write);
+	}
+	if (write) {
+		h->memory_writes++;
+	}
+	else {
+		h->memory_reads++;
+	}
+	return h->memory_latency;
+}
+
+/* cache_access() past the way its set used last */
+static uint32_t cache_lookup(cache_hierarchy_t *h, int level, uint32_t address, int write)
+{
+	cache_t *c = &h->level[level];
+	uint32_t line = address >> c->line_bits;
+	uint32_t set = line & c->set_mask;
+	uint32_t base = set * c->ways;
+	uint32_t way, slot = c->mru[set];
+
+	if (c->tag[slot] != line) {
+		for (way = 0; way < c->ways && c->tag[base + way] != line; way++);
+		if (way == c->ways) {
+			goto miss;
+		}
+		slot = base + way;
+		cache_touch(c, set, way);
+		c->mru[set] = slot;
+	}
+	if (write) {
+		if (c->write_back) {
+			c->dirty[slot] = TRUE;
+		}
+		else {
+			cache_next(h, level, address, TRUE);
+		}
+	}
+	return c->latency;
+
+miss:
+	if (write) {
+		c->write_misses++;
+		if (!c->write_back) {
+			cache_next(h, level, address, TRUE);
+			return c->latency;
+		}
+	}
+	else {
+		c->read_misses++;
+	}
+	way = cache_victim(c, set);
+	slot = base + way;
+	if (c->tag[slot] != CACHE_NO_LINE && c->dirty[slot]) {
+		c->writebacks++;
+		cache_next(h, level, c->tag[slot] << c->line_bits, TRUE);
+	}
+	/* the fill */
+	c->tag[slot] = line;
+	c->dirty[slot] = write;
+	cache_touch(c, set, way);
+	c->mru[set] = slot;
+	return c->latency + cache_next(h, level, address, FALSE);
+}
+
+/***************************************************************/
+/* Look address up at level and below, updating their contents. */
+/* Returns the cycles it takes. A read or write-back hit on the */
+/* way its set used last is settled here: that way is already the */
+/* most recent, so touching it again would not change the */
+/* replacement order. */
+/***************************************************************/
+static inline uint32_t cache_access(cache_hierarchy_t *h, int level, uint32_t address, int write)
+{
+	cache_t *c = &h->level[level];
+	uint32_t line, slot;
+
+	if (!c->enabled) {
+		return cache_next(h, level, address, write);
+	}
+	if (write) {
+		c->writes++;
+	}
+	else {
+		c->reads++;
+	}
+	line = address >> c->line_bits;
+	slot = c->mru[line & c->set_mask];
+	if (c->tag[slot] == line && (!write || c->write_back)) {
+		if (write) {
+			c->dirty[slot] = TRUE;
+		}
+		return c->latency;
+	}
+	return cache_lookup(h, level, address, write);
+}
+
+/***************************************************************/
+/* Fetch the instructions from h->fetch_pc up to end. After the */
+/* first word of a line the rest hit that line, which is what */
+/* looking each of them up would find. Returns the stall cycles. */
+/***************************************************************/
+uint32_t cache_fetch(cache_hierarchy_t *h, uint32_t end)
+{
+	cache_t *c = &h->level[CACHE_L1I];
+	uint32_t pc = h->fetch_pc, cycles = 0, bytes, words;
+
+	if (pc >= end) {
+		return 0;
+	}
+	h->instructions += (end - pc) >> 2;
+	while (pc < end) {
+		cycles += cache_access(h, CACHE_L1I, pc, FALSE);
+		if (!c->enabled) {
+			pc += 4;
+			continue;
+		}
+		/* the words after pc that are left in its line */
+		bytes = (((pc >> c->line_bits) + 1) << c->line_bits) - pc;
+		if (bytes > end - pc) {
+			bytes = end - pc;
+		}
+		words = (bytes - 1) / 4;
+		c->reads += words;
+		cycles += words * c->latency;
+		pc += 4 * (words + 1);
+	}
+	h->fetch_pc = end;
+	h->stall_cycles += cycles;
+	return cycles;
+}
+
+/***************************************************************/
+/* A load or store to address by the instruction at pc. With an */
+/* L2 behind both L1s, the fetches up to pc go first, so the L2 */
+/* sees them in order; otherwise the two streams never meet, and */
+/* the fetches are left to the end of the block. Returns the stall */
+/* cycles. */
+/***************************************************************/
+uint32_t cache_data(cache_hierarchy_t *h, uint32_t pc, uint32_t address, int write)
+{
+	uint32_t cycles = h->level[CACHE_L2].enabled ? cache_fetch(h, pc + 4) : 0;
+	uint32_t data = cache_access(h, CACHE_L1D, address, write);
+
+	h->stall_cycles += data;
+	return cycles + data;
+}
+
+static double percent_of(uint64_t part, uint64_t whole)
+{
+	return whole ? 100.0 * part / whole : 0.0;
+}
+
+/***************************************************************/
+/* Print the configuration, hit and miss counts of each cache. */
+/***************************************************************/
+void cache_report(sim_context *ctx)
+{
+	const cache_hierarchy_t *h = ctx->CACHES;
+	int i;
+
+	if (h == NULL) {
+		return;
+	}
+	printf("-------------------------------------\n");
+	printf("Caches\n");
+	printf("-------------------------------------\n");
+	for (i = 0; i < NUM_CACHES; i++) {
+		const cache_t *c = &h->level[i];
+		uint64_t accesses = c->reads + c->writes, misses = c->read_misses + c->write_misses;
+		if (!c->enabled) {
+			continue;
+		}
+		printf("%s\t: %uK, %u-way, %u-byte lines, %s, %s, %u cycles\n", CACHE_NAMES[i], c->size >> 10, c->ways, c->line,
+				c->replacement == CACHE_LRU ? "LRU" : c->replacement == CACHE_PLRU ? "PLRU" : "random",
+				c->write_back ? "write-back" : "write-through", c->latency);
+		printf("  accesses %llu, misses %llu (%.2f%%: reads %llu, writes %llu), writebacks %llu\n",
+				(unsigned long long)accesses, (unsigned long long)misses, percent_of(misses, accesses),
+				(unsigned long long)c->read_misses, (unsigned long long)c->write_misses,
+				(unsigned long long)c->writebacks);
+	}
+	printf("Memory\t: %u cycles, %llu reads, %llu writes\n", h->memory_latency,
+			(unsigned long long)h->memory_reads, (unsigned long long)h->memory_writes);
+	printf("-------------------------------------\n");
+	printf("Stall cycles\t: %llu (%.3f per instruction)\n", (unsigned long long)h->stall_cycles,
+			h->instructions ? (double)h->stall_cycles / h->instructions : 0.0);
+	printf("-------------------------------------\n");
+}
@@ -0,0 +1,150 @@
+#ifndef MU_CACHE_H
+#define MU_CACHE_H
+
+#include "mu-mips.h"
+
+/***************************************************************/
+/* Cache hierarchy model: split L1 instruction and data caches, */
+/* an optional unified L2, then memory. Like the pipeline model it */
+/* only keeps time: each executed instruction's fetch, and its */
+/* load or store, are looked up, and the latency of every level */
+/* visited is charged as stall cycles. */
+/* */
+/* Every engine drives it. Loads and stores are charged by their */
+/* handlers and by compiled code, which settle a hit on the way */
+/* its L1D set used last inline (cache_data_hit) and only call */
+/* cache_data() for anything else. The block engine fetches a */
+/* block's instructions lazily, up to each load or store and then */
+/* the rest when the block ends (settling MRU lines inline too, in */
+/* cache_fetch_hit), so the caches see the same accesses in the */
+/* same order as under the interpreter. */
+/* */
+/* Write-back caches allocate on a write miss; write-through ones */
+/* do not. Writes that go down a level (write-through and dirty */
+/* evictions) are assumed to sit in a write buffer, so they are */
+/* counted but not charged. */
+/* */
+/* Tags are kept structure-of-arrays: the tags of a set sit next */
+/* to each other, apart from the dirty bits and replacement state. */
+/***************************************************************/
+#define CACHE_L1I 0
+#define CACHE_L1D 1
+#define CACHE_L2  2
+#define NUM_CACHES 3
+
+#define CACHE_LRU    0
+#define CACHE_PLRU   1	/* tree pseudo-LRU, needs a power of two ways */
+#define CACHE_RANDOM 2
+
+#define CACHE_MAX_WAYS 64
+#define CACHE_NO_LINE 0xFFFFFFFFu	/* tag of an empty way */
+#define CACHE_DEFAULT_MEMORY_LATENCY 100
+
+typedef struct {
+	/* configuration */
+	int enabled;
+	uint32_t size, ways, line;	/* bytes, ways, bytes */
+	int replacement;		/* CACHE_LRU, CACHE_PLRU, CACHE_RANDOM */
+	int write_back;
+	uint32_t latency;		/* cycles charged for looking here */
+
+	uint32_t line_bits;
+	uint32_t set_mask;
+	uint32_t *tag;			/* [set * ways + way]: line address, or CACHE_NO_LINE */
+	uint8_t *dirty;
+	uint64_t *stamp;		/* LRU: last use */
+	uint64_t *plru;			/* PLRU: tree bits per set */
+	uint64_t clock;
+	uint32_t random;
+	uint32_t *mru;			/* [set]: slot of the way used last, checked before the set */
+
+	/* statistics */
+	uint64_t reads, writes;
+	uint64_t read_misses, write_misses;
+	uint64_t writebacks;
+} cache_t;
+
+typedef struct cache_hierarchy_struct {
+	cache_t level[NUM_CACHES];
+	uint32_t memory_latency;
+	uint64_t memory_reads, memory_writes;
+	uint64_t stall_cycles;
+	uint64_t instructions;
+	uint32_t fetch_pc;		/* next instruction of the running block not yet fetched */
+} cache_hierarchy_t;
+
+int cache_configure(sim_context *ctx, const char *spec);
+void cache_reset(cache_hierarchy_t *h);
+void cache_free(cache_hierarchy_t *h);
+uint32_t cache_fetch(cache_hierarchy_t *h, uint32_t end);
+uint32_t cache_data(cache_hierarchy_t *h, uint32_t pc, uint32_t address, int write);
+
+/***************************************************************/
+/* The common case of cache_data(), for inlining: a read, or a */
+/* write-back write, that hits the way its L1D set used last. */
+/* Such a hit leaves the replacement order and the L2 alone, so */
+/* the fetches before it can wait for the next cache_data() or */
+/* cache_fetch(). Returns FALSE, changing nothing, for anything */
+/* else. mu-jit.c compiles the same check. */
+/***************************************************************/
+static inline int cache_data_hit(cache_hierarchy_t *h, uint32_t address, int write)
+{
+	cache_t *c = &h->level[CACHE_L1D];
+	uint32_t line, slot;
+
+	if (!c->enabled || (write && !c->write_back)) {
+		return FALSE;
+	}
+	line = address >> c->line_bits;
+	slot = c->mru[line & c->set_mask];
+	if (c->tag[slot] != line) {
+		return FALSE;
+	}
+	if (write) {
+		c->writes++;
+		c->dirty[slot] = TRUE;
+	}
+	else {
+		c->reads++;
+	}
+	h->stall_cycles += c->latency;
+	return TRUE;
+}
+
+/***************************************************************/
+/* The common case of cache_fetch(): fetch up to end while each */
+/* line is the way its L1I set used last. Returns FALSE if a line */
+/* is left for cache_fetch() to look up. */
+/***************************************************************/
+static inline int cache_fetch_hit(cache_hierarchy_t *h, uint32_t end)
+{
+	cache_t *c = &h->level[CACHE_L1I];
+	uint32_t pc = h->fetch_pc, line, bytes, words;
+
+	if (!c->enabled) {
+		return pc >= end;
+	}
+	while (pc < end) {
+		line = pc >> c->line_bits;
+		if (c->tag[c->mru[line & c->set_mask]] != line) {
+			h->fetch_pc = pc;
+			return FALSE;
+		}
+		/* pc up to the end of its line */
+		bytes = (1u << c->line_bits) - (pc & ((1u << c->line_bits) - 1));
+		if (bytes > end - pc) {
+			bytes = end - pc;
+		}
+		words = bytes >> 2;
+		h->instructions += words;
+		c->reads += words;
+		h->stall_cycles += words * c->latency;
+		pc += bytes;
+	}
+	h->fetch_pc = pc;
+	return TRUE;
+}
+
+void cache_report(sim_context *ctx);
+
+#endif
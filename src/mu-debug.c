@@ -0,0 +1,237 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "mu-mips.h"
+#include "mu-block.h"
+#include "mu-debug.h"
+
+static debug_t* debug_state(sim_context *ctx)
+{
+	if (ctx->DEBUG == NULL) {
+		ctx->DEBUG = calloc(1, sizeof(debug_t));
+		if (ctx->DEBUG == NULL) {
+			printf("Error: Can't allocate debugger state\n");
+			exit(-1);
+		}
+	}
+	return ctx->DEBUG;
+}
+
+/* with nothing left to check, go back to running (and fusing) without */
+static void debug_release_if_empty(sim_context *ctx)
+{
+	if (ctx->DEBUG->num_break_pages == 0 && ctx->DEBUG->num_watches == 0) {
+		debug_free(ctx->DEBUG);
+		ctx->DEBUG = NULL;
+		block_cache_invalidate(ctx);
+	}
+}
+
+static break_page_t* break_page(const debug_t *d, uint32_t address)
+{
+	uint32_t i, page = address & ~PAGE_MASK;
+
+	for (i = 0; i < d->num_break_pages; i++) {
+		if (d->break_pages[i].page == page) {
+			return &d->break_pages[i];
+		}
+	}
+	return NULL;
+}
+
+/***************************************************************/
+/* Set a breakpoint on the instruction at address. Returns FALSE */
+/* if address is not word aligned. */
+/***************************************************************/
+int debug_break(sim_context *ctx, uint32_t address)
+{
+	debug_t *d;
+	break_page_t *p;
+	uint32_t word = (address & PAGE_MASK) >> 2;
+
+	if (address & 3) {
+		return FALSE;
+	}
+	d = debug_state(ctx);
+	p = break_page(d, address);
+	if (p == NULL) {
+		d->break_pages = realloc(d->break_pages, (d->num_break_pages + 1) * sizeof(break_page_t));
+		if (d->break_pages == NULL) {
+			printf("Error: Can't allocate breakpoint\n");
+			exit(-1);
+		}
+		p = &d->break_pages[d->num_break_pages++];
+		memset(p, 0, sizeof(break_page_t));
+		p->page = address & ~PAGE_MASK;
+	}
+	if (!(p->bits[word / 32] & (1u << (word % 32)))) {
+		p->bits[word / 32] |= 1u << (word % 32);
+		p->count++;
+		/* retranslate so that a block ends before it */
+		block_cache_invalidate(ctx);
+	}
+	return TRUE;
+}
+
+/***************************************************************/
+/* Watch the word holding address for reads, writes or both. */
+/***************************************************************/
+int debug_watch(sim_context *ctx, uint32_t address, int mode)
+{
+	debug_t *d;
+	uint32_t i;
+
+	if (mode == 0 || (mode & ~(WATCH_READ | WATCH_WRITE))) {
+		return FALSE;
+	}
+	d = debug_state(ctx);
+	address &= ~3u;
+	for (i = 0; i < d->num_watches; i++) {
+		if (d->watches[i].address == address) {
+			d->watches[i].mode |= mode;
+			break;
+		}
+	}
+	if (i == d->num_watches) {
+		d->watches = realloc(d->watches, (d->num_watches + 1) * sizeof(watchpoint_t));
+		if (d->watches == NULL) {
+			printf("Error: Can't allocate watchpoint\n");
+			exit(-1);
+		}
+		d->watches[i].address = address;
+		d->watches[i].mode = mode;
+		d->num_watches++;
+	}
+	/* the page may be in a TLB already, and a fused pair would run */
+	/* past the access */
+	tlb_flush(ctx);
+	block_cache_invalidate(ctx);
+	return TRUE;
+}
+
+/***************************************************************/
+/* Remove the breakpoint and the watchpoint at address. Returns */
+/* FALSE if there was neither. */
+/***************************************************************/
+int debug_delete(sim_context *ctx, uint32_t address)
+{
+	debug_t *d = ctx->DEBUG;
+	break_page_t *p;
+	uint32_t i, word = (address & PAGE_MASK) >> 2;
+	int found = FALSE;
+
+	if (d == NULL) {
+		return FALSE;
+	}
+	p = break_page(d, address);
+	if (p != NULL && (address & 3) == 0 && (p->bits[word / 32] & (1u << (word % 32)))) {
+		p->bits[word / 32] &= ~(1u << (word % 32));
+		if (--p->count == 0) {
+			*p = d->break_pages[--d->num_break_pages];
+		}
+		block_cache_invalidate(ctx);
+		found = TRUE;
+	}
+	for (i = 0; i < d->num_watches; i++) {
+		if (d->watches[i].address == (address & ~3u)) {
+			d->watches[i] = d->watches[--d->num_watches];
+			found = TRUE;
+			break;
+		}
+	}
+	debug_release_if_empty(ctx);
+	return found;
+}
+
+void debug_free(debug_t *d)
+{
+	if (d == NULL) {
+		return;
+	}
+	free(d->break_pages);
+	free(d->watches);
+	free(d);
+}
+
+int debug_breakpoint(const debug_t *d, uint32_t pc)
+{
+	const break_page_t *p = break_page(d, pc);
+	uint32_t word = (pc & PAGE_MASK) >> 2;
+
+	return p != NULL && (p->bits[word / 32] & (1u << (word % 32))) != 0;
+}
+
+/***************************************************************/
+/* Block entry check: TRUE if the engine must stop before pc, */
+/* because a watchpoint fired or pc has a breakpoint. */
+/***************************************************************/
+int debug_stop_at(sim_context *ctx, uint32_t pc)
+{
+	debug_t *d = ctx->DEBUG;
+	int resuming = d->resuming;
+
+	d->resuming = FALSE;
+	if (ctx->DEBUG_STOP) {
+		return TRUE;
+	}
+	if (debug_breakpoint(d, pc) && !(resuming && pc == d->resume_pc)) {
+		d->stop_mode = 0;
+		d->stop_address = pc;
+		d->resuming = TRUE;
+		d->resume_pc = pc;
+		ctx->DEBUG_STOP = TRUE;
+		return TRUE;
+	}
+	return FALSE;
+}
+
+/***************************************************************/
+/* Slow path check of an access of size bytes at address. Stops */
+/* the engine if it touches a word watched for this mode. Returns */
+/* the modes watched anywhere in its page, which must stay out of */
+/* the matching TLB. */
+/***************************************************************/
+int debug_watch_access(sim_context *ctx, uint32_t address, int size, int mode)
+{
+	debug_t *d = ctx->DEBUG;
+	uint32_t i, page = address & ~PAGE_MASK;
+	int page_modes = 0;
+
+	for (i = 0; i < d->num_watches; i++) {
+		watchpoint_t *w = &d->watches[i];
+
+		if ((w->address & ~PAGE_MASK) != page) {
+			continue;
+		}
+		page_modes |= w->mode;
+		if ((w->mode & mode) && address < w->address + 4 && w->address < address + size && !ctx->DEBUG_STOP) {
+			d->stop_mode = mode;
+			d->stop_address = w->address;
+			ctx->DEBUG_STOP = TRUE;
+			/* leave the block after this instruction */
+			ctx->BLOCK_GENERATION++;
+		}
+	}
+	return page_modes;
+}
+
+/***************************************************************/
+/* Say where and why the last run stopped. */
+/***************************************************************/
+void debug_report(sim_context *ctx)
+{
+	debug_t *d = ctx->DEBUG;
+
+	if (d == NULL) {
+		return;
+	}
+	if (d->stop_mode == 0) {
+		printf("Breakpoint at 0x%08x\n\n", d->stop_address);
+	}
+	else {
+		printf("Watchpoint 0x%08x %s, stopped at 0x%08x\n\n", d->stop_address,
+				d->stop_mode == WATCH_READ ? "read" : "written", ctx->CURRENT_STATE.PC);
+	}
+}
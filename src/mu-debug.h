@@ -0,0 +1,61 @@
+#ifndef MU_DEBUG_H
+#define MU_DEBUG_H
+
+#include "mu-mips.h"
+
+/***************************************************************/
+/* Breakpoints and watchpoints. Until the first one is set */
+/* ctx->DEBUG is NULL, and the engines run exactly as without */
+/* them. */
+/* */
+/* Breakpoints are a bitmap per page of code, one bit per word, */
+/* checked only when an engine enters a block (the interpreter */
+/* enters one per instruction). Blocks are translated to end */
+/* before every breakpoint, so each one is a block entry. */
+/* */
+/* A watchpoint covers one word. Its page is kept out of the TLB */
+/* for the watched kind of access, so those accesses take the */
+/* slow path, which checks the watched words. A hit stops the */
+/* engine once the access completes, before the next instruction. */
+/***************************************************************/
+#define WATCH_READ  1
+#define WATCH_WRITE 2
+
+#define BREAK_PAGE_WORDS (PAGE_SIZE / 4 / 32)
+
+typedef struct {
+	uint32_t page;			/* base address */
+	uint32_t count;			/* breakpoints set in it */
+	uint32_t bits[BREAK_PAGE_WORDS];	/* one per word */
+} break_page_t;
+
+typedef struct {
+	uint32_t address;		/* word aligned */
+	int mode;			/* WATCH_READ | WATCH_WRITE */
+} watchpoint_t;
+
+typedef struct debug_struct {
+	break_page_t *break_pages;
+	uint32_t num_break_pages;
+	watchpoint_t *watches;
+	uint32_t num_watches;
+
+	/* why ctx->DEBUG_STOP was set */
+	int stop_mode;			/* 0 for a breakpoint, else the access that hit */
+	uint32_t stop_address;		/* breakpoint or watched word */
+
+	/* a run that starts on the breakpoint it stopped at runs it first */
+	int resuming;
+	uint32_t resume_pc;
+} debug_t;
+
+int debug_break(sim_context *ctx, uint32_t address);
+int debug_watch(sim_context *ctx, uint32_t address, int mode);
+int debug_delete(sim_context *ctx, uint32_t address);
+void debug_free(debug_t *d);
+int debug_breakpoint(const debug_t *d, uint32_t pc);
+int debug_stop_at(sim_context *ctx, uint32_t pc);
+int debug_watch_access(sim_context *ctx, uint32_t address, int size, int mode);
+void debug_report(sim_context *ctx);
+
+#endif
@@ -0,0 +1,203 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "mu-mips.h"
+#include "mu-block.h"
+#include "mu-snapshot.h"
+#include "mu-diff.h"
+
+static const uint8_t ZERO_PAGE[PAGE_SIZE];
+
+typedef struct {
+	diff_entry_t *out;
+	uint32_t max;
+	uint32_t total;
+} diff_state_t;
+
+static void record(diff_state_t *d, int kind, uint32_t where, uint32_t a, uint32_t b)
+{
+	if (d->total < d->max) {
+		d->out[d->total].kind = kind;
+		d->out[d->total].where = where;
+		d->out[d->total].a = a;
+		d->out[d->total].b = b;
+	}
+	d->total++;
+}
+
+/***************************************************************/
+/* Compare the page at address in both simulators. A page one of */
+/* them never wrote reads as zero. */
+/***************************************************************/
+static void diff_page(diff_state_t *d, sim_context *a, sim_context *b, uint32_t address)
+{
+	const uint8_t *pa = mem_page(a, address, FALSE);
+	const uint8_t *pb = mem_page(b, address, FALSE);
+	uint32_t offset, word;
+
+	if (pa == pb) {
+		return;
+	}
+	if (pa == NULL) {
+		pa = ZERO_PAGE;
+	}
+	if (pb == NULL) {
+		pb = ZERO_PAGE;
+	}
+	for (offset = 0; offset < PAGE_SIZE; offset += DIFF_BLOCK) {
+		if (memcmp(pa + offset, pb + offset, DIFF_BLOCK) == 0) {
+			continue;
+		}
+		for (word = offset; word < offset + DIFF_BLOCK; word += 4) {
+			if (memcmp(pa + word, pb + word, 4) != 0) {
+				record(d, DIFF_MEM, address + word, mem_read_32(a, address + word), mem_read_32(b, address + word));
+			}
+		}
+	}
+}
+
+static int compare_address(const void *x, const void *y)
+{
+	uint32_t a = *(const uint32_t *)x, b = *(const uint32_t *)y;
+	return a < b ? -1 : a > b;
+}
+
+/***************************************************************/
+/* Compare two simulators. Stores the first max differences in */
+/* out, registers first and then memory by address, and returns */
+/* how many there are in all. */
+/***************************************************************/
+uint32_t sim_diff(sim_context *a, sim_context *b, diff_entry_t *out, uint32_t max)
+{
+	diff_state_t d = { out, max, 0 };
+	uint32_t i, j, num_pages;
+	uint32_t *pages;
+	int reg;
+
+	for (reg = 0; reg < MIPS_REGS; reg++) {
+		if (a->CURRENT_STATE.REGS[reg] != b->CURRENT_STATE.REGS[reg]) {
+			record(&d, DIFF_REG, reg, a->CURRENT_STATE.REGS[reg], b->CURRENT_STATE.REGS[reg]);
+		}
+	}
+	if (a->CURRENT_STATE.HI != b->CURRENT_STATE.HI) {
+		record(&d, DIFF_HI, 0, a->CURRENT_STATE.HI, b->CURRENT_STATE.HI);
+	}
+	if (a->CURRENT_STATE.LO != b->CURRENT_STATE.LO) {
+		record(&d, DIFF_LO, 0, a->CURRENT_STATE.LO, b->CURRENT_STATE.LO);
+	}
+	if (a->CURRENT_STATE.PC != b->CURRENT_STATE.PC) {
+		record(&d, DIFF_PC, 0, a->CURRENT_STATE.PC, b->CURRENT_STATE.PC);
+	}
+
+	if (a->BASE_SNAPSHOT != 0 && a->BASE_SNAPSHOT == b->BASE_SNAPSHOT) {
+		/* everything else is still the base snapshot's page on both sides */
+		num_pages = a->NUM_DIRTY_PAGES + b->NUM_DIRTY_PAGES;
+		pages = malloc((num_pages + 1) * sizeof(uint32_t));
+		if (pages == NULL) {
+			printf("Error: Can't allocate page list\n");
+			exit(-1);
+		}
+		for (i = 0; i < a->NUM_DIRTY_PAGES; i++) {
+			pages[i] = a->DIRTY_PAGES[i];
+		}
+		for (i = 0; i < b->NUM_DIRTY_PAGES; i++) {
+			pages[a->NUM_DIRTY_PAGES + i] = b->DIRTY_PAGES[i];
+		}
+		qsort(pages, num_pages, sizeof(uint32_t), compare_address);
+		for (i = 0; i < num_pages; i++) {
+			if (i == 0 || pages[i] != pages[i - 1]) {
+				diff_page(&d, a, b, pages[i]);
+			}
+		}
+		free(pages);
+	}
+	else {
+		for (i = 0; i < PAGE_TABLE_SIZE; i++) {
+			const page_table_t *ta = a->PAGE_DIRECTORY[i], *tb = b->PAGE_DIRECTORY[i];
+			if (ta == NULL && tb == NULL) {
+				continue;
+			}
+			for (j = 0; j < PAGE_TABLE_SIZE; j++) {
+				if ((ta != NULL && ta->page[j] != NULL) || (tb != NULL && tb->page[j] != NULL)) {
+					diff_page(&d, a, b, (i << (PAGE_SHIFT + PAGE_TABLE_BITS)) | (j << PAGE_SHIFT));
+				}
+			}
+		}
+	}
+	return d.total;
+}
+
+/***************************************************************/
+/* List differences found by sim_diff(). */
+/***************************************************************/
+void print_diff(const char *name_a, const char *name_b, const diff_entry_t *entries, uint32_t num_entries, uint32_t total)
+{
+	uint32_t i;
+
+	printf("-------------------------------------\n");
+	printf("Differences\t: %u\n", total);
+	if (total == 0) {
+		printf("-------------------------------------\n");
+		return;
+	}
+	printf("-------------------------------------\n");
+	printf("[Where]\t\t[%s]\t[%s]\n", name_a, name_b);
+	printf("-------------------------------------\n");
+	for (i = 0; i < num_entries && i < total; i++) {
+		const diff_entry_t *e = &entries[i];
+		switch (e->kind) {
+			case DIFF_REG: printf("[R%u]\t\t", e->where); break;
+			case DIFF_HI: printf("[HI]\t\t"); break;
+			case DIFF_LO: printf("[LO]\t\t"); break;
+			case DIFF_PC: printf("[PC]\t\t"); break;
+			default: printf("0x%08x\t", e->where); break;
+		}
+		printf("0x%08x\t0x%08x\n", e->a, e->b);
+	}
+	if (total > num_entries) {
+		printf("... %u more\n", total - num_entries);
+	}
+	printf("-------------------------------------\n");
+}
+
+/***************************************************************/
+/* Print how ctx differs from a snapshot. */
+/***************************************************************/
+uint32_t diff_snapshot(sim_context *ctx, const sim_snapshot *snap)
+{
+	sim_context *saved = sim_create();
+	diff_entry_t entries[DIFF_MAX_REPORT];
+	uint32_t total;
+
+	snapshot_restore(saved, snap);
+	total = sim_diff(ctx, saved, entries, DIFF_MAX_REPORT);
+	print_diff("current", "snapshot", entries, DIFF_MAX_REPORT, total);
+	sim_destroy(saved);
+	return total;
+}
+
+/***************************************************************/
+/* Differential test: run ctx to completion, and a copy of it on */
+/* another engine, then print where the two end up differing. */
+/***************************************************************/
+uint32_t diff_engines(sim_context *ctx, int engine)
+{
+	sim_context *other = sim_create();
+	sim_snapshot *start = snapshot_take(ctx);
+	diff_entry_t entries[DIFF_MAX_REPORT];
+	uint32_t total;
+
+	other->ENGINE = engine;
+	other->VERBOSITY = VERBOSITY_QUIET;
+	snapshot_restore(other, start);
+	snapshot_free(start);
+	runAll(ctx);
+	runAll(other);
+	total = sim_diff(ctx, other, entries, DIFF_MAX_REPORT);
+	print_diff(engine_name(ctx->ENGINE), engine_name(engine),
+		entries, DIFF_MAX_REPORT, total);
+	sim_destroy(other);
+	return total;
+}
@@ -0,0 +1,31 @@
+#ifndef MU_DIFF_H
+#define MU_DIFF_H
+
+#include "mu-mips.h"
+
+/***************************************************************/
+/* State diff. Compares the registers, HI, LO, PC and memory of */
+/* two simulators. When both started from the same snapshot only */
+/* the pages either one dirtied since are looked at; otherwise */
+/* every page either one has is. Pages shared between the two are */
+/* equal without reading them; the rest are compared in blocks. */
+/***************************************************************/
+#define DIFF_MAX_REPORT 16	/* differences listed by the diff command */
+#define DIFF_BLOCK 64		/* bytes compared at once before looking at words */
+
+typedef enum {
+	DIFF_REG, DIFF_HI, DIFF_LO, DIFF_PC, DIFF_MEM
+} diff_kind_t;
+
+typedef struct {
+	uint8_t kind;		/* diff_kind_t */
+	uint32_t where;		/* GPR number for DIFF_REG, word address for DIFF_MEM */
+	uint32_t a, b;		/* the two values */
+} diff_entry_t;
+
+uint32_t sim_diff(sim_context *a, sim_context *b, diff_entry_t *out, uint32_t max);
+void print_diff(const char *name_a, const char *name_b, const diff_entry_t *entries, uint32_t num_entries, uint32_t total);
+uint32_t diff_snapshot(sim_context *ctx, const struct sim_snapshot_struct *snap);
+uint32_t diff_engines(sim_context *ctx, int engine);
+
+#endif
@@ -0,0 +1,239 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "mu-mips.h"
+#include "mu-disasm.h"
+
+static const char REG_NAMES[MIPS_REGS][6] = {
+	"$zero", "$at", "$v0", "$v1", "$a0", "$a1", "$a2", "$a3",
+	"$t0", "$t1", "$t2", "$t3", "$t4", "$t5", "$t6", "$t7",
+	"$s0", "$s1", "$s2", "$s3", "$s4", "$s5", "$s6", "$s7",
+	"$t8", "$t9", "$k0", "$k1", "$gp", "$sp", "$fp", "$ra"
+};
+
+/* operand layouts */
+typedef enum {
+	FORM_NONE,		/* SYSCALL */
+	FORM_RD_RS_RT,		/* ADD $rd, $rs, $rt */
+	FORM_RD_RT_SHAMT,	/* SLL $rd, $rt, 4 */
+	FORM_RS_RT,		/* MULT $rs, $rt */
+	FORM_RD,		/* MFHI $rd */
+	FORM_RS,		/* MTHI $rs, JR $rs */
+	FORM_RD_RS,		/* JALR $rd, $rs */
+	FORM_RT_RS_SIGNED,	/* ADDI $rt, $rs, -1 */
+	FORM_RT_RS_UNSIGNED,	/* ORI $rt, $rs, 0xffff */
+	FORM_RT_UPPER,		/* LUI $rt, 0x1001 */
+	FORM_RT_OFFSET_RS,	/* LW $rt, -4($rs) */
+	FORM_RS_RT_TARGET,	/* BEQ $rs, $rt, 0x00400010 */
+	FORM_RS_TARGET,		/* BLEZ $rs, 0x00400010 */
+	FORM_TARGET,		/* J 0x00400010 */
+	FORM_WORD		/* not an instruction: .word 0x... */
+} disasm_form_t;
+
+static const uint8_t FORMS[NUM_OPS] = {
+	[OP_UNDECODED] = FORM_WORD, [OP_INVALID] = FORM_WORD,
+	[OP_ADD] = FORM_RD_RS_RT, [OP_ADDU] = FORM_RD_RS_RT, [OP_SUB] = FORM_RD_RS_RT,
+	[OP_SUBU] = FORM_RD_RS_RT, [OP_AND] = FORM_RD_RS_RT, [OP_OR] = FORM_RD_RS_RT,
+	[OP_XOR] = FORM_RD_RS_RT, [OP_NOR] = FORM_RD_RS_RT, [OP_SLT] = FORM_RD_RS_RT,
+	[OP_SLL] = FORM_RD_RT_SHAMT, [OP_SRL] = FORM_RD_RT_SHAMT, [OP_SRA] = FORM_RD_RT_SHAMT,
+	[OP_MULT] = FORM_RS_RT, [OP_MULTU] = FORM_RS_RT, [OP_DIV] = FORM_RS_RT, [OP_DIVU] = FORM_RS_RT,
+	[OP_MFHI] = FORM_RD, [OP_MFLO] = FORM_RD, [OP_MTHI] = FORM_RS, [OP_MTLO] = FORM_RS,
+	[OP_JR] = FORM_RS, [OP_JALR] = FORM_RD_RS, [OP_SYSCALL] = FORM_NONE,
+	[OP_ADDI] = FORM_RT_RS_SIGNED, [OP_ADDIU] = FORM_RT_RS_SIGNED, [OP_SLTI] = FORM_RT_RS_SIGNED,
+	[OP_ANDI] = FORM_RT_RS_UNSIGNED, [OP_ORI] = FORM_RT_RS_UNSIGNED, [OP_XORI] = FORM_RT_RS_UNSIGNED,
+	[OP_LUI] = FORM_RT_UPPER,
+	[OP_LW] = FORM_RT_OFFSET_RS, [OP_LB] = FORM_RT_OFFSET_RS, [OP_LH] = FORM_RT_OFFSET_RS,
+	[OP_SW] = FORM_RT_OFFSET_RS, [OP_SB] = FORM_RT_OFFSET_RS, [OP_SH] = FORM_RT_OFFSET_RS,
+	[OP_BEQ] = FORM_RS_RT_TARGET, [OP_BNE] = FORM_RS_RT_TARGET,
+	[OP_BLEZ] = FORM_RS_TARGET, [OP_BGTZ] = FORM_RS_TARGET,
+	[OP_BLTZ] = FORM_RS_TARGET, [OP_BGEZ] = FORM_RS_TARGET,
+	[OP_J] = FORM_TARGET, [OP_JAL] = FORM_TARGET
+};
+
+static const char HEX_DIGITS[] = "0123456789abcdef";
+
+static char* put_string(char *p, const char *s)
+{
+	while (*s) {
+		*p++ = *s++;
+	}
+	return p;
+}
+
+static char* put_register(char *p, uint32_t reg)
+{
+	return put_string(p, REG_NAMES[reg]);
+}
+
+static char* put_separator(char *p)
+{
+	*p++ = ',';
+	*p++ = ' ';
+	return p;
+}
+
+static char* put_signed(char *p, int32_t value)
+{
+	char digits[11];
+	uint32_t magnitude = value < 0 ? 0u - (uint32_t)value : (uint32_t)value;
+	int n = 0;
+
+	if (value < 0) {
+		*p++ = '-';
+	}
+	do {
+		digits[n++] = '0' + magnitude % 10;
+		magnitude /= 10;
+	} while (magnitude != 0);
+	while (n > 0) {
+		*p++ = digits[--n];
+	}
+	return p;
+}
+
+/* 0x followed by at least width hex digits */
+static char* put_hex(char *p, uint32_t value, int width)
+{
+	int shift = 28;
+
+	*p++ = '0';
+	*p++ = 'x';
+	while (shift > 4 * (width - 1) && (value >> shift) == 0) {
+		shift -= 4;
+	}
+	for (; shift >= 0; shift -= 4) {
+		*p++ = HEX_DIGITS[(value >> shift) & 0xF];
+	}
+	return p;
+}
+
+/***************************************************************/
+/* Write the assembly for word, found at pc, into out (size */
+/* bytes, NUL terminated) and return its length. Branch and jump */
+/* targets are shown as absolute addresses. */
+/***************************************************************/
+int disasm_format(char *out, size_t size, uint32_t word, uint32_t pc)
+{
+	char line[DISASM_MAX];
+	char *p = line;
+	MIPS d;
+	int length;
+
+	decode_instruction(word, pc, &d);
+	if (FORMS[d.op] == FORM_WORD) {
+		p = put_string(p, ".word ");
+		p = put_hex(p, word, 8);
+	}
+	else {
+		p = put_string(p, OP_NAMES[d.op]);
+		if (FORMS[d.op] != FORM_NONE) {
+			*p++ = ' ';
+		}
+	}
+
+	switch (FORMS[d.op]) {
+		case FORM_RD_RS_RT:
+			p = put_separator(put_register(p, d.rd));
+			p = put_separator(put_register(p, d.rs));
+			p = put_register(p, d.rt);
+			break;
+		case FORM_RD_RT_SHAMT:
+			p = put_separator(put_register(p, d.rd));
+			p = put_separator(put_register(p, d.rt));
+			p = put_signed(p, d.shamt);
+			break;
+		case FORM_RS_RT:
+			p = put_separator(put_register(p, d.rs));
+			p = put_register(p, d.rt);
+			break;
+		case FORM_RD:
+			p = put_register(p, d.rd);
+			break;
+		case FORM_RS:
+			p = put_register(p, d.rs);
+			break;
+		case FORM_RD_RS:
+			p = put_separator(put_register(p, d.rd));
+			p = put_register(p, d.rs);
+			break;
+		case FORM_RT_RS_SIGNED:
+			p = put_separator(put_register(p, d.rt));
+			p = put_separator(put_register(p, d.rs));
+			p = put_signed(p, (int32_t)d.immediate);
+			break;
+		case FORM_RT_RS_UNSIGNED:
+			p = put_separator(put_register(p, d.rt));
+			p = put_separator(put_register(p, d.rs));
+			p = put_hex(p, d.immediate, 4);
+			break;
+		case FORM_RT_UPPER:
+			p = put_separator(put_register(p, d.rt));
+			p = put_hex(p, d.immediate >> 16, 4);
+			break;
+		case FORM_RT_OFFSET_RS:
+			p = put_separator(put_register(p, d.rt));
+			p = put_signed(p, (int32_t)d.immediate);
+			*p++ = '(';
+			p = put_register(p, d.rs);
+			*p++ = ')';
+			break;
+		case FORM_RS_RT_TARGET:
+			p = put_separator(put_register(p, d.rs));
+			p = put_separator(put_register(p, d.rt));
+			p = put_hex(p, d.target, 8);
+			break;
+		case FORM_RS_TARGET:
+			p = put_separator(put_register(p, d.rs));
+			p = put_hex(p, d.target, 8);
+			break;
+		case FORM_TARGET:
+			p = put_hex(p, d.target, 8);
+			break;
+	}
+	*p = '\0';
+
+	length = p - line;
+	if (size == 0) {
+		return length;
+	}
+	if ((size_t)length >= size) {
+		length = size - 1;
+	}
+	memcpy(out, line, length);
+	out[length] = '\0';
+	return length;
+}
+
+/***************************************************************/
+/* Write "[address]\tinstruction" lines for num_words words from */
+/* start, gathered in one buffer and written in large pieces. */
+/***************************************************************/
+void disasm_range(sim_context *ctx, FILE *out, uint32_t start, uint32_t num_words)
+{
+	char *buffer = malloc(DISASM_BUFFER_SIZE);
+	char *p = buffer;
+	uint32_t i, address;
+
+	if (buffer == NULL) {
+		printf("Error: Can't allocate disassembly buffer\n");
+		exit(-1);
+	}
+	for (i = 0; i < num_words; i++) {
+		/* room for the address, the instruction and the newline */
+		if (p - buffer > DISASM_BUFFER_SIZE - DISASM_MAX - 16) {
+			fwrite(buffer, 1, p - buffer, out);
+			p = buffer;
+		}
+		address = start + 4 * i;
+		*p++ = '[';
+		p = put_hex(p, address, 1);
+		*p++ = ']';
+		*p++ = '\t';
+		p += disasm_format(p, DISASM_MAX, mem_read_32(ctx, address), address);
+		*p++ = '\n';
+	}
+	fwrite(buffer, 1, p - buffer, out);
+	free(buffer);
+}
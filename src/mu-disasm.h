@@ -0,0 +1,19 @@
+#ifndef MU_DISASM_H
+#define MU_DISASM_H
+
+#include "mu-mips.h"
+
+/***************************************************************/
+/* Disassembler. Instructions are decoded from their integer */
+/* fields with the decoder's lookup tables, and each op's operand */
+/* layout comes from a static table, so formatting a word costs a */
+/* few table lookups and copies. Listings are built in one buffer */
+/* and written in large pieces rather than a printf per field. */
+/***************************************************************/
+#define DISASM_MAX 48			/* bytes disasm_format() may need, with the NUL */
+#define DISASM_BUFFER_SIZE (64 * 1024)	/* output gathered before each write */
+
+int disasm_format(char *out, size_t size, uint32_t word, uint32_t pc);
+void disasm_range(sim_context *ctx, FILE *out, uint32_t start, uint32_t num_words);
+
+#endif
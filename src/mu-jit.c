@@ -0,0 +1,686 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <sys/mman.h>
+
+#include "mu-mips.h"
+#include "mu-block.h"
+#include "mu-jit.h"
+#include "mu-cache.h"
+
+#if MU_JIT
+
+/* host registers, by x86 encoding */
+#define EAX 0
+#define ECX 1
+#define EDX 2
+#define R8D 8
+
+/* condition codes for Jcc/SETcc/CMOVcc */
+#define CC_E  0x4
+#define CC_NE 0x5
+#define CC_L  0xC
+#define CC_GE 0xD
+#define CC_LE 0xE
+#define CC_G  0xF
+
+#define REG_OFFSET(r) (offsetof(CPU_State, REGS) + 4 * (r))
+
+/* tlb_lookup() scales the TLB index by a shift */
+_Static_assert(sizeof(tlb_entry_t) == 16, "tlb_entry_t must be 16 bytes");
+
+typedef struct {
+	uint8_t *p;
+} jit_buffer_t;
+
+static void emit8(jit_buffer_t *j, uint8_t v)
+{
+	*j->p++ = v;
+}
+
+static void emit32(jit_buffer_t *j, uint32_t v)
+{
+	memcpy(j->p, &v, 4);
+	j->p += 4;
+}
+
+static void emit64(jit_buffer_t *j, uint64_t v)
+{
+	memcpy(j->p, &v, 8);
+	j->p += 8;
+}
+
+/* reserve a rel8 jump displacement, to be set by patch8() */
+static uint8_t* emit_jump8(jit_buffer_t *j, uint8_t opcode)
+{
+	emit8(j, opcode);
+	emit8(j, 0);
+	return j->p - 1;
+}
+
+static void patch8(jit_buffer_t *j, uint8_t *at)
+{
+	*at = j->p - (at + 1);
+}
+
+/* reserve a rel32 jmp displacement, to be set by patch32() */
+static uint8_t* emit_jump32(jit_buffer_t *j)
+{
+	emit8(j, 0xE9);
+	emit32(j, 0);
+	return j->p - 4;
+}
+
+static void patch32(jit_buffer_t *j, uint8_t *at)
+{
+	int32_t displacement = j->p - (at + 4);
+
+	memcpy(at, &displacement, 4);
+}
+
+/* jmp back to target, already emitted */
+static void emit_jump_back(jit_buffer_t *j, uint8_t *target)
+{
+	int32_t displacement = target - (j->p + 5);
+
+	emit8(j, 0xE9);
+	emit32(j, displacement);
+}
+
+/* mov/op between a host register and [rbx + offset] (the CPU state) */
+static void emit_state_op(jit_buffer_t *j, uint8_t opcode, int host, uint32_t offset)
+{
+	if (host >= 8) {
+		emit8(j, 0x44);				/* REX.R */
+	}
+	emit8(j, opcode);
+	emit8(j, 0x83 | (host & 7) << 3);	/* [rbx + disp32] */
+	emit32(j, offset);
+}
+
+static void load_state(jit_buffer_t *j, int host, uint32_t offset)
+{
+	emit_state_op(j, 0x8B, host, offset);
+}
+
+static void store_state(jit_buffer_t *j, int host, uint32_t offset)
+{
+	emit_state_op(j, 0x89, host, offset);
+}
+
+/* host = guest register r; $zero is always 0 */
+static void load_reg(jit_buffer_t *j, int host, uint32_t r)
+{
+	if (r == 0) {
+		if (host >= 8) {
+			emit8(j, 0x45);
+		}
+		emit8(j, 0x31);				/* xor host, host */
+		emit8(j, 0xC0 | (host & 7) << 3 | (host & 7));
+		return;
+	}
+	load_state(j, host, REG_OFFSET(r));
+}
+
+/* mov dword [rbx + offset], value */
+static void store_state_imm(jit_buffer_t *j, uint32_t offset, uint32_t value)
+{
+	emit8(j, 0xC7);
+	emit8(j, 0x83);
+	emit32(j, offset);
+	emit32(j, value);
+}
+
+static void mov_imm(jit_buffer_t *j, int host, uint32_t value)
+{
+	emit8(j, 0xB8 + host);
+	emit32(j, value);
+}
+
+/* mov rax, function; call rax */
+static void call(jit_buffer_t *j, void *function)
+{
+	emit8(j, 0x48);
+	emit8(j, 0xB8);
+	emit64(j, (uint64_t)(uintptr_t)function);
+	emit8(j, 0xFF);
+	emit8(j, 0xD0);
+}
+
+/* mov rdi, r12 (the context) */
+static void arg_context(jit_buffer_t *j)
+{
+	emit8(j, 0x4C);
+	emit8(j, 0x89);
+	emit8(j, 0xE7);
+}
+
+/* eax = (eax cc ecx-or-0) ? taken : not_taken, after the compare */
+static void select_pc(jit_buffer_t *j, int cc, uint32_t taken, uint32_t not_taken)
+{
+	mov_imm(j, EAX, not_taken);
+	mov_imm(j, EDX, taken);
+	emit8(j, 0x0F);				/* cmovcc eax, edx */
+	emit8(j, 0x40 | cc);
+	emit8(j, 0xC2);
+}
+
+/* eax = (eax cc <compared>) ? 1 : 0, after the compare */
+static void set_flag(jit_buffer_t *j, int cc)
+{
+	emit8(j, 0x0F);				/* setcc al */
+	emit8(j, 0x90 | cc);
+	emit8(j, 0xC0);
+	emit8(j, 0x0F);				/* movzx eax, al */
+	emit8(j, 0xB6);
+	emit8(j, 0xC0);
+}
+
+static void prologue(jit_buffer_t *j)
+{
+	emit8(j, 0x53);				/* push rbx */
+	emit8(j, 0x41); emit8(j, 0x54);		/* push r12 */
+	emit8(j, 0x41); emit8(j, 0x55);		/* push r13 */
+	emit8(j, 0x49); emit8(j, 0x89); emit8(j, 0xFC);	/* mov r12, rdi: context */
+	emit8(j, 0x48); emit8(j, 0x89); emit8(j, 0xF3);	/* mov rbx, rsi: CPU state */
+	emit8(j, 0x49); emit8(j, 0x89); emit8(j, 0xD5);	/* mov r13, rdx: executed */
+}
+
+/* *executed = count; return eax */
+static void epilogue(jit_buffer_t *j, uint32_t count)
+{
+	emit8(j, 0x41); emit8(j, 0xC7); emit8(j, 0x45); emit8(j, 0x00);	/* mov dword [r13], count */
+	emit32(j, count);
+	emit8(j, 0x41); emit8(j, 0x5D);		/* pop r13 */
+	emit8(j, 0x41); emit8(j, 0x5C);		/* pop r12 */
+	emit8(j, 0x5B);				/* pop rbx */
+	emit8(j, 0xC3);				/* ret */
+}
+
+/***************************************************************/
+/* Software TLB lookup for the address in eax. Leaves the entry */
+/* offset in rcx and jumps to the returned rel8 (to be patched to */
+/* the slow path) on a miss; on a hit, rdx is the host page and */
+/* eax the offset into it. */
+/***************************************************************/
+static uint8_t* tlb_lookup(jit_buffer_t *j, uint32_t tlb_offset, uint32_t mask)
+{
+	uint8_t *miss;
+
+	emit8(j, 0x89); emit8(j, 0xC1);		/* mov ecx, eax */
+	emit8(j, 0xC1); emit8(j, 0xE9); emit8(j, PAGE_SHIFT);	/* shr ecx, PAGE_SHIFT */
+	emit8(j, 0x81); emit8(j, 0xE1); emit32(j, TLB_SIZE - 1);	/* and ecx, TLB_SIZE - 1 */
+	emit8(j, 0xC1); emit8(j, 0xE1); emit8(j, 4);	/* shl ecx, 4: sizeof(tlb_entry_t) */
+	emit8(j, 0x89); emit8(j, 0xC2);		/* mov edx, eax */
+	emit8(j, 0x81); emit8(j, 0xE2); emit32(j, mask);	/* and edx, mask */
+	emit8(j, 0x41); emit8(j, 0x3B); emit8(j, 0x94); emit8(j, 0x0C);	/* cmp edx, [r12 + rcx + tag] */
+	emit32(j, tlb_offset + offsetof(tlb_entry_t, tag));
+	miss = emit_jump8(j, 0x70 | CC_NE);
+	emit8(j, 0x49); emit8(j, 0x8B); emit8(j, 0x94); emit8(j, 0x0C);	/* mov rdx, [r12 + rcx + host] */
+	emit32(j, tlb_offset + offsetof(tlb_entry_t, host));
+	emit8(j, 0x25); emit32(j, PAGE_MASK);	/* and eax, PAGE_MASK */
+	return miss;
+}
+
+/* an access the inline cache check left to cache_data(); returns */
+/* its address, for the TLB lookup that follows */
+static uint32_t charge_data(sim_context *ctx, uint32_t address, uint32_t pc, int write)
+{
+	cache_data(ctx->CACHES, pc, address, write);
+	return address;
+}
+
+#define L1D_OFFSET(field) (offsetof(cache_hierarchy_t, level) + CACHE_L1D * sizeof(cache_t) + offsetof(cache_t, field))
+
+/* op reg, [rsi + offset] (the cache hierarchy); rex 0x48 for 64 bits, 0 for none */
+static void emit_cache_op(jit_buffer_t *j, uint8_t rex, uint8_t opcode, int reg, uint32_t offset)
+{
+	if (rex != 0) {
+		emit8(j, rex);
+	}
+	emit8(j, opcode);
+	emit8(j, 0x86 | reg << 3);		/* [rsi + disp32] */
+	emit32(j, offset);
+}
+
+/***************************************************************/
+/* cache_data_hit() for the address in eax, which is kept: while */
+/* the cache model is on, an MRU hit is counted here and the */
+/* access goes on to the TLB; anything else jumps to the returned */
+/* rel32, to be patched to emit_charge(). */
+/***************************************************************/
+static uint8_t* emit_cache_check(jit_buffer_t *j, int write)
+{
+	uint8_t *off, *disabled, *write_through = NULL, *other, *hit;
+	uint8_t *slow;
+
+	emit8(j, 0x49); emit8(j, 0x8B); emit8(j, 0xB4); emit8(j, 0x24);	/* mov rsi, [r12 + CACHES] */
+	emit32(j, offsetof(sim_context, CACHES));
+	emit8(j, 0x48); emit8(j, 0x85); emit8(j, 0xF6);	/* test rsi, rsi */
+	off = emit_jump8(j, 0x70 | CC_E);
+	emit_cache_op(j, 0, 0x83, 7, L1D_OFFSET(enabled));	/* cmp dword [rsi + enabled], 0 */
+	emit8(j, 0x00);
+	disabled = emit_jump8(j, 0x70 | CC_E);
+	if (write) {
+		emit_cache_op(j, 0, 0x83, 7, L1D_OFFSET(write_back));	/* cmp dword [rsi + write_back], 0 */
+		emit8(j, 0x00);
+		write_through = emit_jump8(j, 0x70 | CC_E);
+	}
+	emit_cache_op(j, 0, 0x8B, ECX, L1D_OFFSET(line_bits));	/* mov ecx, [rsi + line_bits] */
+	emit8(j, 0x89); emit8(j, 0xC2);		/* mov edx, eax */
+	emit8(j, 0xD3); emit8(j, 0xEA);		/* shr edx, cl: the line */
+	emit8(j, 0x89); emit8(j, 0xD1);		/* mov ecx, edx */
+	emit_cache_op(j, 0, 0x23, ECX, L1D_OFFSET(set_mask));	/* and ecx, [rsi + set_mask] */
+	emit_cache_op(j, 0x48, 0x8B, 7, L1D_OFFSET(mru));	/* mov rdi, [rsi + mru] */
+	emit8(j, 0x8B); emit8(j, 0x0C); emit8(j, 0x8F);	/* mov ecx, [rdi + rcx * 4]: the slot */
+	emit_cache_op(j, 0x48, 0x8B, 7, L1D_OFFSET(tag));	/* mov rdi, [rsi + tag] */
+	emit8(j, 0x3B); emit8(j, 0x14); emit8(j, 0x8F);	/* cmp edx, [rdi + rcx * 4] */
+	other = emit_jump8(j, 0x70 | CC_NE);
+	if (write) {
+		emit_cache_op(j, 0x48, 0xFF, 0, L1D_OFFSET(writes));	/* inc qword [rsi + writes] */
+		emit_cache_op(j, 0x48, 0x8B, 7, L1D_OFFSET(dirty));	/* mov rdi, [rsi + dirty] */
+		emit8(j, 0xC6); emit8(j, 0x04); emit8(j, 0x0F); emit8(j, 0x01);	/* mov byte [rdi + rcx], 1 */
+	}
+	else {
+		emit_cache_op(j, 0x48, 0xFF, 0, L1D_OFFSET(reads));	/* inc qword [rsi + reads] */
+	}
+	emit_cache_op(j, 0, 0x8B, EDX, L1D_OFFSET(latency));	/* mov edx, [rsi + latency] */
+	emit_cache_op(j, 0x48, 0x01, EDX, offsetof(cache_hierarchy_t, stall_cycles));	/* add [rsi + stall_cycles], rdx */
+	hit = emit_jump8(j, 0xEB);
+
+	patch8(j, disabled);
+	if (write_through != NULL) {
+		patch8(j, write_through);
+	}
+	patch8(j, other);
+	slow = emit_jump32(j);
+	patch8(j, off);
+	patch8(j, hit);
+	return slow;
+}
+
+/* charge_data() for the access at pc, then back to its TLB lookup; */
+/* a store's value is saved around the call (twice, which keeps the */
+/* stack aligned) */
+static void emit_charge(jit_buffer_t *j, uint8_t *slow, uint8_t *lookup, uint32_t pc, int write)
+{
+	patch32(j, slow);
+	if (write) {
+		emit8(j, 0x41); emit8(j, 0x50);		/* push r8 */
+		emit8(j, 0x41); emit8(j, 0x50);		/* push r8 */
+	}
+	emit8(j, 0x89); emit8(j, 0xC6);		/* mov esi, eax */
+	mov_imm(j, EDX, pc);
+	mov_imm(j, ECX, write);
+	arg_context(j);
+	call(j, charge_data);
+	if (write) {
+		emit8(j, 0x41); emit8(j, 0x58);		/* pop r8 */
+		emit8(j, 0x41); emit8(j, 0x58);		/* pop r8 */
+	}
+	emit_jump_back(j, lookup);
+}
+
+/* after a slow access that hit a watchpoint, leave the block at next_pc */
+static void emit_debug_exit(jit_buffer_t *j, uint32_t next_pc, uint32_t count)
+{
+	uint8_t *go_on;
+
+	emit8(j, 0x41); emit8(j, 0x83); emit8(j, 0xBC); emit8(j, 0x24);	/* cmp dword [r12 + DEBUG_STOP], 0 */
+	emit32(j, offsetof(sim_context, DEBUG_STOP));
+	emit8(j, 0x00);
+	go_on = emit_jump8(j, 0x70 | CC_E);
+	mov_imm(j, EAX, next_pc);
+	epilogue(j, count);
+	patch8(j, go_on);
+}
+
+/* rt = guest memory at the address in eax, sign-extended; a load */
+/* that hit a watchpoint leaves the block at next_pc */
+static void emit_load(jit_buffer_t *j, int size, uint32_t rt, uint32_t next_pc, uint32_t count)
+{
+	uint32_t mask = ~PAGE_MASK | (size - 1);
+	uint8_t *slow, *lookup, *miss, *done, *done_miss;
+
+	slow = emit_cache_check(j, FALSE);
+	lookup = j->p;
+	miss = tlb_lookup(j, offsetof(sim_context, TLB_READ), mask);
+	switch (size) {
+		case 4: emit8(j, 0x8B); break;				/* mov eax, [rdx + rax] */
+		case 2: emit8(j, 0x0F); emit8(j, 0xBF); break;		/* movsx eax, word [rdx + rax] */
+		default: emit8(j, 0x0F); emit8(j, 0xBE); break;		/* movsx eax, byte [rdx + rax] */
+	}
+	emit8(j, 0x04); emit8(j, 0x02);
+	done = emit_jump32(j);
+
+	emit_charge(j, slow, lookup, next_pc - 4, FALSE);
+	patch8(j, miss);
+	emit8(j, 0x89); emit8(j, 0xC6);		/* mov esi, eax */
+	arg_context(j);
+	switch (size) {
+		case 4:
+			call(j, mem_read_32);
+			break;
+		case 2:
+			call(j, mem_read_16);
+			emit8(j, 0x0F); emit8(j, 0xBF); emit8(j, 0xC0);	/* movsx eax, ax */
+			break;
+		default:
+			call(j, mem_read_8);
+			emit8(j, 0x0F); emit8(j, 0xBE); emit8(j, 0xC0);	/* movsx eax, al */
+			break;
+	}
+	if (rt != 0) {
+		store_state(j, EAX, REG_OFFSET(rt));
+	}
+	emit_debug_exit(j, next_pc, count);
+	done_miss = emit_jump8(j, 0xEB);
+
+	patch32(j, done);
+	if (rt != 0) {
+		store_state(j, EAX, REG_OFFSET(rt));
+	}
+	patch8(j, done_miss);
+}
+
+/* store r8d to the address in eax; a store that made the blocks */
+/* stale (it wrote translated text) or hit a watchpoint leaves the */
+/* block at next_pc */
+static void emit_store(jit_buffer_t *j, int size, uint32_t next_pc, uint32_t count)
+{
+	uint32_t mask = ~PAGE_MASK | (size - 1);
+	uint8_t *slow, *lookup, *miss, *done, *fresh;
+
+	slow = emit_cache_check(j, TRUE);
+	lookup = j->p;
+	miss = tlb_lookup(j, offsetof(sim_context, TLB_WRITE), mask);
+	switch (size) {
+		case 4: emit8(j, 0x44); emit8(j, 0x89); break;			/* mov [rdx + rax], r8d */
+		case 2: emit8(j, 0x66); emit8(j, 0x44); emit8(j, 0x89); break;	/* mov [rdx + rax], r8w */
+		default: emit8(j, 0x44); emit8(j, 0x88); break;			/* mov [rdx + rax], r8b */
+	}
+	emit8(j, 0x04); emit8(j, 0x02);
+	done = emit_jump32(j);
+
+	emit_charge(j, slow, lookup, next_pc - 4, TRUE);
+	patch8(j, miss);
+	emit8(j, 0x89); emit8(j, 0xC6);		/* mov esi, eax */
+	emit8(j, 0x44); emit8(j, 0x89); emit8(j, 0xC2);	/* mov edx, r8d */
+	arg_context(j);
+	call(j, size == 4 ? (void *)mem_write_32 : size == 2 ? (void *)mem_write_16 : (void *)mem_write_8);
+	emit8(j, 0x41); emit8(j, 0x83); emit8(j, 0xBC); emit8(j, 0x24);	/* cmp dword [r12 + BLOCKS_STALE], 0 */
+	emit32(j, offsetof(sim_context, BLOCKS_STALE));
+	emit8(j, 0x00);
+	fresh = emit_jump8(j, 0x70 | CC_E);
+	mov_imm(j, EAX, next_pc);
+	epilogue(j, count);
+	patch8(j, fresh);
+	emit_debug_exit(j, next_pc, count);
+	patch32(j, done);
+}
+
+/* run the instruction's handler: eax = its next PC */
+static void emit_handler_call(jit_buffer_t *j, const MIPS *d, uint32_t pc)
+{
+	store_state_imm(j, offsetof(CPU_State, PC), pc);
+	arg_context(j);
+	emit8(j, 0x48); emit8(j, 0x89); emit8(j, 0xDE);	/* mov rsi, rbx */
+	emit8(j, 0x48); emit8(j, 0xBA);		/* mov rdx, d */
+	emit64(j, (uint64_t)(uintptr_t)d);
+	call(j, EXEC_TABLE[d->op]);
+	store_state_imm(j, REG_OFFSET(0), 0);
+}
+
+/* rd/rt = rs op rt, for the two-operand ALU encodings */
+static void emit_alu(jit_buffer_t *j, uint8_t opcode, const MIPS *d)
+{
+	load_reg(j, EAX, d->rs);
+	load_reg(j, ECX, d->rt);
+	emit8(j, opcode);			/* op eax, ecx */
+	emit8(j, 0xC8);
+}
+
+static void emit_alu_imm(jit_buffer_t *j, uint8_t opcode, const MIPS *d)
+{
+	load_reg(j, EAX, d->rs);
+	emit8(j, opcode);			/* op eax, imm32 */
+	emit32(j, d->immediate);
+}
+
+static void emit_shift(jit_buffer_t *j, uint8_t modrm, const MIPS *d)
+{
+	load_reg(j, EAX, d->rt);
+	if (d->shamt != 0) {
+		emit8(j, 0xC1);			/* shl/shr/sar eax, shamt */
+		emit8(j, modrm);
+		emit8(j, d->shamt);
+	}
+	store_state(j, EAX, REG_OFFSET(d->rd));
+}
+
+/* eax = rs + immediate */
+static void emit_address(jit_buffer_t *j, const MIPS *d)
+{
+	load_reg(j, EAX, d->rs);
+	if (d->immediate != 0) {
+		emit8(j, 0x05);			/* add eax, imm32 */
+		emit32(j, d->immediate);
+	}
+}
+
+/***************************************************************/
+/* Compile instruction i of b. Control transfers, which only end */
+/* a block, leave the next PC in eax. */
+/***************************************************************/
+static void emit_instruction(jit_buffer_t *j, block_t *b, uint32_t i)
+{
+	const MIPS *d = &b->instrs[i];
+	uint32_t pc = b->start_pc + 4 * i;
+
+	switch (d->op) {
+		case OP_ADD: case OP_ADDU: case OP_SUB: case OP_SUBU:
+		case OP_AND: case OP_OR: case OP_XOR: case OP_NOR: case OP_SLT:
+			if (d->rd == 0) {
+				break;
+			}
+			switch (d->op) {
+				case OP_ADD: case OP_ADDU: emit_alu(j, 0x01, d); break;
+				case OP_SUB: case OP_SUBU: emit_alu(j, 0x29, d); break;
+				case OP_AND: emit_alu(j, 0x21, d); break;
+				case OP_OR: emit_alu(j, 0x09, d); break;
+				case OP_XOR: emit_alu(j, 0x31, d); break;
+				case OP_NOR:
+					emit_alu(j, 0x09, d);
+					emit8(j, 0xF7); emit8(j, 0xD0);	/* not eax */
+					break;
+				default:
+					emit_alu(j, 0x39, d);		/* cmp eax, ecx */
+					set_flag(j, CC_L);
+					break;
+			}
+			store_state(j, EAX, REG_OFFSET(d->rd));
+			break;
+
+		case OP_ADDI: case OP_ADDIU: case OP_ANDI: case OP_ORI: case OP_XORI: case OP_SLTI:
+			if (d->rt == 0) {
+				break;
+			}
+			switch (d->op) {
+				case OP_ANDI: emit_alu_imm(j, 0x25, d); break;
+				case OP_ORI: emit_alu_imm(j, 0x0D, d); break;
+				case OP_XORI: emit_alu_imm(j, 0x35, d); break;
+				case OP_SLTI:
+					emit_alu_imm(j, 0x3D, d);	/* cmp eax, imm32 */
+					set_flag(j, CC_L);
+					break;
+				default: emit_alu_imm(j, 0x05, d); break;
+			}
+			store_state(j, EAX, REG_OFFSET(d->rt));
+			break;
+
+		case OP_LUI:
+			if (d->rt != 0) {
+				store_state_imm(j, REG_OFFSET(d->rt), d->immediate);
+			}
+			break;
+
+		case OP_SLL:
+			if (d->rd != 0) {
+				emit_shift(j, 0xE0, d);
+			}
+			break;
+		case OP_SRL:
+			if (d->rd != 0) {
+				emit_shift(j, 0xE8, d);
+			}
+			break;
+		case OP_SRA:
+			if (d->rd != 0) {
+				emit_shift(j, 0xF8, d);
+			}
+			break;
+
+		case OP_MULT: case OP_MULTU:
+			load_reg(j, EAX, d->rs);
+			load_reg(j, ECX, d->rt);
+			emit8(j, 0xF7);			/* imul ecx / mul ecx: edx:eax = eax * ecx */
+			emit8(j, d->op == OP_MULT ? 0xE9 : 0xE1);
+			store_state(j, EAX, offsetof(CPU_State, LO));
+			store_state(j, EDX, offsetof(CPU_State, HI));
+			break;
+
+		case OP_MFHI: case OP_MFLO:
+			if (d->rd != 0) {
+				load_state(j, EAX, d->op == OP_MFHI ? offsetof(CPU_State, HI) : offsetof(CPU_State, LO));
+				store_state(j, EAX, REG_OFFSET(d->rd));
+			}
+			break;
+		case OP_MTHI: case OP_MTLO:
+			load_reg(j, EAX, d->rs);
+			store_state(j, EAX, d->op == OP_MTHI ? offsetof(CPU_State, HI) : offsetof(CPU_State, LO));
+			break;
+
+		case OP_LW: case OP_LH: case OP_LB:
+			emit_address(j, d);
+			emit_load(j, d->op == OP_LW ? 4 : d->op == OP_LH ? 2 : 1, d->rt, pc + 4, i + 1);
+			break;
+		case OP_SW: case OP_SH: case OP_SB:
+			emit_address(j, d);
+			load_reg(j, R8D, d->rt);
+			emit_store(j, d->op == OP_SW ? 4 : d->op == OP_SH ? 2 : 1, pc + 4, i + 1);
+			break;
+
+		case OP_BEQ: case OP_BNE:
+			emit_alu(j, 0x39, d);			/* cmp eax, ecx */
+			select_pc(j, d->op == OP_BEQ ? CC_E : CC_NE, d->target, pc + 4);
+			break;
+		case OP_BLEZ: case OP_BGTZ: case OP_BLTZ: case OP_BGEZ:
+			load_reg(j, EAX, d->rs);
+			emit8(j, 0x85); emit8(j, 0xC0);		/* test eax, eax */
+			select_pc(j, d->op == OP_BLEZ ? CC_LE : d->op == OP_BGTZ ? CC_G : d->op == OP_BLTZ ? CC_L : CC_GE,
+					d->target, pc + 4);
+			break;
+		case OP_J:
+			mov_imm(j, EAX, d->target);
+			break;
+		case OP_JAL:
+			store_state_imm(j, REG_OFFSET(31), pc + 4);
+			mov_imm(j, EAX, d->target);
+			break;
+		case OP_JR:
+			load_reg(j, EAX, d->rs);
+			break;
+
+		default:
+			/* SYSCALL, JALR, DIV, DIVU and anything invalid */
+			emit_handler_call(j, d, pc);
+			break;
+	}
+}
+
+static uint8_t* jit_cache(sim_context *ctx)
+{
+	if (ctx->JIT_CACHE == NULL) {
+		void *cache = mmap(NULL, JIT_CACHE_SIZE, PROT_READ | PROT_WRITE | PROT_EXEC,
+				MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (cache == MAP_FAILED) {
+			printf("Error: Can't allocate executable memory, using the block engine\n");
+			ctx->ENGINE = ENGINE_BLOCK;
+			return NULL;
+		}
+		ctx->JIT_CACHE = cache;
+		ctx->JIT_CACHE_USED = 0;
+	}
+	return ctx->JIT_CACHE;
+}
+
+/***************************************************************/
+/* Compile b into the code cache. When the cache is full the */
+/* blocks are made stale, so the next flush starts it afresh. */
+/* Returns TRUE if b now has native code. */
+/***************************************************************/
+int jit_compile(sim_context *ctx, block_t *b)
+{
+	uint32_t need = JIT_BLOCK_OVERHEAD + b->num_instrs * JIT_MAX_INSTR_BYTES;
+	jit_buffer_t j;
+	uint8_t *cache = jit_cache(ctx);
+	uint32_t i;
+
+	if (cache == NULL) {
+		return FALSE;
+	}
+	if (ctx->JIT_CACHE_USED + need > JIT_CACHE_SIZE) {
+		ctx->BLOCKS_STALE = TRUE;
+		return FALSE;
+	}
+
+	j.p = cache + ctx->JIT_CACHE_USED;
+	prologue(&j);
+	for (i = 0; i < b->num_instrs; i++) {
+		emit_instruction(&j, b, i);
+	}
+	if (!ends_block(b->instrs[b->num_instrs - 1].op)) {
+		/* cut at BLOCK_MAX_INSTRS or the end of text: fall through */
+		mov_imm(&j, EAX, b->start_pc + 4 * b->num_instrs);
+	}
+	epilogue(&j, b->num_instrs);
+
+	b->jit = (jit_code_t)(cache + ctx->JIT_CACHE_USED);
+	ctx->JIT_CACHE_USED = (j.p - cache + 15) & ~15u;
+	ctx->BLOCKS_COMPILED++;
+	return TRUE;
+}
+
+/* forget all compiled code; its blocks are being freed */
+void jit_cache_reset(sim_context *ctx)
+{
+	ctx->JIT_CACHE_USED = 0;
+}
+
+void jit_free(sim_context *ctx)
+{
+	if (ctx->JIT_CACHE != NULL) {
+		munmap(ctx->JIT_CACHE, JIT_CACHE_SIZE);
+		ctx->JIT_CACHE = NULL;
+	}
+	ctx->JIT_CACHE_USED = 0;
+}
+
+#else
+
+int jit_compile(sim_context *ctx, block_t *b)
+{
+	return FALSE;
+}
+
+void jit_cache_reset(sim_context *ctx)
+{
+}
+
+void jit_free(sim_context *ctx)
+{
+}
+
+#endif
@@ -0,0 +1,44 @@
+#ifndef MU_JIT_H
+#define MU_JIT_H
+
+#include "mu-mips.h"
+#include "mu-block.h"
+
+/***************************************************************/
+/* x86-64 translator for hot blocks (the "jit" engine). Blocks */
+/* run through their handlers like the block engine until they */
+/* have executed JIT_THRESHOLD times, then are compiled to native */
+/* code in a per-context code cache. */
+/* */
+/* The CPU_State is pinned in rbx and the context in r12; guest */
+/* registers stay in memory, so native code and handlers can be */
+/* mixed freely. Loads and stores inline the software TLB lookup */
+/* and call the C accessors when it misses. While the cache model */
+/* is on they also inline its MRU check, and call cache_data() */
+/* when that fails. SYSCALL, JALR and the divides call their */
+/* handlers. Native code returns to the block loop at the end of */
+/* the block, or right after a store that rewrote translated */
+/* text. Compiled code is dropped with the blocks, so a flush */
+/* simply empties the code cache. */
+/* */
+/* Build with -DMU_JIT=0 to leave the translator out; it is only */
+/* available on x86-64 hosts. */
+/***************************************************************/
+#ifndef MU_JIT
+#if defined(__x86_64__)
+#define MU_JIT 1
+#else
+#define MU_JIT 0
+#endif
+#endif
+
+#define JIT_THRESHOLD 64		/* executions before a block is compiled */
+#define JIT_CACHE_SIZE (16u << 20)	/* bytes of code per context */
+#define JIT_MAX_INSTR_BYTES 384		/* most code one instruction compiles to */
+#define JIT_BLOCK_OVERHEAD 64		/* prologue, epilogue and alignment */
+
+int jit_compile(sim_context *ctx, block_t *b);
+void jit_cache_reset(sim_context *ctx);
+void jit_free(sim_context *ctx);
+
+#endif
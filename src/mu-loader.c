@@ -0,0 +1,267 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <elf.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "mu-mips.h"
+#include "mu-loader.h"
+
+/***************************************************************/
+/* Map a format name given on the command line to FORMAT_*. */
+/***************************************************************/
+int parse_program_format(const char *name)
+{
+	if (!strcmp(name, "auto")) return FORMAT_AUTO;
+	if (!strcmp(name, "hex")) return FORMAT_HEX;
+	if (!strcmp(name, "bin") || !strcmp(name, "binbe")) return FORMAT_BIN_BE;
+	if (!strcmp(name, "binle")) return FORMAT_BIN_LE;
+	if (!strcmp(name, "elf")) return FORMAT_ELF;
+	return -1;
+}
+
+int detect_program_format(const char *path)
+{
+	unsigned char magic[SELFMAG];
+	size_t length = strlen(path);
+	FILE *fp = fopen(path, "rb");
+
+	if (fp != NULL) {
+		size_t n = fread(magic, 1, SELFMAG, fp);
+		fclose(fp);
+		if (n == SELFMAG && memcmp(magic, ELFMAG, SELFMAG) == 0) {
+			return FORMAT_ELF;
+		}
+	}
+	if (length > 4 && !strcmp(path + length - 4, ".bin")) {
+		return FORMAT_BIN_BE;
+	}
+	return FORMAT_HEX;
+}
+
+static int open_program(const char *path, size_t *length)
+{
+	struct stat st;
+	int fd = open(path, O_RDONLY);
+
+	if (fd < 0 || fstat(fd, &st) != 0) {
+		printf("Error: Can't open program file %s\n", path);
+		if (fd >= 0) {
+			close(fd);
+		}
+		return -1;
+	}
+	*length = st.st_size;
+	return fd;
+}
+
+/***************************************************************/
+/* Map length bytes of the file at offset copy-on-write, and */
+/* return a pointer to the byte at offset. Every segment gets its */
+/* own private mapping, which the memory system unmaps when guest */
+/* memory is freed. */
+/***************************************************************/
+static uint8_t* map_region(sim_context *ctx, int fd, uint32_t offset, uint32_t length)
+{
+	long host_page = sysconf(_SC_PAGESIZE);
+	uint32_t map_offset = offset & ~(uint32_t)(host_page - 1);
+	size_t map_length = length + (offset - map_offset);
+	uint8_t *base = mmap(NULL, map_length, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, map_offset);
+
+	if (base == MAP_FAILED) {
+		printf("Error: Can't map program file\n");
+		return NULL;
+	}
+	mem_add_mapping(ctx, base, map_length);
+	return base + (offset - map_offset);
+}
+
+/***************************************************************/
+/* Place filesz bytes from file offset into guest memory at vaddr. */
+/* Whole pages are mapped straight from the file; partial pages */
+/* are copied. Guest memory keeps words little-endian, so a */
+/* big-endian image has each word byte-swapped (address ^ 3), */
+/* which only touches (and so copies) the pages of that image. */
+/* Returns FALSE if the file can't be mapped. */
+/***************************************************************/
+static int load_segment(sim_context *ctx, int fd, uint32_t offset, uint32_t vaddr, uint32_t filesz, int little_endian)
+{
+	uint32_t end = vaddr + filesz;
+	uint32_t address = vaddr;
+	int can_map = ((offset - vaddr) & PAGE_MASK) == 0;
+	uint8_t *segment;
+
+	if (filesz == 0) {
+		return TRUE;
+	}
+	if ((segment = map_region(ctx, fd, offset, filesz)) == NULL) {
+		return FALSE;
+	}
+	while (address < end) {
+		uint32_t page_end = (address & ~PAGE_MASK) + PAGE_SIZE;
+		uint8_t *src = segment + (address - vaddr);
+
+		if (can_map && (address & PAGE_MASK) == 0 && page_end <= end && page_end != 0 &&
+				mem_map_host_page(ctx, address, src)) {
+			if (!little_endian) {
+				uint32_t *word = (uint32_t *)src;
+				uint32_t i;
+				for (i = 0; i < PAGE_SIZE / 4; i++) {
+					word[i] = __builtin_bswap32(word[i]);
+				}
+			}
+			address = page_end;
+			continue;
+		}
+		if (page_end > end || page_end == 0) {
+			page_end = end;
+		}
+		for (; address < page_end; address++, src++) {
+			mem_write_8(ctx, little_endian ? address : (address ^ 3), *src);
+		}
+	}
+	return TRUE;
+}
+
+/***************************************************************/
+/* Load a raw memory image at MEM_TEXT_BEGIN. Returns FALSE if */
+/* the image can't be loaded. */
+/***************************************************************/
+int load_binary_image(sim_context *ctx, const char *path, int little_endian)
+{
+	size_t length;
+	int fd = open_program(path, &length);
+	int ok;
+
+	if (fd < 0) {
+		return FALSE;
+	}
+	if (length > MEM_TEXT_END - MEM_TEXT_BEGIN + 1) {
+		printf("Error: Program image %s does not fit in the text segment\n", path);
+		close(fd);
+		return FALSE;
+	}
+	ok = load_segment(ctx, fd, 0, MEM_TEXT_BEGIN, length, little_endian);
+	close(fd);
+	ctx->PROGRAM_SIZE = (length + 3) / 4;
+	ctx->PROGRAM_ENTRY = MEM_TEXT_BEGIN;
+	return ok;
+}
+
+/* TRUE if the length (> 0) bytes at address all lie in memory regions */
+static int in_memory_region(uint32_t address, uint32_t length)
+{
+	uint32_t last = address + (length - 1);
+	int i;
+
+	for (i = 0; i < NUM_MEM_REGION; i++) {
+		if (address >= MEM_REGIONS[i].begin && address <= MEM_REGIONS[i].end) {
+			if (last <= MEM_REGIONS[i].end) {
+				return TRUE;
+			}
+			/* runs on into the next region, if there is one right after */
+			address = MEM_REGIONS[i].end + 1;
+			i = -1;
+		}
+	}
+	return FALSE;
+}
+
+static uint16_t elf16(uint16_t v, int little_endian)
+{
+	return little_endian ? v : __builtin_bswap16(v);
+}
+
+static uint32_t elf32(uint32_t v, int little_endian)
+{
+	return little_endian ? v : __builtin_bswap32(v);
+}
+
+/***************************************************************/
+/* Load the PT_LOAD segments of a MIPS32 ELF executable at their */
+/* linked addresses and take the entry point from the header. */
+/* Returns FALSE if the file is not a loadable MIPS32 executable. */
+/***************************************************************/
+int load_elf(sim_context *ctx, const char *path)
+{
+	size_t length;
+	int fd = open_program(path, &length);
+	uint8_t *file;
+	Elf32_Ehdr *eh;
+	uint32_t text_end = MEM_TEXT_BEGIN;
+	uint32_t phoff, phnum;
+	int le, i, ok = FALSE;
+
+	if (fd < 0) {
+		return FALSE;
+	}
+	file = length ? mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+	eh = (Elf32_Ehdr *)file;
+	if (file == MAP_FAILED || length < sizeof(Elf32_Ehdr) || memcmp(eh->e_ident, ELFMAG, SELFMAG) != 0 ||
+			eh->e_ident[EI_CLASS] != ELFCLASS32) {
+		printf("Error: %s is not a 32-bit ELF file\n", path);
+		goto done;
+	}
+	le = eh->e_ident[EI_DATA] == ELFDATA2LSB;
+	if (elf16(eh->e_machine, le) != EM_MIPS) {
+		printf("Error: %s is not a MIPS executable\n", path);
+		goto done;
+	}
+	if (elf16(eh->e_type, le) != ET_EXEC) {
+		printf("Error: %s is not an executable (ELF type %u)\n", path, elf16(eh->e_type, le));
+		goto done;
+	}
+
+	phoff = elf32(eh->e_phoff, le);
+	phnum = elf16(eh->e_phnum, le);
+	if (phoff > length || phnum > (length - phoff) / sizeof(Elf32_Phdr)) {
+		printf("Error: %s has a truncated program header table\n", path);
+		goto done;
+	}
+
+	for (i = 0; i < phnum; i++) {
+		Elf32_Phdr *ph = (Elf32_Phdr *)(file + phoff) + i;
+		uint32_t offset = elf32(ph->p_offset, le);
+		uint32_t vaddr = elf32(ph->p_vaddr, le);
+		uint32_t filesz = elf32(ph->p_filesz, le);
+		uint32_t memsz = elf32(ph->p_memsz, le);
+
+		if (elf32(ph->p_type, le) != PT_LOAD) {
+			continue;
+		}
+		if (offset > length || filesz > length - offset) {
+			printf("Error: %s has a truncated segment\n", path);
+			goto done;
+		}
+		if (memsz < filesz) {
+			memsz = filesz;
+		}
+		if (memsz != 0 && (vaddr + (memsz - 1) < vaddr || !in_memory_region(vaddr, memsz))) {
+			printf("Error: %s has a segment at 0x%08x (%u bytes) outside guest memory\n", path, vaddr, memsz);
+			goto done;
+		}
+		/* the rest of memsz is .bss, which reads as zero already */
+		if (!load_segment(ctx, fd, offset, vaddr, filesz, le)) {
+			goto done;
+		}
+
+		if ((elf32(ph->p_flags, le) & PF_X) && vaddr >= MEM_TEXT_BEGIN && vaddr + filesz - 1 <= MEM_TEXT_END &&
+				vaddr + filesz > text_end) {
+			text_end = vaddr + filesz;
+		}
+	}
+	ctx->PROGRAM_SIZE = (text_end - MEM_TEXT_BEGIN + 3) / 4;
+	ctx->PROGRAM_ENTRY = elf32(eh->e_entry, le);
+	ok = TRUE;
+
+done:
+	if (file != MAP_FAILED) {
+		munmap(file, length);
+	}
+	close(fd);
+	return ok;
+}
@@ -0,0 +1,20 @@
+#ifndef MU_LOADER_H
+#define MU_LOADER_H
+
+#include "mu-mips.h"
+
+/***************************************************************/
+/* Program file formats understood by load_program(). */
+/***************************************************************/
+#define FORMAT_AUTO   0	/* ELF by magic, raw big-endian for *.bin, hex text otherwise */
+#define FORMAT_HEX    1	/* one hex word per line (the lab format) */
+#define FORMAT_BIN_BE 2	/* raw big-endian image loaded at MEM_TEXT_BEGIN */
+#define FORMAT_BIN_LE 3	/* raw little-endian image loaded at MEM_TEXT_BEGIN */
+#define FORMAT_ELF    4	/* MIPS32 ELF executable, either endianness */
+
+int parse_program_format(const char *name);
+int detect_program_format(const char *path);
+int load_binary_image(sim_context *ctx, const char *path, int little_endian);
+int load_elf(sim_context *ctx, const char *path);
+
+#endif
@@ -1,1126 +1,2072 @@
-#include <stdio.h>
-#include <stdlib.h>
-#include <string.h>
-#include <stdint.h>
-#include <assert.h>
-#include <ctype.h>
-#include <math.h>
-
-#include "mu-mips.h"
-
-/***************************************************************/
-/* Print out a list of commands available. */
-/***************************************************************/
-void help() {
-	printf("------------------------------------------------------------------\n\n");
-	printf("\t**********MU-MIPS Help MENU**********\n\n");
-	printf("sim\t-- simulate program to completion \n");
-	printf("run <n>\t-- simulate program for <n> instructions\n");
-	printf("rdump\t-- dump register values\n");
-	printf("reset\t-- clears all registers/memory and re-loads the program\n");
-	printf("input <reg> <val>\t-- set GPR <reg> to <val>\n");
-	printf("mdump <start> <stop>\t-- dump memory from <start> to <stop> address\n");
-	printf("high <val>\t-- set the HI register to <val>\n");
-	printf("low <val>\t-- set the LO register to <val>\n");
-	printf("print\t-- print the program loaded into memory\n");
-	printf("?\t-- display help menu\n");
-	printf("quit\t-- exit the simulator\n\n");
-	printf("------------------------------------------------------------------\n\n");
-}
-
-/***************************************************************/
-/* Read a 32-bit word from memory. */
-/***************************************************************/
-uint32_t mem_read_32(uint32_t address)
-{
-	int i;
-	for (i = 0; i < NUM_MEM_REGION; i++) {
-		if ( (address >= MEM_REGIONS[i].begin) &&  ( address <= MEM_REGIONS[i].end) ) {
-			uint32_t offset = address - MEM_REGIONS[i].begin;
-			return (MEM_REGIONS[i].mem[offset+3] << 24) |
-					(MEM_REGIONS[i].mem[offset+2] << 16) |
-					(MEM_REGIONS[i].mem[offset+1] <<  8) |
-					(MEM_REGIONS[i].mem[offset+0] <<  0);
-		}
-	}
-	return 0;
-}
-
-/***************************************************************/
-/* Write a 32-bit word to memory. */
-/***************************************************************/
-void mem_write_32(uint32_t address, uint32_t value)
-{
-	int i;
-	uint32_t offset;
-	for (i = 0; i < NUM_MEM_REGION; i++) {
-		if ( (address >= MEM_REGIONS[i].begin) && (address <= MEM_REGIONS[i].end) ) {
-			offset = address - MEM_REGIONS[i].begin;
-
-			MEM_REGIONS[i].mem[offset+3] = (value >> 24) & 0xFF;
-			MEM_REGIONS[i].mem[offset+2] = (value >> 16) & 0xFF;
-			MEM_REGIONS[i].mem[offset+1] = (value >>  8) & 0xFF;
-			MEM_REGIONS[i].mem[offset+0] = (value >>  0) & 0xFF;
-		}
-	}
-}
-
-/***************************************************************/
-/* Execute one cycle. */
-/***************************************************************/
-void cycle() {
-	handle_instruction();
-	CURRENT_STATE = NEXT_STATE;
-	INSTRUCTION_COUNT++;
-}
-
-/***************************************************************/
-/* Simulate MIPS for n cycles. */
-/***************************************************************/
-void run(int num_cycles) {
-
-	if (RUN_FLAG == FALSE) {
-		printf("Simulation Stopped\n\n");
-		return;
-	}
-
-	printf("Running simulator for %d cycles...\n\n", num_cycles);
-	int i;
-	for (i = 0; i < num_cycles; i++) {
-		if (RUN_FLAG == FALSE) {
-			printf("Simulation Stopped.\n\n");
-			break;
-		}
-		cycle();
-	}
-}
-
-/***************************************************************/
-/* simulate to completion. */
-/***************************************************************/
-void runAll() {
-	if (RUN_FLAG == FALSE) {
-		printf("Simulation Stopped.\n\n");
-		return;
-	}
-
-	printf("Simulation Started...\n\n");
-	while (RUN_FLAG){
-		cycle();
-	}
-	printf("Simulation Finished.\n\n");
-}
-
-/***************************************************************/
-/* Dump a word-aligned region of memory to the terminal. */
-/***************************************************************/
-void mdump(uint32_t start, uint32_t stop) {
-	uint32_t address;
-
-	printf("-------------------------------------------------------------\n");
-	printf("Memory content [0x%08x..0x%08x] :\n", start, stop);
-	printf("-------------------------------------------------------------\n");
-	printf("\t[Address in Hex (Dec) ]\t[Value]\n");
-	for (address = start; address <= stop; address += 4){
-		printf("\t0x%08x (%d) :\t0x%08x\n", address, address, mem_read_32(address));
-	}
-	printf("\n");
-}
-
-/***************************************************************/
-/* Dump current values of registers to the teminal. */
-/***************************************************************/
-void rdump() {
-	int i;
-	printf("-------------------------------------\n");
-	printf("Dumping Register Content\n");
-	printf("-------------------------------------\n");
-	printf("# Instructions Executed\t: %u\n", INSTRUCTION_COUNT);
-	printf("PC\t: 0x%08x\n", CURRENT_STATE.PC);
-	printf("-------------------------------------\n");
-	printf("[Register]\t[Value]\n");
-	printf("-------------------------------------\n");
-	for (i = 0; i < MIPS_REGS; i++){
-		printf("[R%d]\t: 0x%08x\n", i, CURRENT_STATE.REGS[i]);
-	}
-	printf("-------------------------------------\n");
-	printf("[HI]\t: 0x%08x\n", CURRENT_STATE.HI);
-	printf("[LO]\t: 0x%08x\n", CURRENT_STATE.LO);
-	printf("-------------------------------------\n");
-}
-
-/***************************************************************/
-/* Read a command from standard input. */
-/***************************************************************/
-void handle_command() {
-	char buffer[20];
-	uint32_t start, stop, cycles;
-	uint32_t register_no;
-	int register_value;
-	int hi_reg_value, lo_reg_value;
-
-	printf("MU-MIPS SIM:> ");
-
-	if (scanf("%s", buffer) == EOF){
-		exit(0);
-	}
-
-	switch(buffer[0]) {
-		case 'S':
-		case 's':
-			runAll();
-			break;
-		case 'M':
-		case 'm':
-			if (scanf("%x %x", &start, &stop) != 2){
-				break;
-			}
-			mdump(start, stop);
-			break;
-		case '?':
-			help();
-			break;
-		case 'Q':
-		case 'q':
-			printf("**************************\n");
-			printf("Exiting MU-MIPS! Good Bye...\n");
-			printf("**************************\n");
-			exit(0);
-		case 'R':
-		case 'r':
-			if (buffer[1] == 'd' || buffer[1] == 'D'){
-				rdump();
-			}else if(buffer[1] == 'e' || buffer[1] == 'E'){
-				reset();
-			}
-			else {
-				if (scanf("%d", &cycles) != 1) {
-					break;
-				}
-				run(cycles);
-			}
-			break;
-		case 'I':
-		case 'i':
-			if (scanf("%u %i", &register_no, &register_value) != 2){
-				break;
-			}
-			CURRENT_STATE.REGS[register_no] = register_value;
-			NEXT_STATE.REGS[register_no] = register_value;
-			break;
-		case 'H':
-		case 'h':
-			if (scanf("%i", &hi_reg_value) != 1){
-				break;
-			}
-			CURRENT_STATE.HI = hi_reg_value;
-			NEXT_STATE.HI = hi_reg_value;
-			break;
-		case 'L':
-		case 'l':
-			if (scanf("%i", &lo_reg_value) != 1){
-				break;
-			}
-			CURRENT_STATE.LO = lo_reg_value;
-			NEXT_STATE.LO = lo_reg_value;
-			break;
-		case 'P':
-		case 'p':
-			print_program();
-			break;
-		default:
-			printf("Invalid Command.\n");
-			break;
-	}
-}
-
-/***************************************************************/
-/* reset registers/memory and reload program. */
-/***************************************************************/
-void reset() {
-	int i;
-	/*reset registers*/
-	for (i = 0; i < MIPS_REGS; i++){
-		CURRENT_STATE.REGS[i] = 0;
-	}
-	CURRENT_STATE.HI = 0;
-	CURRENT_STATE.LO = 0;
-
-	for (i = 0; i < NUM_MEM_REGION; i++) {
-		uint32_t region_size = MEM_REGIONS[i].end - MEM_REGIONS[i].begin + 1;
-		memset(MEM_REGIONS[i].mem, 0, region_size);
-	}
-
-	/*load program*/
-	load_program();
-
-	/*reset PC*/
-	INSTRUCTION_COUNT = 0;
-	CURRENT_STATE.PC =  MEM_TEXT_BEGIN;
-	NEXT_STATE = CURRENT_STATE;
-	RUN_FLAG = TRUE;
-}
-
-/***************************************************************/
-/* Allocate and set memory to zero. */
-/***************************************************************/
-void init_memory() {
-	int i;
-	for (i = 0; i < NUM_MEM_REGION; i++) {
-		uint32_t region_size = MEM_REGIONS[i].end - MEM_REGIONS[i].begin + 1;
-		MEM_REGIONS[i].mem = malloc(region_size);
-		memset(MEM_REGIONS[i].mem, 0, region_size);
-	}
-}
-
-/**************************************************************/
-/* load program into memory. */
-/**************************************************************/
-void load_program() {
-	FILE * fp;
-	int i, word;
-	uint32_t address;
-
-	/* Open program file. */
-	fp = fopen(prog_file, "r");
-	if (fp == NULL) {
-		printf("Error: Can't open program file %s\n", prog_file);
-		exit(-1);
-	}
-
-	/* Read in the program. */
-
-	i = 0;
-	while( fscanf(fp, "%x\n", &word) != EOF ) {
-		address = MEM_TEXT_BEGIN + i;
-		mem_write_32(address, word);
-		printf("writing 0x%08x into address 0x%08x (%d)\n", word, address, address);
-		i += 4;
-	}
-	PROGRAM_SIZE = i/4;
-	printf("Program loaded into memory.\n%d words written into memory.\n\n", PROGRAM_SIZE);
-	fclose(fp);
-}
-
-void getSingleInstruct(MIPS* instrAddress){
-	uint32_t instr = mem_read_32(CURRENT_STATE.PC);
-
-	char string[9];
-	sprintf(string,"%08x", instr);
-
-	char fullbinary[33];
-	fullbinary[0] = '\0';
-
-	for(int i = 0; i < 9; i++)
-	{
-		strcat(fullbinary, hex_to_binary(string[i]));
-	}
-
-	// Check for syscall
-	if(instr == 0xC){
-		instrAddress->op = "SYSCALL";
-		printf("SYSCALL\n");
-		return;
-	}
-
-	switch(FindFormat(fullbinary)) {
-		case 'R': {
-			returnRFormat(fullbinary,instrAddress);
-			break;
-		}
-		case 'I': {
-			returnIFormat(fullbinary,instrAddress);
-			break;
-		}
-		case 'J': {
-			returnJFormat(fullbinary,instrAddress);
-			break;
-		}
-		default: {
-			printf("You messed up.\n");
-			break;
-		}
-	}
-}
-
-/************************************************************/
-/* decode and execute instruction. */
-/************************************************************/
-void handle_instruction()
-{
-	CURRENT_STATE = NEXT_STATE;
-	/* execute one instruction at a time. Use/update CURRENT_STATE and and NEXT_STATE, as necessary.*/
-	MIPS instruct;
-	getSingleInstruct(&instruct);
-
-   //****************************** ALU INSTRUCTIONS ******************************
-	if(!strcmp(instruct.op, "ADD")){
-		CURRENT_STATE.REGS[instruct.rd] = CURRENT_STATE.REGS[instruct.rs] + CURRENT_STATE.REGS[instruct.rt];
-	}
-	else if(!strcmp(instruct.op, "ADDU")){
-		CURRENT_STATE.REGS[instruct.rd] = CURRENT_STATE.REGS[instruct.rs] + CURRENT_STATE.REGS[instruct.rt];
-	}
-	else if(!strcmp(instruct.op, "ADDI")){
-		CURRENT_STATE.REGS[instruct.rt] = CURRENT_STATE.REGS[instruct.rs] + instruct.immediate;
-	}
-	else if(!strcmp(instruct.op, "ADDIU")){
-		CURRENT_STATE.REGS[instruct.rt] = CURRENT_STATE.REGS[instruct.rs] + instruct.immediate;
-	}
-	else if(!strcmp(instruct.op, "SUB")){
-		CURRENT_STATE.REGS[instruct.rd] = CURRENT_STATE.REGS[instruct.rs] - CURRENT_STATE.REGS[instruct.rt];
-	}
-	else if(!strcmp(instruct.op, "SUBU")){
-		CURRENT_STATE.REGS[instruct.rd] = CURRENT_STATE.REGS[instruct.rs] - CURRENT_STATE.REGS[instruct.rt];
-	}
-	else if(!strcmp(instruct.op, "MULT")){
-		uint64_t product = CURRENT_STATE.REGS[instruct.rs] * CURRENT_STATE.REGS[instruct.rt];
-		CURRENT_STATE.HI = product >> 32;
-		CURRENT_STATE.LO = (product << 32) >> 32; 
-	}
-	else if(!strcmp(instruct.op, "MULTU")){
-		uint64_t product = CURRENT_STATE.REGS[instruct.rs] * CURRENT_STATE.REGS[instruct.rt];
-		CURRENT_STATE.HI = product >> 32;
-		CURRENT_STATE.LO = (product << 32) >> 32; 
-	}
-	else if(!strcmp(instruct.op, "DIV")){
-		CURRENT_STATE.HI = CURRENT_STATE.REGS[instruct.rs] % CURRENT_STATE.REGS[instruct.rt];
-		CURRENT_STATE.LO = CURRENT_STATE.REGS[instruct.rs] / CURRENT_STATE.REGS[instruct.rt];
-	}
-	else if(!strcmp(instruct.op, "DIVU")){
-		CURRENT_STATE.HI = CURRENT_STATE.REGS[instruct.rs] % CURRENT_STATE.REGS[instruct.rt];
-		CURRENT_STATE.LO = CURRENT_STATE.REGS[instruct.rs] / CURRENT_STATE.REGS[instruct.rt];
-	}
-	else if(!strcmp(instruct.op, "AND")){
-		CURRENT_STATE.REGS[instruct.rd] = CURRENT_STATE.REGS[instruct.rs] & CURRENT_STATE.REGS[instruct.rt];
-	}
-	else if(!strcmp(instruct.op, "ANDI")){
-		// Check and see if this is what it actually should be
-		CURRENT_STATE.REGS[instruct.rt] = CURRENT_STATE.REGS[instruct.rs] & instruct.immediate;
-	}
-	else if(!strcmp(instruct.op, "OR")){
-		CURRENT_STATE.REGS[instruct.rd] = CURRENT_STATE.REGS[instruct.rs] | CURRENT_STATE.REGS[instruct.rt];
-	}
-	else if(!strcmp(instruct.op, "ORI")){
-		// Check and see if this is what it actually should be
-		CURRENT_STATE.REGS[instruct.rt] = CURRENT_STATE.REGS[instruct.rs] | instruct.immediate;
-	}
-	else if(!strcmp(instruct.op, "XOR")){
-		CURRENT_STATE.REGS[instruct.rd] = CURRENT_STATE.REGS[instruct.rs] ^ CURRENT_STATE.REGS[instruct.rt];
-	}
-	else if(!strcmp(instruct.op, "XORI")){
-		// Check and see if this is what it actually should be
-		CURRENT_STATE.REGS[instruct.rt] = CURRENT_STATE.REGS[instruct.rs] ^ instruct.immediate;
-	}
-	else if(!strcmp(instruct.op, "NOR")){
-		CURRENT_STATE.REGS[instruct.rd] = !(CURRENT_STATE.REGS[instruct.rs] | CURRENT_STATE.REGS[instruct.rt]);
-	}
-	else if(!strcmp(instruct.op, "SLT")){
-		if(instruct.rs < instruct.rt){
-			CURRENT_STATE.REGS[instruct.rd] = 1;
-		}
-		else{
-			CURRENT_STATE.REGS[instruct.rd] = 0;
-		}
-	}
-	else if(!strcmp(instruct.op, "SLTI")){
-		if(instruct.rs < instruct.immediate){
-			CURRENT_STATE.REGS[instruct.rd] = 1;
-		}
-		else{
-			CURRENT_STATE.REGS[instruct.rd] = 0;
-		}
-	}
-	else if(!strcmp(instruct.op, "SLL")){
-		CURRENT_STATE.REGS[instruct.rd] = CURRENT_STATE.REGS[instruct.rs] << instruct.shamt;
-	}
-	else if(!strcmp(instruct.op, "SRL")){
-		// What is the difference between this and SRA
-		CURRENT_STATE.REGS[instruct.rd] = CURRENT_STATE.REGS[instruct.rs] >> instruct.shamt;
-	}
-	else if(!strcmp(instruct.op, "SRA")){
-		CURRENT_STATE.REGS[instruct.rd] = CURRENT_STATE.REGS[instruct.rs] >> instruct.shamt;
-	}
-	//****************************** Load/Store INSTRUCTIONS ******************************
-	else if(!strcmp(instruct.op, "LUI")){
-		CURRENT_STATE.REGS[instruct.rt] = instruct.immediate;
-		CURRENT_STATE.REGS[instruct.rt] = CURRENT_STATE.REGS[instruct.rt] << 16;
-	}
-	else if(!strcmp(instruct.op, "LW")){
-		uint32_t memAddress = (uint32_t)instruct.rs + instruct.immediate + MEM_DATA_BEGIN;
-		uint32_t mem = mem_read_32(memAddress);
-		CURRENT_STATE.REGS[instruct.rt] = mem;
-	}
-	else if(!strcmp(instruct.op, "SW")){
-		uint32_t memAddress = (uint32_t)instruct.rs + instruct.immediate + MEM_DATA_BEGIN;
-		mem_write_32(memAddress,(uint32_t)instruct.rt);
-	}
-	else if(!strcmp(instruct.op, "LB")){
-		uint32_t memAddress = (uint32_t)instruct.rs + instruct.immediate + MEM_DATA_BEGIN;
-		uint32_t mem = mem_read_32(memAddress);
-		CURRENT_STATE.REGS[instruct.rt] = mem;
-	}
-	else if(!strcmp(instruct.op, "LH")){
-		uint32_t memAddress = (uint32_t)instruct.rs + instruct.immediate + MEM_DATA_BEGIN;
-		uint32_t mem = mem_read_32(memAddress);
-		CURRENT_STATE.REGS[instruct.rt] = mem;
-	}
-	else if(!strcmp(instruct.op, "SB")){
-		uint32_t memAddress = (uint32_t)instruct.rs + instruct.immediate + MEM_DATA_BEGIN;
-		mem_write_32(memAddress,(uint32_t)instruct.rt);
-	}
-	else if(!strcmp(instruct.op, "SH")){
-		uint32_t memAddress = (uint32_t)instruct.rs + instruct.immediate + MEM_DATA_BEGIN;
-		mem_write_32(memAddress,(uint32_t)instruct.rt);
-	}
-	else if(!strcmp(instruct.op, "MFHI")){
-		CURRENT_STATE.REGS[instruct.rd] = CURRENT_STATE.HI;
-	}
-	else if(!strcmp(instruct.op, "MFLO")){
-		CURRENT_STATE.REGS[instruct.rd] = CURRENT_STATE.LO;
-	}
-	else if(!strcmp(instruct.op, "MTHI")){
-		CURRENT_STATE.HI = CURRENT_STATE.REGS[instruct.rs];
-	}
-	else if(!strcmp(instruct.op, "MTLO")){
-		CURRENT_STATE.LO = CURRENT_STATE.REGS[instruct.rs];
-	}
-
-	//******************************* Control Flow INSTRUCTIONS *************************** BEQ, BNE, BLEZ, BLTZ, BGEZ, BGTZ, J, JR, JAL,JALR
-    else if(!strcmp(instruct.op, "BEQ")) {
-		 if(CURRENT_STATE.REGS[instruct.rt] == CURRENT_STATE.REGS[instruct.rs]){
-			 uint32_t memAddress = strtoul(instruct.address, NULL, 2);
-			 CURRENT_STATE.PC = (memAddress << 2);
-			 NEXT_STATE = CURRENT_STATE;
-			 return;
-		 }
-    }
-    else if(!strcmp(instruct.op, "BNE")) {
-		 if(CURRENT_STATE.REGS[instruct.rt] != CURRENT_STATE.REGS[instruct.rs]){
-			 uint32_t memAddress = strtoul(instruct.address, NULL, 2);
-			 CURRENT_STATE.PC = (memAddress << 2);
-			 NEXT_STATE = CURRENT_STATE;
-			 return;
-		 }
-    }
-    else if(!strcmp(instruct.op, "BLEZ")) {
-		 if(CURRENT_STATE.REGS[instruct.rt] <= 0){
-			 uint32_t memAddress = strtoul(instruct.address, NULL, 2);
-			 CURRENT_STATE.PC = (memAddress << 2);
-			 NEXT_STATE = CURRENT_STATE;
-			 return;
-		 }
-    }
-    else if(!strcmp(instruct.op, "BGEZ")) {
-		 if(CURRENT_STATE.REGS[instruct.rt] >= 0){
-			 uint32_t memAddress = strtoul(instruct.address, NULL, 2);
-			 CURRENT_STATE.PC = (memAddress << 2);
-			 NEXT_STATE = CURRENT_STATE;
-			 return;
-		 }
-    }
-    else if(!strcmp(instruct.op, "BGTZ")) {
-		 if(CURRENT_STATE.REGS[instruct.rt] > 0){
-			 uint32_t memAddress = strtoul(instruct.address, NULL, 2);
-			 CURRENT_STATE.PC = (memAddress << 2);
-			 NEXT_STATE = CURRENT_STATE;
-			 return;
-		 }
-    }
-	else if(!strcmp(instruct.op, "J")) {
-        uint32_t memAddress = strtoul(instruct.address, NULL, 2);
-		printf("the address is %x\n", memAddress);
-		CURRENT_STATE.PC = NEXT_STATE.PC;
-        NEXT_STATE.PC = (CURRENT_STATE.PC & 0xf0000000) | (memAddress << 2);
-		return;
-    }
-    else if(!strcmp(instruct.op, "JR")) {
-		CURRENT_STATE.PC = NEXT_STATE.PC;
-        NEXT_STATE.PC = CURRENT_STATE.REGS[instruct.rs];
-		return;
-    }
-    else if(!strcmp(instruct.op, "JAL")) {
-        uint32_t memAddress = strtoul(instruct.address, NULL, 2);
-		CURRENT_STATE.REGS[31] = CURRENT_STATE.PC << 2;
-
-        CURRENT_STATE.PC = NEXT_STATE.PC;
-        NEXT_STATE.PC = (CURRENT_STATE.PC & 0xf0000000) | (memAddress << 2);
-		return;
-    }
-    else if(!strcmp(instruct.op, "JALR")) {
-		CURRENT_STATE.REGS[31] = CURRENT_STATE.PC << 2;
-
-        CURRENT_STATE.PC = NEXT_STATE.PC;
-        NEXT_STATE.PC = CURRENT_STATE.REGS[instruct.rs];
-		return;
-    }
-
-
-	//******************************* Sys Call INSTRUCTIONS *************************** 
-	 else if(!strcmp(instruct.op, "SYSCALL")) {
-		if(CURRENT_STATE.REGS[2] == 0xA)
-			RUN_FLAG = FALSE;
-    }
-
-	NEXT_STATE = CURRENT_STATE;
-	NEXT_STATE.PC = CURRENT_STATE.PC + 4;
-
-}
-
-/************************************************************/
-/* Initialize Memory. */
-/************************************************************/
-void initialize() {
-	init_memory();
-	CURRENT_STATE.PC = MEM_TEXT_BEGIN;
-	NEXT_STATE = CURRENT_STATE;
-	RUN_FLAG = TRUE;
-}
-
-/************************************************************/
-/* Print the program loaded into memory (in MIPS assembly format). */
-/************************************************************/
-void print_program(){
-	int i;
-	uint32_t addr;
-
-	for(i=0; i<PROGRAM_SIZE; i++){
-		addr = MEM_TEXT_BEGIN + (i*4);
-		printf("[0x%x]\t", addr);
-		print_instruction(addr);
-	}
-}
-
-char* hex_to_binary(char Hexdigit)
-{
-	if(isalpha(Hexdigit))
-		Hexdigit = toupper(Hexdigit);
-
-	switch (Hexdigit)
-	{
-	case ' ':
-		return "0000";
-	case '0':
-		return "0000";
-	case '1':
-		return "0001";
-	case '2':
-		return "0010";
-	case '3':
-		return "0011";
-	case '4':
-		return "0100";
-	case '5':
-		return "0101";
-	case '6':
-		return "0110";
-	case '7':
-		return "0111";
-	case '8':
-		return "1000";
-	case '9':
-		return "1001";
-	case 'A':
-		return "1010";
-	case 'B':
-		return "1011";
-	case 'C':
-		return "1100";
-	case 'D':
-		return "1101";
-	case 'E':
-		return "1110";
-	case 'F':
-		return "1111";
-	default:
-		return "\0";
-		break;
-	}
-}
-
-char FindFormat(char* instruction)
-{
-	char opcode[7];
-	strncpy(opcode,instruction, 6);
-	opcode[6] = '\0';
-
-	if(!strcmp(opcode, "000000"))
-	{
-		return 'R';
-	}
-	else if (!strcmp(opcode, "000010") || !strcmp(opcode, "000011"))
-	{
-		return 'J';
-	}
-	else
-	{
-		return 'I';
-	}
-}
-
-char* GetRFunction(char* instruction)
-{
-	if(!strcmp(instruction, "100000"))
-	{
-		return "ADD";
-	}
-	if(!strcmp(instruction, "100001"))
-	{
-		return "ADDU";
-	}
-	if(!strcmp(instruction, "100010"))
-	{
-		return "SUB";
-	}
-	if(!strcmp(instruction, "100011"))
-	{
-		return "SUBU";
-	}
-	if(!strcmp(instruction, "011000"))
-	{
-		return "MULT";
-	}
-	if(!strcmp(instruction, "011001"))
-	{
-		return "MULTU";
-	}
-	if(!strcmp(instruction, "011010"))
-	{
-		return "DIV";
-	}
-	if(!strcmp(instruction, "011011"))
-	{
-		return "DIVU";
-	}
-	if(!strcmp(instruction, "100100"))
-	{
-		return "AND";
-	}
-	if(!strcmp(instruction, "100101"))
-	{
-		return "OR";
-	}
-	if(!strcmp(instruction, "100110"))
-	{
-		return "XOR";
-	}
-	if(!strcmp(instruction, "100111"))
-	{
-		return "NOR";
-	}
-	if(!strcmp(instruction, "101010"))
-	{
-		return "SLT";
-	}
-	if(!strcmp(instruction, "000000"))
-	{
-		return "SLL";
-	}
-	if(!strcmp(instruction, "000010"))
-	{
-		return "SRL";
-	}
-	if(!strcmp(instruction, "000011"))
-	{
-		return "SRA";
-	}
-	if(!strcmp(instruction, "010000"))
-	{
-		return "MFHI";
-	}
-	if(!strcmp(instruction, "010010"))
-	{
-		return "MFLO";
-	}
-	if(!strcmp(instruction, "010001"))
-	{
-		return "MTHI";
-	}
-	if(!strcmp(instruction, "010011"))
-	{
-		return "MTLO";
-	}
-	if(!strcmp(instruction, "001000"))
-	{
-		return "JR";
-	}
-	if(!strcmp(instruction, "001001"))
-	{
-		return "JALR";
-	}
-	return NULL;
-}
-
-char* GetIFunction(char* instruction, char* rt)
-{
-	if(!strcmp(instruction, "001000"))
-	{
-		return "ADDI";
-	}
-	else if(!strcmp(instruction, "001001"))
-	{
-		return "ADDIU";
-	}
-	else if(!strcmp(instruction, "001100"))
-	{
-		return "ANDI";
-	}
-	else if(!strcmp(instruction, "001101"))
-	{
-		return "ORI";
-	}
-	else if(!strcmp(instruction, "001110"))
-	{
-		return "XORI";
-	}
-	else if(!strcmp(instruction, "001010"))
-	{
-		return "SLTI";
-	}
-	else if(!strcmp(instruction, "100011"))
-	{
-		return "LW";
-	}
-	else if(!strcmp(instruction, "100000"))
-	{
-		return "LB";
-	}
-	else if(!strcmp(instruction, "100001"))
-	{
-		return "LH";
-	}
-	else if(!strcmp(instruction, "001111"))
-	{
-		return "LUI";
-	}
-	else if(!strcmp(instruction, "101011"))
-	{
-		return "SW";
-	}
-	else if(!strcmp(instruction, "101000"))
-	{
-		return "SB";
-	}
-	else if(!strcmp(instruction, "101001"))
-	{
-		return "SH";
-	}
-	else if(!strcmp(instruction, "000100"))
-	{
-		return "BEQ";
-	}
-	else if(!strcmp(instruction, "000101"))
-	{
-		return "BNE";
-	}
-	else if(!strcmp(instruction, "000110"))
-	{
-		return "BLEZ";
-	}
-	else if(!strcmp(instruction, "000001") && !strcmp(rt, "00000"))
-	{
-		return "BLTZ";
-	}
-	else if(!strcmp(instruction, "000001") && !strcmp(rt, "00001"))
-	{
-		return "BGEZ";
-	}
-	else if(!strcmp(instruction, "000111"))
-	{
-		return "BGTZ";
-	}
-	else{
-		return "Instruction not found";
-	}
-
-	return NULL;
-}
-
-char* GetJFunction(char* instruction)
-{
-	if(!strcmp(instruction, "000010"))
-	{
-		return "J";
-	}
-	if(!strcmp(instruction, "000011"))
-	{
-		return "JAL";
-	}
-	if(!strcmp(instruction, "000011"))
-	{
-		return "JAL";
-	}
-	return NULL;
-}
-
-int convertBinarytoDecimal(char * binary) {
-	int num = atoi(binary);
-    unsigned int dec_value = 0;
-
-    // Initializing base value to 1, i.e 2^0
-    int base = 1;
-
-    unsigned int temp = num;
-    while (temp) {
-        int last_digit = temp % 10;
-        temp = temp / 10;
-
-        dec_value += last_digit * base;
-
-        base = base * 2;
-    }
-
-    return dec_value;
-}
-
-
-void returnRFormat(char* instruction, MIPS* hold) {
-	// Read in the rs register
-	char rs[6];
-	strncpy(rs, &instruction[6], 5);
-	rs[5] = '\0';
-
-	// Read in the rt register
-	char rt[6];
-	strncpy(rt, &instruction[11], 5);
-	rt[5] = '\0';
-
-	// read in the rd register
-	char rd[6];
-	strncpy(rd, &instruction[16], 5);
-	rd[5] = '\0';
-
-	// read in the op code
-	char op[7];
-	strncpy(op, &instruction[0], 6);
-	op[6] = '\0';
-
-	char shamnt[6];
-	strncpy(shamnt, &instruction[21],5);
-	shamnt[5] = '\0';
-
-	char func[7];
-	strncpy(func, &instruction[26],6);
-	func[6] = '\0';
-
-	printf("%s %s, %s, %s\n",GetRFunction(func),returnRegister(rd), returnRegister(rs), returnRegister(rt));
-	hold->op = GetRFunction(func);
-	hold->rd = convertBinarytoDecimal(rd);
-	hold->rs = convertBinarytoDecimal(rs);
-	hold->rt = convertBinarytoDecimal(rt);
-	hold->shamt = atoi(shamnt);
-	hold->funct = func;
-	hold->immediate = 0;
-}
-
-void returnIFormat(char* instruction, MIPS* hold) {
-	// read in the rs register
-	char rs[6];
-	strncpy(rs, &instruction[6], 5);
-	rs[5] = '\0';
-
-	// read in the rt register
-	char rt[6];
-	strncpy(rt, &instruction[11], 5);
-	rt[5] = '\0';
-
-	// read in the imm value and convert to decimal
-	char imm[17];
-	strncpy(imm, &instruction[16], 16);
-	imm[16] = '\0';
-	long unsigned int imm_hex = strtol(imm, NULL, 2);
-
-	// read in the op code
-	char op[7];
-	strncpy(op, &instruction[0], 6);
-	op[6] = '\0';
-
-	if(!strcmp(GetIFunction(op, rt), "LUI"))
-	{
-		printf("%s %s, x%lx\n",GetIFunction(op, rt),returnRegister(rt), imm_hex);
-		hold->op = GetIFunction(op,rt);
-		hold->rt = convertBinarytoDecimal(rt);
-		hold->rs = -1;
-		hold->immediate = imm_hex;
-		hold->shamt = 0;
-		hold->funct = "";
-		hold->rd = -1;
-		hold->address = "";
-	}
-	else if(!strcmp(GetIFunction(op, rt), "SW") || !strcmp(GetIFunction(op, rt), "SB") || !strcmp(GetIFunction(op, rt), "SH"))
-	{
-		printf("%s %s, %d(%s)\n",GetIFunction(op, rt),returnRegister(rs),(int)imm_hex,returnRegister(rt));
-		hold->op = GetIFunction(op,rt);
-		hold->rs = convertBinarytoDecimal(rs);
-		hold->rt = convertBinarytoDecimal(rt);
-		hold->immediate = imm_hex;
-		hold->shamt = 0;
-		hold->funct = "";
-		hold->rd = -1;
-		hold->address = "";
-	}
-	else if(!strcmp(GetIFunction(op, rt), "LW"))
-	{
-		printf("%s %s, %d(%s)\n",GetIFunction(op, rt),returnRegister(rt),(int)imm_hex,returnRegister(rs));
-		hold->op = GetIFunction(op,rt);
-		hold->rs = convertBinarytoDecimal(rs);
-		hold->rt = convertBinarytoDecimal(rt);
-		hold->immediate = imm_hex;
-		hold->shamt = 0;
-		hold->funct = "";
-		hold->rd = -1;
-		hold->address = "";
-	}
-	else if(!strcmp(GetIFunction(op, rt), "BEQ") || !strcmp(GetIFunction(op, rt), "BNE"))
-	{
-		printf("%s %s, %s, %ld\n",GetIFunction(op, rt),returnRegister(rs),returnRegister(rt), imm_hex);
-		hold->op = GetIFunction(op,rt);
-		hold->rs = convertBinarytoDecimal(rs);
-		hold->rt = convertBinarytoDecimal(rt);
-		hold->immediate = imm_hex;
-		hold->shamt = 0;
-		hold->funct = "";
-		hold->rd = -1;
-		hold->address = "";
-	}
-	else
-	{
-		printf("%s %s, %s, %ld\n",GetIFunction(op, rt),returnRegister(rt), returnRegister(rs), imm_hex);
-		hold->op = GetIFunction(op,rt);
-		hold->rs = convertBinarytoDecimal(rs);
-		hold->rt = convertBinarytoDecimal(rt);
-		hold->immediate = imm_hex;
-		hold->shamt = 0;
-		hold->funct = "";
-		hold->rd = -1;
-		hold->address = "";
-	}
-}
-
-void returnJFormat(char* instruction, MIPS* hold) {
-	// read in the op code
-	char op[7];
-	strncpy(op, &instruction[0], 6);
-	op[6] = '\0';
-
-	// read in the Jump Addresss
-	char address[27];
-	strncpy(address, &instruction[6], 26);
-	address[26] = '\0';
-	int hex = strtoul(address, NULL, 2);
-
-	printf("%s 0x%x\n", GetJFunction(op), hex);
-	
-	hold->op = GetJFunction(op);
-	hold->rs = -1;
-	hold->rt = -1;
-	hold->immediate = 0;
-	hold->shamt = 0;
-	hold->funct = "";
-	hold->rd = -1;
-	hold->address = address;
-}
-
-char* returnRegister(char* reg){
-	if (!strcmp(reg, "00000")) return "$zero";
-	if (!strcmp(reg, "00001")) return "$at";
-	if (!strcmp(reg, "00010")) return "$v0";
-	if (!strcmp(reg, "00011")) return "$v1";
-	if (!strcmp(reg, "00100")) return "$a0";
-	if (!strcmp(reg, "00101")) return "$a1";
-	if (!strcmp(reg, "00110")) return "$a2";
-	if (!strcmp(reg, "00111")) return "$a3";
-	if (!strcmp(reg, "01000")) return "$t0";
-	if (!strcmp(reg, "01001")) return "$t1";
-	if (!strcmp(reg, "01010")) return "$t2";
-	if (!strcmp(reg, "01011")) return "$t3";
-	if (!strcmp(reg, "01100")) return "$t4";
-	if (!strcmp(reg, "01101")) return "$t5";
-	if (!strcmp(reg, "01110")) return "$t6";
-	if (!strcmp(reg, "01111")) return "$t7";
-	if (!strcmp(reg, "10000")) return "$s0";
-	if (!strcmp(reg, "10001")) return "$s1";
-	if (!strcmp(reg, "10010")) return "$s2";
-	if (!strcmp(reg, "10011")) return "$s3";
-	if (!strcmp(reg, "10100")) return "$s4";
-	if (!strcmp(reg, "10101")) return "$s5";
-	if (!strcmp(reg, "10110")) return "$s6";
-	if (!strcmp(reg, "10111")) return "$s7";
-	if (!strcmp(reg, "11000")) return "$t8";
-	if (!strcmp(reg, "11001")) return "$t9";
-	if (!strcmp(reg, "11010")) return "$k0";
-	if (!strcmp(reg, "11011")) return "$k1";
-	if (!strcmp(reg, "11100")) return "$gp";
-	if (!strcmp(reg, "11101")) return "$sp";
-	if (!strcmp(reg, "11110")) return "$fp";
-	if (!strcmp(reg, "11111")) return "$ra";
-	return NULL;
-}
-
-/************************************************************/
-/* Print the instruction at given memory address (in MIPS assembly format). */
-/************************************************************/
-void print_instruction(uint32_t addr){
-	//Read in the instructions
-	uint32_t instr = mem_read_32(addr);
-	char string[9];
-
-	sprintf(string,"%08x", instr);
-
-	char fullbinay[33];
-	fullbinay[0] = '\0';
-
-	MIPS junk;
-	for(int i = 0; i < 8; i++)
-	{
-		strcat(fullbinay, hex_to_binary(string[i]));
-	}
-
-	// Check for syscall
-	if(instr == 0xC){
-		junk.op = "SYSCALL";
-		printf("SYSCALL\n");
-		return;
-	}
-		
-	switch(FindFormat(fullbinay)) {
-		case 'R': {
-			returnRFormat(fullbinay,&junk);
-			break;
-		}
-		case 'I': {
-			returnIFormat(fullbinay,&junk);
-			break;
-		}
-		case 'J': {
-			returnJFormat(fullbinay,&junk);
-			break;
-		}
-		default: {
-			printf("You messed up.\n");
-			break;
-		}
-	}
-}
-
-/***************************************************************/
-/* Main function. */
-/***************************************************************/
-int main(int argc, char *argv[]) {
-	printf("\n**************************\n");
-	printf("Welcome to MU-MIPS SIM...\n");
-	printf("**************************\n\n");
-
-	if (argc < 2) {
-		printf("Error: You should provide input file.\nUsage: %s <input program> \n\n",  argv[0]);
-		exit(1);
-	}
-
-	strcpy(prog_file, argv[1]);
-	initialize();
-	load_program();
-	help();
-	while (1){
-		handle_command();
-	}
-	return 0;
-}
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <assert.h>
+#include <ctype.h>
+#include <math.h>
+#include <unistd.h>
+#include <time.h>
+#include <getopt.h>
+#include <sys/mman.h>
+
+#include "mu-mips.h"
+#include "mu-block.h"
+#include "mu-loader.h"
+#include "mu-regress.h"
+#include "mu-bench.h"
+#include "mu-snapshot.h"
+#include "mu-diff.h"
+#include "mu-pipeline.h"
+#include "mu-cache.h"
+#include "mu-predict.h"
+#include "mu-disasm.h"
+#include "mu-jit.h"
+#include "mu-profile.h"
+#include "mu-debug.h"
+#include "mu-trace.h"
+#include "mu-replay.h"
+#include "mu-sample.h"
+
+/***************************************************************/
+/* Memory regions (declared in mu-mips.h). */
+/***************************************************************/
+const mem_region_t MEM_REGIONS[] = {
+	{ MEM_TEXT_BEGIN, MEM_TEXT_END },
+	{ MEM_DATA_BEGIN, MEM_DATA_END },
+	{ MEM_KDATA_BEGIN, MEM_KDATA_END },
+	{ MEM_KTEXT_BEGIN, MEM_KTEXT_END }
+};
+
+/***************************************************************/
+/* Create a simulator with empty memory and default settings. */
+/***************************************************************/
+sim_context* sim_create() {
+	sim_context *ctx = calloc(1, sizeof(sim_context));
+
+	if (ctx == NULL) {
+		printf("Error: Can't allocate simulator context\n");
+		exit(-1);
+	}
+	ctx->PROGRAM_ENTRY = MEM_TEXT_BEGIN;
+	ctx->PROG_FORMAT = FORMAT_AUTO;
+	ctx->ENGINE = ENGINE_BLOCK;
+	ctx->VERBOSITY = VERBOSITY_SUMMARY;
+	tlb_flush(ctx);
+	return ctx;
+}
+
+/***************************************************************/
+/* Release everything a simulator owns, including its trace file. */
+/***************************************************************/
+void sim_destroy(sim_context *ctx) {
+	if (ctx == NULL) {
+		return;
+	}
+	trace_stop(ctx);
+	snapshot_free(ctx->LOAD_SNAPSHOT);
+	snapshot_free(ctx->USER_SNAPSHOT);
+	free_memory(ctx);
+	free(ctx->HOST_MAPPINGS);
+	free(ctx->DIRTY_PAGES);
+	free(ctx->DECODE_CACHE);
+	free(ctx->DECODE_WORDS);
+	ctx->DECODE_CACHE_SIZE = 0;
+	block_cache_flush(ctx);
+	jit_free(ctx);
+	stats_reset(ctx);
+	free(ctx->PC_COUNT);
+	free(ctx->PIPELINE);
+	cache_free(ctx->CACHES);
+	predict_free(ctx->PREDICTORS);
+	profile_free(ctx->PROFILER);
+	debug_free(ctx->DEBUG);
+	replay_free(ctx->REPLAY);
+	sample_free(ctx->SAMPLER);
+	if (ctx->TRACE_FILE != NULL) {
+		fclose(ctx->TRACE_FILE);
+	}
+	free(ctx);
+}
+
+/***************************************************************/
+/* Print out a list of commands available. */
+/***************************************************************/
+void help() {
+	printf("------------------------------------------------------------------\n\n");
+	printf("\t**********MU-MIPS Help MENU**********\n\n");
+	printf("sim\t-- simulate program to completion \n");
+	printf("run <n>\t-- simulate program for <n> instructions\n");
+	printf("break <addr>\t-- stop before the instruction at <addr>\n");
+	printf("watch <addr> [r|w|rw]\t-- stop after the word at <addr> is read and/or written (default w)\n");
+	printf("delete <addr>\t-- remove the breakpoint and watchpoint at <addr>\n");
+	printf("continue\t-- run until the program ends or stops at a breakpoint or watchpoint\n");
+	printf("replay <spec>\t-- checkpoint as the program runs so it can be run backwards: on, off, every:<n>, budget:<MB>\n");
+	printf("rstep <n>\t-- go back <n> instructions\n");
+	printf("rcontinue\t-- go back to the last breakpoint or watchpoint hit\n");
+	printf("rdump\t-- dump register values\n");
+	printf("stats\t-- print the instruction mix and the hottest PCs\n");
+	printf("reset\t-- clears all registers/memory and re-loads the program\n");
+	printf("snapshot\t-- save registers and memory\n");
+	printf("restore\t-- go back to the saved snapshot\n");
+	printf("diff\t-- list where registers and memory differ from the snapshot\n");
+	printf("input <reg> <val>\t-- set GPR <reg> to <val>\n");
+	printf("mdump <start> <stop>\t-- dump memory from <start> to <stop> address\n");
+	printf("high <val>\t-- set the HI register to <val>\n");
+	printf("low <val>\t-- set the LO register to <val>\n");
+	printf("print\t-- print the program loaded into memory\n");
+	printf("verbose <n>\t-- 0 quiet, 1 summary, 2 trace every instruction\n");
+	printf("tracefile <file>\t-- write the trace to <file> (- for stdout)\n");
+	printf("record <file|off>\t-- record every instruction to a binary trace (read it with mu-trace-dump)\n");
+	printf("engine <interp|block|jit>\t-- select the execution engine\n");
+	printf("pipeline <config>\t-- pipeline timing model: off, or on / fwd|nofwd,id|ex\n");
+	printf("predict <spec>\t-- add a branch predictor: nottaken, bimodal|gshare|tournament[:<bits>[:<history>]], btb:<n>, ras:<n>, penalty:<n>, off\n");
+	printf("profile <spec>\t-- call-graph profiler: on, off, every:<n>, out:<file>, syms:<file>\n");
+	printf("sample <spec>\t-- sample the timing models: on, off, period:<n>, warm:<n>, detail:<n>, simpoint:<phases>, per:<n>\n");
+	printf("cache <spec>\t-- cache model: on, off, mem:<cycles>, l1i|l1d|l2:<size>:<ways>:<line>[:lru|plru|random][:wb|wt][:<cycles>]\n");
+	printf("?\t-- display help menu\n");
+	printf("quit\t-- exit the simulator\n\n");
+	printf("------------------------------------------------------------------\n\n");
+}
+
+/***************************************************************/
+/* Allocate a zeroed page with a reference count of one. */
+/***************************************************************/
+uint8_t* mem_page_alloc()
+{
+	uint8_t *block;
+
+	if (posix_memalign((void **)&block, PAGE_HEADER_SIZE, PAGE_HEADER_SIZE + PAGE_SIZE) != 0) {
+		printf("Error: Can't allocate memory page\n");
+		exit(-1);
+	}
+	memset(block + PAGE_HEADER_SIZE, 0, PAGE_SIZE);
+	*(int *)block = 1;
+	return block + PAGE_HEADER_SIZE;
+}
+
+/* Pages in a program file are owned by its mapping, not counted. */
+/* Counts are atomic: snapshots may be restored on several threads. */
+void mem_page_ref(uint8_t *page, int flags)
+{
+	if (!(flags & PAGE_FILE)) {
+		__atomic_add_fetch((int *)(page - PAGE_HEADER_SIZE), 1, __ATOMIC_RELAXED);
+	}
+}
+
+void mem_page_release(uint8_t *page, int flags)
+{
+	if (!(flags & PAGE_FILE) && __atomic_sub_fetch((int *)(page - PAGE_HEADER_SIZE), 1, __ATOMIC_ACQ_REL) == 0) {
+		free(page - PAGE_HEADER_SIZE);
+	}
+}
+
+static page_table_t* mem_table(sim_context *ctx, uint32_t address)
+{
+	uint32_t dir = address >> (PAGE_SHIFT + PAGE_TABLE_BITS);
+
+	if (ctx->PAGE_DIRECTORY[dir] == NULL) {
+		ctx->PAGE_DIRECTORY[dir] = calloc(1, sizeof(page_table_t));
+		if (ctx->PAGE_DIRECTORY[dir] == NULL) {
+			printf("Error: Can't allocate page table\n");
+			exit(-1);
+		}
+	}
+	return ctx->PAGE_DIRECTORY[dir];
+}
+
+/***************************************************************/
+/* Remember that the page at address differs from the base snapshot. */
+/***************************************************************/
+static void mem_mark_dirty(sim_context *ctx, page_table_t *table, uint32_t page, uint32_t address)
+{
+	if (ctx->BASE_SNAPSHOT == 0 || (table->flags[page] & PAGE_DIRTY)) {
+		return;
+	}
+	if (ctx->NUM_DIRTY_PAGES == ctx->DIRTY_PAGES_CAPACITY) {
+		ctx->DIRTY_PAGES_CAPACITY = ctx->DIRTY_PAGES_CAPACITY ? 2 * ctx->DIRTY_PAGES_CAPACITY : 256;
+		ctx->DIRTY_PAGES = realloc(ctx->DIRTY_PAGES, ctx->DIRTY_PAGES_CAPACITY * sizeof(uint32_t));
+		if (ctx->DIRTY_PAGES == NULL) {
+			printf("Error: Can't allocate dirty page list\n");
+			exit(-1);
+		}
+	}
+	ctx->DIRTY_PAGES[ctx->NUM_DIRTY_PAGES++] = address & ~PAGE_MASK;
+	table->flags[page] |= PAGE_DIRTY;
+}
+
+/***************************************************************/
+/* Return the host page backing address, or NULL if it has never */
+/* been written. With allocate set, the page is made writable: a */
+/* missing page is created zeroed, and a page shared with a */
+/* snapshot is copied first. */
+/***************************************************************/
+uint8_t* mem_page(sim_context *ctx, uint32_t address, int allocate)
+{
+	uint32_t dir = address >> (PAGE_SHIFT + PAGE_TABLE_BITS);
+	uint32_t page = (address >> PAGE_SHIFT) & (PAGE_TABLE_SIZE - 1);
+	page_table_t *table = ctx->PAGE_DIRECTORY[dir];
+	uint8_t *copy;
+
+	if (!allocate) {
+		return table ? table->page[page] : NULL;
+	}
+	table = mem_table(ctx, address);
+	if (table->page[page] == NULL) {
+		table->page[page] = mem_page_alloc();
+		table->flags[page] = 0;
+		ctx->PAGES_ALLOCATED++;
+		mem_mark_dirty(ctx, table, page, address);
+	}
+	else if (table->flags[page] & PAGE_COW) {
+		copy = mem_page_alloc();
+		memcpy(copy, table->page[page], PAGE_SIZE);
+		mem_page_release(table->page[page], table->flags[page]);
+		table->page[page] = copy;
+		table->flags[page] &= PAGE_DIRTY;
+		ctx->PAGES_ALLOCATED++;
+		mem_mark_dirty(ctx, table, page, address);
+	}
+	return table->page[page];
+}
+
+/***************************************************************/
+/* Install a host page (from a mapped program file) as the page */
+/* at address. Returns FALSE if that page already exists. */
+/***************************************************************/
+int mem_map_host_page(sim_context *ctx, uint32_t address, uint8_t *host)
+{
+	uint32_t page = (address >> PAGE_SHIFT) & (PAGE_TABLE_SIZE - 1);
+	page_table_t *table = mem_table(ctx, address);
+
+	if (table->page[page] != NULL) {
+		return FALSE;
+	}
+	table->page[page] = host;
+	table->flags[page] = PAGE_FILE;
+	ctx->PAGES_MAPPED++;
+	mem_mark_dirty(ctx, table, page, address);
+	return TRUE;
+}
+
+/***************************************************************/
+/* Remember a host mapping so free_memory() can unmap it. */
+/***************************************************************/
+void mem_add_mapping(sim_context *ctx, void *base, size_t length)
+{
+	host_mapping_t *mapping = malloc(sizeof(host_mapping_t));
+
+	ctx->HOST_MAPPINGS = realloc(ctx->HOST_MAPPINGS, (ctx->NUM_HOST_MAPPINGS + 1) * sizeof(host_mapping_t *));
+	if (mapping == NULL || ctx->HOST_MAPPINGS == NULL) {
+		printf("Error: Can't allocate mapping list\n");
+		exit(-1);
+	}
+	mapping->base = base;
+	mapping->length = length;
+	mapping->refs = 1;
+	ctx->HOST_MAPPINGS[ctx->NUM_HOST_MAPPINGS++] = mapping;
+}
+
+/* unmap once neither the simulator nor any snapshot uses the mapping */
+void mem_mapping_release(host_mapping_t *mapping)
+{
+	if (__atomic_sub_fetch(&mapping->refs, 1, __ATOMIC_ACQ_REL) == 0) {
+		munmap(mapping->base, mapping->length);
+		free(mapping);
+	}
+}
+
+/***************************************************************/
+/* Check that address falls inside one of the memory regions. */
+/***************************************************************/
+static int mem_mapped(uint32_t address)
+{
+	int i;
+	for (i = 0; i < NUM_MEM_REGION; i++) {
+		if ( (address >= MEM_REGIONS[i].begin) &&  ( address <= MEM_REGIONS[i].end) ) {
+			return TRUE;
+		}
+	}
+	return FALSE;
+}
+
+/***************************************************************/
+/* Guest memory is little-endian. Load/store size bytes at a host */
+/* pointer, using a native access when the host is little-endian too. */
+/***************************************************************/
+static inline uint32_t host_load(const uint8_t *p, int size)
+{
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+	uint32_t v32; uint16_t v16;
+	switch (size) {
+		case 4: memcpy(&v32, p, 4); return v32;
+		case 2: memcpy(&v16, p, 2); return v16;
+		default: return p[0];
+	}
+#else
+	uint32_t value = 0;
+	int i;
+	for (i = size - 1; i >= 0; i--) {
+		value = (value << 8) | p[i];
+	}
+	return value;
+#endif
+}
+
+static inline void host_store(uint8_t *p, uint32_t value, int size)
+{
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+	uint16_t v16 = value;
+	switch (size) {
+		case 4: memcpy(p, &value, 4); break;
+		case 2: memcpy(p, &v16, 2); break;
+		default: p[0] = value; break;
+	}
+#else
+	int i;
+	for (i = 0; i < size; i++) {
+		p[i] = (value >> (8 * i)) & 0xFF;
+	}
+#endif
+}
+
+/***************************************************************/
+/* Flush both TLBs. Needed whenever a page is freed or a page must */
+/* start taking the slow path again. */
+/***************************************************************/
+void tlb_flush(sim_context *ctx)
+{
+	int i;
+	for (i = 0; i < TLB_SIZE; i++) {
+		ctx->TLB_READ[i].tag = TLB_INVALID;
+		ctx->TLB_WRITE[i].tag = TLB_INVALID;
+	}
+}
+
+/***************************************************************/
+/* Slow path: region walk and page table lookup. Aligned accesses */
+/* refill the TLB; misaligned ones are split into bytes. */
+/***************************************************************/
+static uint32_t mem_read_slow(sim_context *ctx, uint32_t address, int size)
+{
+	if (address & (size - 1)) {
+		uint32_t value = 0;
+		int i;
+		for (i = size - 1; i >= 0; i--) {
+			value = (value << 8) | mem_read_slow(ctx, address + i, 1);
+		}
+		return value;
+	}
+	if (!mem_mapped(address)) {
+		return 0;
+	}
+	uint8_t *page = mem_page(ctx, address, FALSE);
+	if (ctx->DEBUG != NULL && (debug_watch_access(ctx, address, size, WATCH_READ) & WATCH_READ)) {
+		/* watched: stays out of the TLB */
+		return page ? host_load(page + (address & PAGE_MASK), size) : 0;
+	}
+	if (page == NULL) {
+		return 0;
+	}
+	tlb_entry_t *e = &ctx->TLB_READ[TLB_INDEX(address)];
+	e->tag = address & ~PAGE_MASK;
+	e->host = page;
+	return host_load(page + (address & PAGE_MASK), size);
+}
+
+static void mem_write_slow(sim_context *ctx, uint32_t address, uint32_t value, int size)
+{
+	if (address & (size - 1)) {
+		int i;
+		for (i = 0; i < size; i++) {
+			mem_write_slow(ctx, address + i, (value >> (8 * i)) & 0xFF, 1);
+		}
+		return;
+	}
+	if (mem_mapped(address)) {
+		uint8_t *page = mem_page(ctx, address, TRUE);
+		uint32_t base = address & ~PAGE_MASK;
+		int watched = ctx->DEBUG != NULL ? debug_watch_access(ctx, address, size, WATCH_WRITE) : 0;
+
+		if (!(watched & WATCH_READ)) {
+			ctx->TLB_READ[TLB_INDEX(address)].tag = base;
+			ctx->TLB_READ[TLB_INDEX(address)].host = page;
+		}
+		/* writes to decoded text must keep coming here to invalidate it */
+		if (!(watched & WATCH_WRITE) && !decode_cache_overlaps(ctx, base, PAGE_SIZE)) {
+			ctx->TLB_WRITE[TLB_INDEX(address)].tag = base;
+			ctx->TLB_WRITE[TLB_INDEX(address)].host = page;
+		}
+		host_store(page + (address & PAGE_MASK), value, size);
+	}
+	invalidate_decode_cache(ctx, address);
+}
+
+/***************************************************************/
+/* Read a 32-bit word from memory. */
+/***************************************************************/
+uint32_t mem_read_32(sim_context *ctx, uint32_t address)
+{
+	tlb_entry_t *e = &ctx->TLB_READ[TLB_INDEX(address)];
+	if ((address & (~PAGE_MASK | 3)) == e->tag) {
+		return host_load(e->host + (address & PAGE_MASK), 4);
+	}
+	return mem_read_slow(ctx, address, 4);
+}
+
+uint32_t mem_read_16(sim_context *ctx, uint32_t address)
+{
+	tlb_entry_t *e = &ctx->TLB_READ[TLB_INDEX(address)];
+	if ((address & (~PAGE_MASK | 1)) == e->tag) {
+		return host_load(e->host + (address & PAGE_MASK), 2);
+	}
+	return mem_read_slow(ctx, address, 2);
+}
+
+uint32_t mem_read_8(sim_context *ctx, uint32_t address)
+{
+	tlb_entry_t *e = &ctx->TLB_READ[TLB_INDEX(address)];
+	if ((address & ~PAGE_MASK) == e->tag) {
+		return e->host[address & PAGE_MASK];
+	}
+	return mem_read_slow(ctx, address, 1);
+}
+
+/***************************************************************/
+/* Write a 32-bit word to memory. */
+/***************************************************************/
+void mem_write_32(sim_context *ctx, uint32_t address, uint32_t value)
+{
+	tlb_entry_t *e = &ctx->TLB_WRITE[TLB_INDEX(address)];
+	if ((address & (~PAGE_MASK | 3)) == e->tag) {
+		host_store(e->host + (address & PAGE_MASK), value, 4);
+		return;
+	}
+	mem_write_slow(ctx, address, value, 4);
+}
+
+void mem_write_16(sim_context *ctx, uint32_t address, uint32_t value)
+{
+	tlb_entry_t *e = &ctx->TLB_WRITE[TLB_INDEX(address)];
+	if ((address & (~PAGE_MASK | 1)) == e->tag) {
+		host_store(e->host + (address & PAGE_MASK), value, 2);
+		return;
+	}
+	mem_write_slow(ctx, address, value, 2);
+}
+
+void mem_write_8(sim_context *ctx, uint32_t address, uint32_t value)
+{
+	tlb_entry_t *e = &ctx->TLB_WRITE[TLB_INDEX(address)];
+	if ((address & ~PAGE_MASK) == e->tag) {
+		e->host[address & PAGE_MASK] = value;
+		return;
+	}
+	mem_write_slow(ctx, address, value, 1);
+}
+
+/***************************************************************/
+/* Send the instruction trace to path ("-" for stdout) through a large */
+/* private buffer, so tracing does not flush on every line. */
+/***************************************************************/
+int set_trace_file(sim_context *ctx, const char *path)
+{
+	FILE *fp;
+
+	if (!strcmp(path, "-")) {
+		fp = fdopen(dup(fileno(stdout)), "w");
+	}
+	else {
+		fp = fopen(path, "w");
+	}
+	if (fp == NULL) {
+		printf("Error: Can't open trace file %s\n", path);
+		return FALSE;
+	}
+	setvbuf(fp, NULL, _IOFBF, TRACE_BUFFER_SIZE);
+
+	if (ctx->TRACE_FILE != NULL) {
+		fclose(ctx->TRACE_FILE);
+	}
+	ctx->TRACE_FILE = fp;
+	return TRUE;
+}
+
+void trace_flush(sim_context *ctx)
+{
+	if (ctx->TRACE_FILE != NULL) {
+		fflush(ctx->TRACE_FILE);
+	}
+}
+
+/***************************************************************/
+/* Execute one cycle. */
+/***************************************************************/
+void cycle(sim_context *ctx) {
+	handle_instruction(ctx);
+	ctx->CURRENT_STATE = ctx->NEXT_STATE;
+	ctx->INSTRUCTION_COUNT++;
+}
+
+/***************************************************************/
+/* Execute up to n instructions on the selected engine. Tracing */
+/* always goes through the reference interpreter. */
+/***************************************************************/
+static uint32_t execute_engine(sim_context *ctx, uint32_t n) {
+	uint32_t i;
+
+	/* tracing, the pipeline and the predictors need every instruction to go through cycle() */
+	if (ctx->ENGINE != ENGINE_INTERP && ctx->VERBOSITY < VERBOSITY_TRACE
+			&& ctx->PIPELINE == NULL && ctx->PREDICTORS == NULL) {
+		return run_blocks(ctx, n);
+	}
+	for (i = 0; i < n && ctx->RUN_FLAG; i++) {
+		if (ctx->DEBUG != NULL && debug_stop_at(ctx, ctx->CURRENT_STATE.PC)) {
+			break;
+		}
+		cycle(ctx);
+	}
+	return i;
+}
+
+/***************************************************************/
+/* Execute up to n instructions, stopping for each replay */
+/* checkpoint on the way. Returns the number executed. */
+/***************************************************************/
+uint32_t execute(sim_context *ctx, uint32_t n) {
+	uint32_t executed = 0, chunk;
+
+	if (ctx->REPLAY == NULL) {
+		return execute_engine(ctx, n);
+	}
+	while (executed < n && ctx->RUN_FLAG && !ctx->DEBUG_STOP) {
+		chunk = replay_checkpoint(ctx);
+		if (chunk > n - executed) {
+			chunk = n - executed;
+		}
+		chunk = execute_engine(ctx, chunk);
+		if (chunk == 0) {
+			break;
+		}
+		executed += chunk;
+	}
+	return executed;
+}
+
+/***************************************************************/
+/* Monotonic wall clock time in seconds. */
+/***************************************************************/
+double now_seconds() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/***************************************************************/
+/* Print instructions/blocks per second for the last run. */
+/***************************************************************/
+static void report_speed(sim_context *ctx, uint64_t executed, double elapsed) {
+	uint64_t blocks = ctx->BLOCKS_EXECUTED - ctx->BLOCKS_REPORTED;
+
+	ctx->BLOCKS_REPORTED = ctx->BLOCKS_EXECUTED;
+	if (ctx->VERBOSITY < VERBOSITY_SUMMARY || executed == 0) {
+		return;
+	}
+	if (elapsed <= 0) {
+		elapsed = 1e-9;
+	}
+	printf("%llu instructions in %.6f s (%.2f M instructions/s", (unsigned long long)executed, elapsed, executed / elapsed / 1e6);
+	if (blocks != 0) {
+		printf(", %llu blocks, %.2f M blocks/s", (unsigned long long)blocks, blocks / elapsed / 1e6);
+	}
+	if (ctx->ENGINE == ENGINE_JIT) {
+		printf(", %u blocks compiled", ctx->BLOCKS_COMPILED);
+	}
+	printf(")\n\n");
+}
+
+/***************************************************************/
+/* Simulate MIPS for n cycles. */
+/***************************************************************/
+void run(sim_context *ctx, int num_cycles) {
+
+	if (ctx->RUN_FLAG == FALSE) {
+		if (ctx->VERBOSITY >= VERBOSITY_SUMMARY) printf("Simulation Stopped\n\n");
+		return;
+	}
+
+	if (ctx->VERBOSITY >= VERBOSITY_SUMMARY) printf("Running simulator for %d cycles...\n\n", num_cycles);
+	fflush(stdout);
+	ctx->DEBUG_STOP = FALSE;
+	double start = now_seconds();
+	uint32_t executed = ctx->SAMPLER != NULL ? sample_run(ctx, num_cycles) : execute(ctx, num_cycles);
+	double elapsed = now_seconds() - start;
+	trace_flush(ctx);
+	if (ctx->DEBUG_STOP) {
+		debug_report(ctx);
+	}
+	else if (executed < (uint32_t)num_cycles && ctx->RUN_FLAG == FALSE) {
+		if (ctx->VERBOSITY >= VERBOSITY_SUMMARY) printf("Simulation Stopped.\n\n");
+	}
+	if (ctx->VERBOSITY >= VERBOSITY_SUMMARY) sample_report(ctx);
+	report_speed(ctx, executed, elapsed);
+}
+
+/***************************************************************/
+/* simulate to completion. */
+/***************************************************************/
+void runAll(sim_context *ctx) {
+	if (ctx->RUN_FLAG == FALSE) {
+		if (ctx->VERBOSITY >= VERBOSITY_SUMMARY) printf("Simulation Stopped.\n\n");
+		return;
+	}
+
+	if (ctx->VERBOSITY >= VERBOSITY_SUMMARY) printf("Simulation Started...\n\n");
+	fflush(stdout);
+	ctx->DEBUG_STOP = FALSE;
+	double start = now_seconds();
+	uint64_t executed = 0;
+	while (ctx->RUN_FLAG && !ctx->DEBUG_STOP){
+		executed += ctx->SAMPLER != NULL ? sample_run(ctx, UINT32_MAX) : execute(ctx, UINT32_MAX);
+	}
+	double elapsed = now_seconds() - start;
+	trace_flush(ctx);
+	if (ctx->DEBUG_STOP) {
+		debug_report(ctx);
+	}
+	else if (ctx->VERBOSITY >= VERBOSITY_SUMMARY) printf("Simulation Finished.\n\n");
+	if (ctx->VERBOSITY >= VERBOSITY_SUMMARY) sample_report(ctx);
+	report_speed(ctx, executed, elapsed);
+}
+
+/***************************************************************/
+/* Dump a word-aligned region of memory to the terminal. */
+/***************************************************************/
+void mdump(sim_context *ctx, uint32_t start, uint32_t stop) {
+	uint32_t address;
+
+	printf("-------------------------------------------------------------\n");
+	printf("Memory content [0x%08x..0x%08x] :\n", start, stop);
+	printf("-------------------------------------------------------------\n");
+	printf("\t[Address in Hex (Dec) ]\t[Value]\n");
+	for (address = start; address <= stop; address += 4){
+		printf("\t0x%08x (%d) :\t0x%08x\n", address, address, mem_read_32(ctx, address));
+	}
+	printf("\n");
+}
+
+/***************************************************************/
+/* Dump current values of registers to the teminal. */
+/***************************************************************/
+void rdump(sim_context *ctx) {
+	int i;
+	printf("-------------------------------------\n");
+	printf("Dumping Register Content\n");
+	printf("-------------------------------------\n");
+	printf("# Instructions Executed\t: %u\n", ctx->INSTRUCTION_COUNT);
+	printf("PC\t: 0x%08x\n", ctx->CURRENT_STATE.PC);
+	printf("-------------------------------------\n");
+	printf("[Register]\t[Value]\n");
+	printf("-------------------------------------\n");
+	for (i = 0; i < MIPS_REGS; i++){
+		printf("[R%d]\t: 0x%08x\n", i, ctx->CURRENT_STATE.REGS[i]);
+	}
+	printf("-------------------------------------\n");
+	printf("[HI]\t: 0x%08x\n", ctx->CURRENT_STATE.HI);
+	printf("[LO]\t: 0x%08x\n", ctx->CURRENT_STATE.LO);
+	printf("-------------------------------------\n");
+}
+
+/***************************************************************/
+/* Zero the execution statistics and size the per-PC counts to the */
+/* decode cache. Only chunks that were counted in are freed, so */
+/* this is cheap even for a large text segment. */
+/***************************************************************/
+void stats_reset(sim_context *ctx) {
+	uint32_t chunks = (ctx->DECODE_CACHE_SIZE + (1u << STATS_CHUNK_BITS) - 1) >> STATS_CHUNK_BITS;
+	uint32_t i;
+
+	memset(ctx->OP_COUNT, 0, sizeof(ctx->OP_COUNT));
+	memset(ctx->OP_REDIRECTS, 0, sizeof(ctx->OP_REDIRECTS));
+	memset(ctx->FUSED_COUNT, 0, sizeof(ctx->FUSED_COUNT));
+	ctx->NATIVE_COUNT = 0;
+	if (ctx->PIPELINE != NULL) {
+		pipeline_reset(ctx->PIPELINE);
+	}
+	if (ctx->CACHES != NULL) {
+		cache_reset(ctx->CACHES);
+	}
+	if (ctx->PREDICTORS != NULL) {
+		predict_reset(ctx->PREDICTORS);
+	}
+	if (ctx->PROFILER != NULL) {
+		profile_reset(ctx->PROFILER);
+	}
+	for (i = 0; i < ctx->PC_COUNT_CHUNKS; i++) {
+		free(ctx->PC_COUNT[i]);
+		ctx->PC_COUNT[i] = NULL;
+	}
+	if (chunks != ctx->PC_COUNT_CHUNKS) {
+		free(ctx->PC_COUNT);
+		ctx->PC_COUNT = calloc(chunks ? chunks : 1, sizeof(uint64_t *));
+		if (ctx->PC_COUNT == NULL) {
+			printf("Error: Can't allocate PC counts\n");
+			exit(-1);
+		}
+		ctx->PC_COUNT_CHUNKS = chunks;
+	}
+}
+
+/***************************************************************/
+/* The count for the word of decoded text at index. */
+/***************************************************************/
+uint64_t* stats_pc_count(sim_context *ctx, uint32_t index) {
+	uint64_t **chunk = &ctx->PC_COUNT[index >> STATS_CHUNK_BITS];
+
+	if (*chunk == NULL) {
+		*chunk = calloc(1u << STATS_CHUNK_BITS, sizeof(uint64_t));
+		if (*chunk == NULL) {
+			printf("Error: Can't allocate PC counts\n");
+			exit(-1);
+		}
+	}
+	return &(*chunk)[index & ((1u << STATS_CHUNK_BITS) - 1)];
+}
+
+/* the count for index, without allocating */
+static uint64_t pc_count(sim_context *ctx, uint32_t index) {
+	uint64_t *chunk = ctx->PC_COUNT[index >> STATS_CHUNK_BITS];
+	return chunk ? chunk[index & ((1u << STATS_CHUNK_BITS) - 1)] : 0;
+}
+
+static double percent(uint64_t part, uint64_t whole) {
+	return whole ? 100.0 * part / whole : 0.0;
+}
+
+/***************************************************************/
+/* Print the instruction mix, branch/memory/syscall counts and the */
+/* hottest PCs since the program was loaded. */
+/***************************************************************/
+void print_stats(sim_context *ctx) {
+	static const uint8_t branches[] = { OP_BEQ, OP_BNE, OP_BLEZ, OP_BLTZ, OP_BGEZ, OP_BGTZ };
+	uint64_t total = 0, taken = 0, branch_total = 0, fused = 0, dispatched;
+	uint8_t order[NUM_OPS];
+	uint32_t top[STATS_TOP_PCS];
+	int num_top = 0;
+	uint32_t i;
+	int op, j;
+
+	pipeline_report(ctx);
+	cache_report(ctx);
+	predict_report(ctx);
+	sample_report(ctx);
+	if (!MU_STATS) {
+		printf("Statistics are not compiled in (MU_STATS=0).\n\n");
+		return;
+	}
+	block_stats_fold(ctx);
+	for (op = 0; op < NUM_OPS; op++) {
+		total += ctx->OP_COUNT[op];
+	}
+	for (j = 0; j < sizeof(branches); j++) {
+		branch_total += ctx->OP_COUNT[branches[j]];
+		taken += ctx->OP_REDIRECTS[branches[j]];
+	}
+
+	printf("-------------------------------------\n");
+	printf("Instruction Mix\n");
+	printf("-------------------------------------\n");
+	printf("# Instructions Counted\t: %llu\n", (unsigned long long)total);
+	printf("-------------------------------------\n");
+	printf("[Op]\t[Count]\t\t[%%]\n");
+	printf("-------------------------------------\n");
+	/* ops in order of decreasing count */
+	for (op = 0; op < NUM_OPS; op++) {
+		for (j = op; j > 0 && ctx->OP_COUNT[order[j - 1]] < ctx->OP_COUNT[op]; j--) {
+			order[j] = order[j - 1];
+		}
+		order[j] = op;
+	}
+	for (j = 0; j < NUM_OPS && ctx->OP_COUNT[order[j]] != 0; j++) {
+		printf("%s\t%-12llu\t%6.2f\n", OP_NAMES[order[j]],
+				(unsigned long long)ctx->OP_COUNT[order[j]], percent(ctx->OP_COUNT[order[j]], total));
+	}
+	printf("-------------------------------------\n");
+	printf("Branches taken\t: %llu of %llu (%.2f%%)\n", (unsigned long long)taken,
+			(unsigned long long)branch_total, percent(taken, branch_total));
+	printf("Loads (b/h/w)\t: %llu / %llu / %llu\n", (unsigned long long)ctx->OP_COUNT[OP_LB],
+			(unsigned long long)ctx->OP_COUNT[OP_LH], (unsigned long long)ctx->OP_COUNT[OP_LW]);
+	printf("Stores (b/h/w)\t: %llu / %llu / %llu\n", (unsigned long long)ctx->OP_COUNT[OP_SB],
+			(unsigned long long)ctx->OP_COUNT[OP_SH], (unsigned long long)ctx->OP_COUNT[OP_SW]);
+	printf("Syscalls\t: %llu\n", (unsigned long long)ctx->OP_COUNT[OP_SYSCALL]);
+	for (j = 0; j < NUM_FUSIONS; j++) {
+		fused += ctx->FUSED_COUNT[j];
+	}
+	/* JIT code runs without handlers: fusion only applies to the rest */
+	dispatched = total - ctx->NATIVE_COUNT;
+	if (ctx->NATIVE_COUNT != 0) {
+		printf("Native (JIT)\t: %llu instructions (%.2f%%)\n", (unsigned long long)ctx->NATIVE_COUNT,
+				percent(ctx->NATIVE_COUNT, total));
+	}
+	if (fused != 0) {
+		printf("-------------------------------------\n");
+		printf("Fused pairs\t: %llu, covering %.2f%% of handler-run instructions\n", (unsigned long long)fused,
+				percent(2 * fused, dispatched));
+		printf("Dispatches\t: %llu for %llu instructions (%.2f%% saved)\n", (unsigned long long)(dispatched - fused),
+				(unsigned long long)dispatched, percent(fused, dispatched));
+		for (j = 0; j < NUM_FUSIONS; j++) {
+			if (ctx->FUSED_COUNT[j] != 0) {
+				printf("%s+%s\t%-12llu\n", OP_NAMES[FUSION_TABLE[j].first], OP_NAMES[FUSION_TABLE[j].second],
+						(unsigned long long)ctx->FUSED_COUNT[j]);
+			}
+		}
+	}
+
+	/* keep the STATS_TOP_PCS largest counts, in order */
+	for (i = 0; i < ctx->DECODE_CACHE_SIZE; i++) {
+		uint64_t count;
+		if (ctx->PC_COUNT[i >> STATS_CHUNK_BITS] == NULL) {
+			i |= (1u << STATS_CHUNK_BITS) - 1;
+			continue;
+		}
+		count = pc_count(ctx, i);
+		if (count == 0 || (num_top == STATS_TOP_PCS && count <= pc_count(ctx, top[num_top - 1]))) {
+			continue;
+		}
+		if (num_top < STATS_TOP_PCS) {
+			num_top++;
+		}
+		for (j = num_top - 1; j > 0 && pc_count(ctx, top[j - 1]) < count; j--) {
+			top[j] = top[j - 1];
+		}
+		top[j] = i;
+	}
+	printf("-------------------------------------\n");
+	printf("[PC]\t\t[Count]\t\t[Instruction]\n");
+	printf("-------------------------------------\n");
+	for (j = 0; j < num_top; j++) {
+		uint32_t pc = MEM_TEXT_BEGIN + 4 * top[j];
+		printf("0x%08x\t%-12llu\t", pc, (unsigned long long)pc_count(ctx, top[j]));
+		fprint_instruction(ctx, stdout, pc);
+	}
+	printf("-------------------------------------\n");
+}
+
+/***************************************************************/
+/* Read and execute one command from in (stdin for the REPL, or a */
+/* command script). Returns COMMAND_QUIT on quit, COMMAND_EOF at */
+/* end of input and COMMAND_OK otherwise. */
+/***************************************************************/
+int handle_command(sim_context *ctx, FILE *in) {
+	char buffer[20];
+	uint32_t start, stop, cycles;
+	uint32_t register_no;
+	int register_value;
+	int hi_reg_value, lo_reg_value;
+	int verbosity, steps;
+	char trace_path[256];
+	char engine[16];
+	char spec[64];
+	char cache[128];
+	char mode[8];
+	int watch_mode, c;
+
+	if (in == stdin) {
+		printf("MU-MIPS SIM:> ");
+	}
+
+	if (fscanf(in, "%19s", buffer) == EOF){
+		return COMMAND_EOF;
+	}
+
+	switch(buffer[0]) {
+		case 'S':
+		case 's':
+			if (buffer[1] == 't' || buffer[1] == 'T'){
+				print_stats(ctx);
+			}else if (!strcasecmp(buffer, "sample")){
+				if (fscanf(in, "%63s", spec) != 1){
+					break;
+				}
+				if (!sample_configure(ctx, spec)){
+					printf("Invalid Command.\n");
+				}
+			}else if (buffer[1] == 'n' || buffer[1] == 'N'){
+				snapshot_free(ctx->USER_SNAPSHOT);
+				ctx->USER_SNAPSHOT = snapshot_take(ctx);
+			}else{
+				runAll(ctx);
+			}
+			break;
+		case 'M':
+		case 'm':
+			if (fscanf(in, "%x %x", &start, &stop) != 2){
+				break;
+			}
+			mdump(ctx, start, stop);
+			break;
+		case 'D':
+		case 'd':
+			if (buffer[1] == 'e' || buffer[1] == 'E'){
+				if (fscanf(in, "%x", &start) != 1){
+					break;
+				}
+				if (!debug_delete(ctx, start)){
+					printf("No breakpoint or watchpoint at 0x%08x.\n", start);
+				}
+			}else if (ctx->USER_SNAPSHOT == NULL) {
+				printf("No snapshot taken.\n");
+			}
+			else {
+				diff_snapshot(ctx, ctx->USER_SNAPSHOT);
+			}
+			break;
+		case 'C':
+		case 'c':
+			if (buffer[1] == 'o' || buffer[1] == 'O'){
+				runAll(ctx);
+				break;
+			}
+			if (fscanf(in, "%127s", cache) != 1){
+				break;
+			}
+			if (!cache_configure(ctx, cache)){
+				printf("Invalid Command.\n");
+			}
+			break;
+		case 'B':
+		case 'b':
+			if (fscanf(in, "%x", &start) != 1){
+				break;
+			}
+			if (!debug_break(ctx, start)){
+				printf("Invalid Command.\n");
+			}
+			break;
+		case 'W':
+		case 'w':
+			/* watch <addr> [r|w|rw]; writes when the mode is left out */
+			if (fscanf(in, "%x", &start) != 1){
+				break;
+			}
+			while ((c = fgetc(in)) == ' ' || c == '\t');
+			ungetc(c, in);
+			watch_mode = WATCH_WRITE;
+			if (c != '\n' && c != EOF && fscanf(in, "%7s", mode) == 1){
+				watch_mode = (strpbrk(mode, "rR") ? WATCH_READ : 0) | (strpbrk(mode, "wW") ? WATCH_WRITE : 0);
+				if (strspn(mode, "rwRW") != strlen(mode)){
+					watch_mode = 0;
+				}
+			}
+			if (!debug_watch(ctx, start, watch_mode)){
+				printf("Invalid Command.\n");
+			}
+			break;
+		case '?':
+			help();
+			break;
+		case 'Q':
+		case 'q':
+			return COMMAND_QUIT;
+		case 'R':
+		case 'r':
+			if (buffer[1] == 'd' || buffer[1] == 'D'){
+				rdump(ctx);
+			}else if (!strcasecmp(buffer, "restore")){
+				if (ctx->USER_SNAPSHOT == NULL) {
+					printf("No snapshot taken.\n");
+				}
+				else {
+					snapshot_restore(ctx, ctx->USER_SNAPSHOT);
+					if (ctx->REPLAY != NULL) {
+						replay_reset(ctx->REPLAY);
+					}
+				}
+			}else if (!strcasecmp(buffer, "replay")){
+				if (fscanf(in, "%63s", spec) != 1){
+					break;
+				}
+				if (!replay_configure(ctx, spec)){
+					printf("Invalid Command.\n");
+				}
+			}else if (!strcasecmp(buffer, "rstep")){
+				if (fscanf(in, "%d", &steps) != 1) {
+					break;
+				}
+				if (steps < 0) {
+					printf("Invalid Command.\n");
+					break;
+				}
+				replay_step_back(ctx, steps);
+			}else if (!strcasecmp(buffer, "rcontinue")){
+				replay_continue_back(ctx);
+			}else if (!strcasecmp(buffer, "record")){
+				if (fscanf(in, "%255s", trace_path) != 1){
+					break;
+				}
+				if (!strcmp(trace_path, "off")){
+					trace_stop(ctx);
+				}else{
+					trace_start(ctx, trace_path);
+				}
+			}else if(buffer[1] == 'e' || buffer[1] == 'E'){
+				reset(ctx);
+			}
+			else {
+				if (fscanf(in, "%d", &cycles) != 1) {
+					break;
+				}
+				run(ctx, cycles);
+			}
+			break;
+		case 'I':
+		case 'i':
+			if (fscanf(in, "%u %i", &register_no, &register_value) != 2 || register_no >= MIPS_REGS){
+				break;
+			}
+			ctx->CURRENT_STATE.REGS[register_no] = register_value;
+			ctx->NEXT_STATE.REGS[register_no] = register_value;
+			replay_state_changed(ctx);
+			break;
+		case 'H':
+		case 'h':
+			if (fscanf(in, "%i", &hi_reg_value) != 1){
+				break;
+			}
+			ctx->CURRENT_STATE.HI = hi_reg_value;
+			ctx->NEXT_STATE.HI = hi_reg_value;
+			replay_state_changed(ctx);
+			break;
+		case 'L':
+		case 'l':
+			if (fscanf(in, "%i", &lo_reg_value) != 1){
+				break;
+			}
+			ctx->CURRENT_STATE.LO = lo_reg_value;
+			ctx->NEXT_STATE.LO = lo_reg_value;
+			replay_state_changed(ctx);
+			break;
+		case 'P':
+		case 'p':
+			if (!strcasecmp(buffer, "predict")){
+				if (fscanf(in, "%63s", spec) != 1){
+					break;
+				}
+				if (!predict_configure(ctx, spec)){
+					printf("Invalid Command.\n");
+				}
+			}else if (!strcasecmp(buffer, "profile")){
+				if (fscanf(in, "%63s", spec) != 1){
+					break;
+				}
+				if (!profile_configure(ctx, spec)){
+					printf("Invalid Command.\n");
+				}
+			}else if (buffer[1] == 'i' || buffer[1] == 'I'){
+				if (fscanf(in, "%63s", spec) != 1){
+					break;
+				}
+				if (!pipeline_configure(ctx, spec)){
+					printf("Invalid Command.\n");
+				}
+			}else{
+				print_program(ctx);
+			}
+			break;
+		case 'V':
+		case 'v':
+			if (fscanf(in, "%d", &verbosity) != 1){
+				break;
+			}
+			ctx->VERBOSITY = verbosity;
+			break;
+		case 'E':
+		case 'e':
+			if (fscanf(in, "%15s", engine) != 1){
+				break;
+			}
+			if (engine[0] == 'i' || engine[0] == 'I'){
+				ctx->ENGINE = ENGINE_INTERP;
+			}else if (engine[0] == 'b' || engine[0] == 'B'){
+				ctx->ENGINE = ENGINE_BLOCK;
+			}else if (MU_JIT && (engine[0] == 'j' || engine[0] == 'J')){
+				ctx->ENGINE = ENGINE_JIT;
+			}else{
+				printf("Invalid Command.\n");
+			}
+			break;
+		case 'T':
+		case 't':
+			if (fscanf(in, "%255s", trace_path) != 1){
+				break;
+			}
+			set_trace_file(ctx, trace_path);
+			break;
+		case '#':
+			/* comment, for command scripts */
+			while ((register_value = fgetc(in)) != EOF && register_value != '\n');
+			break;
+		default:
+			printf("Invalid Command.\n");
+			break;
+	}
+	return COMMAND_OK;
+}
+
+/***************************************************************/
+/* Execute every command in a script file. */
+/***************************************************************/
+int run_script(sim_context *ctx, const char *path) {
+	FILE *fp = fopen(path, "r");
+	int status;
+
+	if (fp == NULL) {
+		printf("Error: Can't open command script %s\n", path);
+		return FALSE;
+	}
+	while ((status = handle_command(ctx, fp)) == COMMAND_OK);
+	fclose(fp);
+	return TRUE;
+}
+
+/***************************************************************/
+/* reset registers/memory and reload program. Returns FALSE (and */
+/* leaves the simulator stopped) if the program can't be loaded. */
+/* The image saved right after loading is restored when there is */
+/* one, which only touches the pages the program has written. */
+/***************************************************************/
+int reset(sim_context *ctx) {
+	int i;
+
+	if (ctx->REPLAY != NULL) {
+		replay_reset(ctx->REPLAY);
+	}
+
+	/* a breakpoint on the entry point stops the next run again */
+	if (ctx->DEBUG != NULL) {
+		ctx->DEBUG->resuming = FALSE;
+	}
+
+	if (ctx->LOAD_SNAPSHOT != NULL) {
+		snapshot_restore(ctx, ctx->LOAD_SNAPSHOT);
+		stats_reset(ctx);
+		return TRUE;
+	}
+	/*reset registers*/
+	for (i = 0; i < MIPS_REGS; i++){
+		ctx->CURRENT_STATE.REGS[i] = 0;
+	}
+	ctx->CURRENT_STATE.HI = 0;
+	ctx->CURRENT_STATE.LO = 0;
+
+	free_memory(ctx);
+
+	/*load program*/
+	ctx->RUN_FLAG = load_program(ctx);
+
+	/*reset PC*/
+	ctx->INSTRUCTION_COUNT = 0;
+	ctx->CURRENT_STATE.PC =  ctx->PROGRAM_ENTRY;
+	ctx->NEXT_STATE = ctx->CURRENT_STATE;
+	return ctx->RUN_FLAG;
+}
+
+/***************************************************************/
+/* Start with empty memory. Pages are allocated lazily by mem_page(). */
+/***************************************************************/
+void init_memory(sim_context *ctx) {
+	free_memory(ctx);
+}
+
+/***************************************************************/
+/* Release every allocated page, leaving all of memory zero. */
+/***************************************************************/
+void free_memory(sim_context *ctx) {
+	uint32_t i, j;
+	for (i = 0; i < PAGE_TABLE_SIZE; i++) {
+		page_table_t *table = ctx->PAGE_DIRECTORY[i];
+		if (table == NULL) {
+			continue;
+		}
+		for (j = 0; j < PAGE_TABLE_SIZE; j++) {
+			if (table->page[j] != NULL) {
+				mem_page_release(table->page[j], table->flags[j]);
+			}
+		}
+		free(table);
+		ctx->PAGE_DIRECTORY[i] = NULL;
+	}
+	for (i = 0; i < ctx->NUM_HOST_MAPPINGS; i++) {
+		mem_mapping_release(ctx->HOST_MAPPINGS[i]);
+	}
+	ctx->NUM_HOST_MAPPINGS = 0;
+	ctx->PAGES_ALLOCATED = 0;
+	ctx->PAGES_MAPPED = 0;
+	ctx->BASE_SNAPSHOT = 0;
+	ctx->NUM_DIRTY_PAGES = 0;
+	tlb_flush(ctx);
+}
+
+/**************************************************************/
+/* load a program in the hex text format (one word per line). */
+/**************************************************************/
+static int load_hex_program(sim_context *ctx) {
+	FILE * fp;
+	int i, word;
+	uint32_t address;
+
+	/* Open program file. */
+	fp = fopen(ctx->prog_file, "r");
+	if (fp == NULL) {
+		printf("Error: Can't open program file %s\n", ctx->prog_file);
+		return FALSE;
+	}
+
+	/* Read in the program. */
+	i = 0;
+	while( fscanf(fp, "%x\n", &word) != EOF ) {
+		address = MEM_TEXT_BEGIN + i;
+		mem_write_32(ctx, address, word);
+		if (ctx->VERBOSITY >= VERBOSITY_TRACE) {
+			fprintf(ctx->TRACE_FILE, "writing 0x%08x into address 0x%08x (%d)\n", word, address, address);
+		}
+		i += 4;
+	}
+	ctx->PROGRAM_SIZE = i/4;
+	ctx->PROGRAM_ENTRY = MEM_TEXT_BEGIN;
+	fclose(fp);
+	return TRUE;
+}
+
+/**************************************************************/
+/* load program into memory. Returns FALSE if it can't be loaded. */
+/**************************************************************/
+int load_program(sim_context *ctx) {
+	int format = ctx->PROG_FORMAT;
+	int loaded;
+
+	if (format == FORMAT_AUTO) {
+		format = detect_program_format(ctx->prog_file);
+	}
+	fflush(stdout);
+
+	switch (format) {
+		case FORMAT_ELF:
+			loaded = load_elf(ctx, ctx->prog_file);
+			break;
+		case FORMAT_BIN_BE:
+		case FORMAT_BIN_LE:
+			loaded = load_binary_image(ctx, ctx->prog_file, format == FORMAT_BIN_LE);
+			break;
+		default:
+			loaded = load_hex_program(ctx);
+			break;
+	}
+	snapshot_free(ctx->LOAD_SNAPSHOT);
+	ctx->LOAD_SNAPSHOT = NULL;
+	if (!loaded) {
+		return FALSE;
+	}
+
+	init_decode_cache(ctx, ctx->PROGRAM_SIZE);
+	trace_flush(ctx);
+
+	/* what reset() goes back to: this memory, cleared registers */
+	ctx->LOAD_SNAPSHOT = snapshot_take(ctx);
+	memset(&ctx->LOAD_SNAPSHOT->state, 0, sizeof(CPU_State));
+	ctx->LOAD_SNAPSHOT->state.PC = ctx->PROGRAM_ENTRY;
+	ctx->LOAD_SNAPSHOT->RUN_FLAG = TRUE;
+	ctx->LOAD_SNAPSHOT->EXIT_CODE = 0;
+	ctx->LOAD_SNAPSHOT->INSTRUCTION_COUNT = 0;
+	if (ctx->VERBOSITY >= VERBOSITY_SUMMARY) {
+		printf("Program loaded into memory.\n%d words written into memory.\n\n", ctx->PROGRAM_SIZE);
+		if (ctx->PAGES_MAPPED != 0) {
+			printf("%u pages mapped from %s, entry point 0x%08x.\n\n", ctx->PAGES_MAPPED, ctx->prog_file, ctx->PROGRAM_ENTRY);
+		}
+	}
+	return TRUE;
+}
+
+/************************************************************/
+/* (Re)allocate an empty decode cache covering num_words of text. */
+/************************************************************/
+void init_decode_cache(sim_context *ctx, uint32_t num_words) {
+	/* drop the blocks (and their counts) translated from the old text */
+	block_cache_flush(ctx);
+	free(ctx->DECODE_CACHE);
+	free(ctx->DECODE_WORDS);
+	ctx->DECODE_CACHE = calloc(num_words ? num_words : 1, sizeof(MIPS));
+	ctx->DECODE_WORDS = malloc((num_words ? num_words : 1) * sizeof(uint32_t));
+	if (ctx->DECODE_CACHE == NULL || ctx->DECODE_WORDS == NULL) {
+		printf("Error: Can't allocate decode cache\n");
+		exit(-1);
+	}
+	ctx->DECODE_CACHE_SIZE = num_words;
+	stats_reset(ctx);
+	/* the write TLB may hold pages that are now decoded text */
+	tlb_flush(ctx);
+	block_cache_invalidate(ctx);
+}
+
+/************************************************************/
+/* Check whether [address, address + length) overlaps decoded text. */
+/************************************************************/
+int decode_cache_overlaps(sim_context *ctx, uint32_t address, uint32_t length) {
+	uint32_t cache_end = MEM_TEXT_BEGIN + (ctx->DECODE_CACHE_SIZE << 2);
+	return ctx->DECODE_CACHE_SIZE != 0 && address < cache_end && address + length > MEM_TEXT_BEGIN;
+}
+
+/************************************************************/
+/* Drop cached decodes overlapping a word written at address. */
+/************************************************************/
+void invalidate_decode_cache(sim_context *ctx, uint32_t address) {
+	uint32_t first = (address - MEM_TEXT_BEGIN) >> 2;
+	uint32_t last = (address + 3 - MEM_TEXT_BEGIN) >> 2;
+
+	if (first < ctx->DECODE_CACHE_SIZE) {
+		ctx->DECODE_CACHE[first].op = OP_UNDECODED;
+		block_cache_invalidate(ctx);
+	}
+	if (last < ctx->DECODE_CACHE_SIZE) {
+		ctx->DECODE_CACHE[last].op = OP_UNDECODED;
+		block_cache_invalidate(ctx);
+	}
+}
+
+/************************************************************/
+/* Decode the instruction word found at pc. */
+/************************************************************/
+void decode_instruction(uint32_t word, uint32_t pc, MIPS* d) {
+	uint32_t opcode = word >> 26;
+
+	d->rs = (word >> 21) & 0x1F;
+	d->rt = (word >> 16) & 0x1F;
+	d->rd = (word >> 11) & 0x1F;
+	d->shamt = (word >> 6) & 0x1F;
+	d->immediate = (uint32_t)(int32_t)(int16_t)(word & 0xFFFF);
+	d->target = pc + 4 + (d->immediate << 2);
+
+	if (opcode == 0x00) {
+		d->op = GetRFunction(word & 0x3F);
+	}
+	else if (opcode == 0x02 || opcode == 0x03) {
+		d->op = GetJFunction(opcode);
+		d->target = ((pc + 4) & 0xF0000000) | ((word & 0x03FFFFFF) << 2);
+	}
+	else {
+		d->op = GetIFunction(opcode, d->rt);
+		if (d->op == OP_ANDI || d->op == OP_ORI || d->op == OP_XORI) {
+			d->immediate = word & 0xFFFF;
+		}
+		else if (d->op == OP_LUI) {
+			d->immediate = word << 16;
+		}
+	}
+}
+
+/************************************************************/
+/* Fetch the decoded instruction at CURRENT_STATE.PC. */
+/************************************************************/
+const MIPS* getSingleInstruct(sim_context *ctx) {
+	return fetch_decoded(ctx, ctx->CURRENT_STATE.PC);
+}
+
+/************************************************************/
+/* Fetch the decoded instruction at pc. Text covered by the decode */
+/* cache is decoded once; anything else every time. */
+/************************************************************/
+const MIPS* fetch_decoded(sim_context *ctx, uint32_t pc) {
+	uint32_t index = (pc - MEM_TEXT_BEGIN) >> 2;
+
+	if (index < ctx->DECODE_CACHE_SIZE && (pc & 3) == 0) {
+		MIPS *d = &ctx->DECODE_CACHE[index];
+		if (d->op == OP_UNDECODED) {
+			ctx->DECODE_WORDS[index] = mem_read_32(ctx, pc);
+			decode_instruction(ctx->DECODE_WORDS[index], pc, d);
+		}
+		return d;
+	}
+	ctx->UNCACHED_WORD = mem_read_32(ctx, pc);
+	decode_instruction(ctx->UNCACHED_WORD, pc, &ctx->UNCACHED);
+	return &ctx->UNCACHED;
+}
+
+/************************************************************/
+/* Instruction handlers. Each executes one decoded instruction */
+/* against state and returns the address of the next instruction. */
+/************************************************************/
+#define NEXT_PC(s) ((s)->PC + 4)
+
+//****************************** ALU INSTRUCTIONS ******************************
+static uint32_t exec_add(sim_context *ctx, CPU_State *s, const MIPS *i) { s->REGS[i->rd] = s->REGS[i->rs] + s->REGS[i->rt]; return NEXT_PC(s); }
+static uint32_t exec_addi(sim_context *ctx, CPU_State *s, const MIPS *i) { s->REGS[i->rt] = s->REGS[i->rs] + i->immediate; return NEXT_PC(s); }
+static uint32_t exec_sub(sim_context *ctx, CPU_State *s, const MIPS *i) { s->REGS[i->rd] = s->REGS[i->rs] - s->REGS[i->rt]; return NEXT_PC(s); }
+static uint32_t exec_and(sim_context *ctx, CPU_State *s, const MIPS *i) { s->REGS[i->rd] = s->REGS[i->rs] & s->REGS[i->rt]; return NEXT_PC(s); }
+static uint32_t exec_andi(sim_context *ctx, CPU_State *s, const MIPS *i) { s->REGS[i->rt] = s->REGS[i->rs] & i->immediate; return NEXT_PC(s); }
+static uint32_t exec_or(sim_context *ctx, CPU_State *s, const MIPS *i) { s->REGS[i->rd] = s->REGS[i->rs] | s->REGS[i->rt]; return NEXT_PC(s); }
+static uint32_t exec_ori(sim_context *ctx, CPU_State *s, const MIPS *i) { s->REGS[i->rt] = s->REGS[i->rs] | i->immediate; return NEXT_PC(s); }
+static uint32_t exec_xor(sim_context *ctx, CPU_State *s, const MIPS *i) { s->REGS[i->rd] = s->REGS[i->rs] ^ s->REGS[i->rt]; return NEXT_PC(s); }
+static uint32_t exec_xori(sim_context *ctx, CPU_State *s, const MIPS *i) { s->REGS[i->rt] = s->REGS[i->rs] ^ i->immediate; return NEXT_PC(s); }
+static uint32_t exec_nor(sim_context *ctx, CPU_State *s, const MIPS *i) { s->REGS[i->rd] = ~(s->REGS[i->rs] | s->REGS[i->rt]); return NEXT_PC(s); }
+static uint32_t exec_slt(sim_context *ctx, CPU_State *s, const MIPS *i) { s->REGS[i->rd] = (int32_t)s->REGS[i->rs] < (int32_t)s->REGS[i->rt]; return NEXT_PC(s); }
+static uint32_t exec_slti(sim_context *ctx, CPU_State *s, const MIPS *i) { s->REGS[i->rt] = (int32_t)s->REGS[i->rs] < (int32_t)i->immediate; return NEXT_PC(s); }
+static uint32_t exec_sll(sim_context *ctx, CPU_State *s, const MIPS *i) { s->REGS[i->rd] = s->REGS[i->rt] << i->shamt; return NEXT_PC(s); }
+static uint32_t exec_srl(sim_context *ctx, CPU_State *s, const MIPS *i) { s->REGS[i->rd] = s->REGS[i->rt] >> i->shamt; return NEXT_PC(s); }
+static uint32_t exec_sra(sim_context *ctx, CPU_State *s, const MIPS *i) { s->REGS[i->rd] = (uint32_t)((int32_t)s->REGS[i->rt] >> i->shamt); return NEXT_PC(s); }
+
+static uint32_t exec_mult(sim_context *ctx, CPU_State *s, const MIPS *i) {
+	int64_t product = (int64_t)(int32_t)s->REGS[i->rs] * (int32_t)s->REGS[i->rt];
+	s->HI = (uint64_t)product >> 32;
+	s->LO = (uint32_t)product;
+	return NEXT_PC(s);
+}
+
+static uint32_t exec_multu(sim_context *ctx, CPU_State *s, const MIPS *i) {
+	uint64_t product = (uint64_t)s->REGS[i->rs] * s->REGS[i->rt];
+	s->HI = product >> 32;
+	s->LO = (uint32_t)product;
+	return NEXT_PC(s);
+}
+
+static uint32_t exec_div(sim_context *ctx, CPU_State *s, const MIPS *i) {
+	int32_t dividend = s->REGS[i->rs], divisor = s->REGS[i->rt];
+	/* result is unpredictable on MIPS; leave HI/LO alone rather than trap the host */
+	if (divisor != 0 && !(dividend == INT32_MIN && divisor == -1)) {
+		s->HI = dividend % divisor;
+		s->LO = dividend / divisor;
+	}
+	return NEXT_PC(s);
+}
+
+static uint32_t exec_divu(sim_context *ctx, CPU_State *s, const MIPS *i) {
+	if (s->REGS[i->rt] != 0) {
+		s->HI = s->REGS[i->rs] % s->REGS[i->rt];
+		s->LO = s->REGS[i->rs] / s->REGS[i->rt];
+	}
+	return NEXT_PC(s);
+}
+
+//****************************** Load/Store INSTRUCTIONS ******************************
+static uint32_t exec_lui(sim_context *ctx, CPU_State *s, const MIPS *i) { s->REGS[i->rt] = i->immediate; return NEXT_PC(s); }
+/* Loads and stores. The cache model sees them here, on every engine; */
+/* all but MRU hits are charged out of line, so the handlers are no */
+/* slower without it. */
+#define DATA_ADDRESS (s->REGS[i->rs] + i->immediate)
+#define MEMORY_HANDLER(name, write, access) \
+	static uint32_t name##_access(sim_context *ctx, CPU_State *s, const MIPS *i) { access; return NEXT_PC(s); } \
+	static __attribute__((noinline)) uint32_t name##_charged(sim_context *ctx, CPU_State *s, const MIPS *i) { \
+		cache_data(ctx->CACHES, s->PC, DATA_ADDRESS, write); \
+		return name##_access(ctx, s, i); \
+	} \
+	static uint32_t exec_##name(sim_context *ctx, CPU_State *s, const MIPS *i) { \
+		if (__builtin_expect(ctx->CACHES != NULL, 0) && !cache_data_hit(ctx->CACHES, DATA_ADDRESS, write)) { \
+			return name##_charged(ctx, s, i); \
+		} \
+		return name##_access(ctx, s, i); \
+	}
+
+MEMORY_HANDLER(lw, FALSE, s->REGS[i->rt] = mem_read_32(ctx, DATA_ADDRESS))
+MEMORY_HANDLER(sw, TRUE, mem_write_32(ctx, DATA_ADDRESS, s->REGS[i->rt]))
+
+MEMORY_HANDLER(lb, FALSE, s->REGS[i->rt] = (uint32_t)(int32_t)(int8_t)mem_read_8(ctx, DATA_ADDRESS))
+MEMORY_HANDLER(lh, FALSE, s->REGS[i->rt] = (uint32_t)(int32_t)(int16_t)mem_read_16(ctx, DATA_ADDRESS))
+MEMORY_HANDLER(sb, TRUE, mem_write_8(ctx, DATA_ADDRESS, s->REGS[i->rt]))
+MEMORY_HANDLER(sh, TRUE, mem_write_16(ctx, DATA_ADDRESS, s->REGS[i->rt]))
+
+static uint32_t exec_mfhi(sim_context *ctx, CPU_State *s, const MIPS *i) { s->REGS[i->rd] = s->HI; return NEXT_PC(s); }
+static uint32_t exec_mflo(sim_context *ctx, CPU_State *s, const MIPS *i) { s->REGS[i->rd] = s->LO; return NEXT_PC(s); }
+static uint32_t exec_mthi(sim_context *ctx, CPU_State *s, const MIPS *i) { s->HI = s->REGS[i->rs]; return NEXT_PC(s); }
+static uint32_t exec_mtlo(sim_context *ctx, CPU_State *s, const MIPS *i) { s->LO = s->REGS[i->rs]; return NEXT_PC(s); }
+
+//******************************* Control Flow INSTRUCTIONS ***************************
+static uint32_t exec_beq(sim_context *ctx, CPU_State *s, const MIPS *i) { return s->REGS[i->rs] == s->REGS[i->rt] ? i->target : NEXT_PC(s); }
+static uint32_t exec_bne(sim_context *ctx, CPU_State *s, const MIPS *i) { return s->REGS[i->rs] != s->REGS[i->rt] ? i->target : NEXT_PC(s); }
+static uint32_t exec_blez(sim_context *ctx, CPU_State *s, const MIPS *i) { return (int32_t)s->REGS[i->rs] <= 0 ? i->target : NEXT_PC(s); }
+static uint32_t exec_bltz(sim_context *ctx, CPU_State *s, const MIPS *i) { return (int32_t)s->REGS[i->rs] < 0 ? i->target : NEXT_PC(s); }
+static uint32_t exec_bgez(sim_context *ctx, CPU_State *s, const MIPS *i) { return (int32_t)s->REGS[i->rs] >= 0 ? i->target : NEXT_PC(s); }
+static uint32_t exec_bgtz(sim_context *ctx, CPU_State *s, const MIPS *i) { return (int32_t)s->REGS[i->rs] > 0 ? i->target : NEXT_PC(s); }
+static uint32_t exec_j(sim_context *ctx, CPU_State *s, const MIPS *i) { return i->target; }
+static uint32_t exec_jr(sim_context *ctx, CPU_State *s, const MIPS *i) { return s->REGS[i->rs]; }
+static uint32_t exec_jal(sim_context *ctx, CPU_State *s, const MIPS *i) { s->REGS[31] = NEXT_PC(s); return i->target; }
+
+static uint32_t exec_jalr(sim_context *ctx, CPU_State *s, const MIPS *i) {
+	uint32_t target = s->REGS[i->rs];
+	s->REGS[i->rd] = NEXT_PC(s);
+	return target;
+}
+
+//******************************* Sys Call INSTRUCTIONS ***************************
+static uint32_t exec_syscall(sim_context *ctx, CPU_State *s, const MIPS *i) {
+	if (s->REGS[2] == 0xA) {
+		ctx->EXIT_CODE = 0;
+		ctx->RUN_FLAG = FALSE;
+	}
+	else if (s->REGS[2] == 0x11) {
+		/* exit2: exit code in $a0 */
+		ctx->EXIT_CODE = s->REGS[4];
+		ctx->RUN_FLAG = FALSE;
+	}
+	return NEXT_PC(s);
+}
+
+static uint32_t exec_invalid(sim_context *ctx, CPU_State *s, const MIPS *i) { return NEXT_PC(s); }
+
+/* one handler per operation id */
+const mips_handler_t EXEC_TABLE[NUM_OPS] = {
+	[OP_UNDECODED] = exec_invalid,
+	[OP_ADD] = exec_add, [OP_ADDU] = exec_add, [OP_ADDI] = exec_addi, [OP_ADDIU] = exec_addi,
+	[OP_SUB] = exec_sub, [OP_SUBU] = exec_sub, [OP_MULT] = exec_mult, [OP_MULTU] = exec_multu,
+	[OP_DIV] = exec_div, [OP_DIVU] = exec_divu, [OP_AND] = exec_and, [OP_ANDI] = exec_andi,
+	[OP_OR] = exec_or, [OP_ORI] = exec_ori, [OP_XOR] = exec_xor, [OP_XORI] = exec_xori,
+	[OP_NOR] = exec_nor, [OP_SLT] = exec_slt, [OP_SLTI] = exec_slti, [OP_SLL] = exec_sll,
+	[OP_SRL] = exec_srl, [OP_SRA] = exec_sra, [OP_LUI] = exec_lui, [OP_LW] = exec_lw,
+	[OP_LB] = exec_lb, [OP_LH] = exec_lh, [OP_SW] = exec_sw, [OP_SB] = exec_sb, [OP_SH] = exec_sh,
+	[OP_MFHI] = exec_mfhi, [OP_MFLO] = exec_mflo, [OP_MTHI] = exec_mthi, [OP_MTLO] = exec_mtlo,
+	[OP_BEQ] = exec_beq, [OP_BNE] = exec_bne, [OP_BLEZ] = exec_blez, [OP_BLTZ] = exec_bltz,
+	[OP_BGEZ] = exec_bgez, [OP_BGTZ] = exec_bgtz, [OP_J] = exec_j, [OP_JR] = exec_jr,
+	[OP_JAL] = exec_jal, [OP_JALR] = exec_jalr, [OP_SYSCALL] = exec_syscall,
+	[OP_INVALID] = exec_invalid
+};
+
+/************************************************************/
+/* Superinstructions. A fused handler runs both handlers of */
+/* the pair back to back, with the PC and $zero updated in */
+/* between exactly as two dispatches would, so the guest sees */
+/* no difference; the block engine saves the second dispatch. */
+/* The first instruction of a pair never writes memory or */
+/* leaves the block. */
+/************************************************************/
+#define FUSED_HANDLER(a, b) \
+	static uint32_t exec_##a##_##b(sim_context *ctx, CPU_State *s, const MIPS *i) { \
+		s->PC = exec_##a(ctx, s, &i[0]); \
+		s->REGS[0] = 0; \
+		return exec_##b(ctx, s, &i[1]); \
+	}
+
+FUSED_HANDLER(lui, ori)
+FUSED_HANDLER(lui, addi)
+FUSED_HANDLER(addi, lw)
+FUSED_HANDLER(addi, sw)
+FUSED_HANDLER(addi, addi)
+FUSED_HANDLER(addi, bne)
+FUSED_HANDLER(addi, bgtz)
+FUSED_HANDLER(slt, bne)
+FUSED_HANDLER(slt, beq)
+FUSED_HANDLER(slti, bne)
+FUSED_HANDLER(slti, beq)
+FUSED_HANDLER(mult, mflo)
+FUSED_HANDLER(multu, mflo)
+
+const mips_fusion_t FUSION_TABLE[NUM_FUSIONS] = {
+	{ OP_LUI, OP_ORI, exec_lui_ori },		/* 32-bit constant */
+	{ OP_LUI, OP_ADDIU, exec_lui_addi },
+	{ OP_ADDIU, OP_LW, exec_addi_lw },		/* pointer bump and access */
+	{ OP_ADDIU, OP_SW, exec_addi_sw },
+	{ OP_ADDIU, OP_ADDIU, exec_addi_addi },
+	{ OP_ADDIU, OP_BNE, exec_addi_bne },		/* loop counter and back edge */
+	{ OP_ADDIU, OP_BGTZ, exec_addi_bgtz },
+	{ OP_SLT, OP_BNE, exec_slt_bne },		/* compare and branch */
+	{ OP_SLT, OP_BEQ, exec_slt_beq },
+	{ OP_SLTI, OP_BNE, exec_slti_bne },
+	{ OP_SLTI, OP_BEQ, exec_slti_beq },
+	{ OP_MULT, OP_MFLO, exec_mult_mflo },		/* 32-bit product */
+	{ OP_MULTU, OP_MFLO, exec_multu_mflo }
+};
+
+/* FUSION_TABLE index of the pair, or -1 */
+int find_fusion(uint8_t first, uint8_t second)
+{
+	int f;
+
+	for (f = 0; f < NUM_FUSIONS; f++) {
+		if (FUSION_TABLE[f].first == first && FUSION_TABLE[f].second == second) {
+			return f;
+		}
+	}
+	return -1;
+}
+
+/************************************************************/
+/* decode and execute instruction. */
+/************************************************************/
+void handle_instruction(sim_context *ctx)
+{
+	ctx->CURRENT_STATE = ctx->NEXT_STATE;
+	/* execute one instruction at a time. Use/update CURRENT_STATE and and NEXT_STATE, as necessary.*/
+	/* a copy, as the blocks keep: a store to its own word drops the cached decode while it runs */
+	const MIPS instruct = *getSingleInstruct(ctx);
+
+	uint32_t pc = ctx->CURRENT_STATE.PC;
+	uint32_t memory_stall = 0;
+	uint64_t stalls = 0;
+	trace_record_t *record = NULL;
+
+	if (ctx->VERBOSITY >= VERBOSITY_TRACE) {
+		fprint_instruction(ctx, ctx->TRACE_FILE, pc);
+	}
+	if (ctx->RECORDER != NULL) {
+		record = trace_begin(ctx, &instruct, pc);
+	}
+	if (ctx->CACHES != NULL) {
+		/* the fetch; a load or store is charged by its handler */
+		stalls = ctx->CACHES->stall_cycles;
+		ctx->CACHES->fetch_pc = pc;
+		cache_fetch(ctx->CACHES, pc + 4);
+	}
+
+	uint32_t next_pc = EXEC_TABLE[instruct.op](ctx, &ctx->CURRENT_STATE, &instruct);
+	ctx->CURRENT_STATE.REGS[0] = 0;
+
+	if (ctx->CACHES != NULL) {
+		memory_stall = ctx->CACHES->stall_cycles - stalls;
+	}
+
+	if (record != NULL) {
+		trace_end(ctx, &instruct, record);
+	}
+	if (ctx->PIPELINE != NULL) {
+		pipeline_step(ctx->PIPELINE, &instruct, pc, next_pc != pc + 4);
+		if (memory_stall != 0) {
+			pipeline_memory_stall(ctx->PIPELINE, memory_stall);
+		}
+	}
+	if (ctx->PREDICTORS != NULL) {
+		predict_branch(ctx->PREDICTORS, &instruct, pc, next_pc);
+	}
+	if (ctx->PROFILER != NULL) {
+		profile_block(ctx, pc, 1, &instruct, next_pc);
+	}
+
+#if MU_STATS
+	ctx->OP_COUNT[instruct.op]++;
+	ctx->OP_REDIRECTS[instruct.op] += next_pc != pc + 4;
+	if ((pc - MEM_TEXT_BEGIN) >> 2 < ctx->DECODE_CACHE_SIZE) {
+		(*stats_pc_count(ctx, (pc - MEM_TEXT_BEGIN) >> 2))++;
+	}
+#endif
+
+	ctx->NEXT_STATE = ctx->CURRENT_STATE;
+	ctx->NEXT_STATE.PC = next_pc;
+}
+
+/************************************************************/
+/* Initialize Memory. */
+/************************************************************/
+void initialize(sim_context *ctx) {
+	if (ctx->TRACE_FILE == NULL) {
+		set_trace_file(ctx, "-");
+	}
+	init_memory(ctx);
+	ctx->CURRENT_STATE.PC = MEM_TEXT_BEGIN;
+	ctx->NEXT_STATE = ctx->CURRENT_STATE;
+	ctx->RUN_FLAG = TRUE;
+}
+
+/************************************************************/
+/* Print the program loaded into memory (in MIPS assembly format). */
+/************************************************************/
+void print_program(sim_context *ctx){
+	disasm_range(ctx, stdout, MEM_TEXT_BEGIN, ctx->PROGRAM_SIZE);
+}
+
+/************************************************************/
+/* Operation lookup tables, indexed by the raw funct/opcode/rt bits. */
+/************************************************************/
+static const uint8_t R_FUNCTIONS[64] = {
+	[0 ... 63] = OP_INVALID,
+	[0x20] = OP_ADD, [0x21] = OP_ADDU, [0x22] = OP_SUB, [0x23] = OP_SUBU,
+	[0x18] = OP_MULT, [0x19] = OP_MULTU, [0x1A] = OP_DIV, [0x1B] = OP_DIVU,
+	[0x24] = OP_AND, [0x25] = OP_OR, [0x26] = OP_XOR, [0x27] = OP_NOR,
+	[0x2A] = OP_SLT, [0x00] = OP_SLL, [0x02] = OP_SRL, [0x03] = OP_SRA,
+	[0x10] = OP_MFHI, [0x12] = OP_MFLO, [0x11] = OP_MTHI, [0x13] = OP_MTLO,
+	[0x08] = OP_JR, [0x09] = OP_JALR, [0x0C] = OP_SYSCALL
+};
+
+static const uint8_t I_FUNCTIONS[64] = {
+	[0 ... 63] = OP_INVALID,
+	[0x08] = OP_ADDI, [0x09] = OP_ADDIU, [0x0C] = OP_ANDI, [0x0D] = OP_ORI,
+	[0x0E] = OP_XORI, [0x0A] = OP_SLTI, [0x23] = OP_LW, [0x20] = OP_LB,
+	[0x21] = OP_LH, [0x0F] = OP_LUI, [0x2B] = OP_SW, [0x28] = OP_SB,
+	[0x29] = OP_SH, [0x04] = OP_BEQ, [0x05] = OP_BNE, [0x06] = OP_BLEZ,
+	[0x07] = OP_BGTZ
+};
+
+/* opcode 0x01 (REGIMM) selects the operation with the rt field */
+static const uint8_t REGIMM_FUNCTIONS[32] = {
+	[0 ... 31] = OP_INVALID,
+	[0x00] = OP_BLTZ, [0x01] = OP_BGEZ
+};
+
+static const uint8_t J_FUNCTIONS[64] = {
+	[0 ... 63] = OP_INVALID,
+	[0x02] = OP_J, [0x03] = OP_JAL
+};
+
+const char* const OP_NAMES[NUM_OPS] = {
+	[OP_UNDECODED] = "???",
+	[OP_ADD] = "ADD", [OP_ADDU] = "ADDU", [OP_ADDI] = "ADDI", [OP_ADDIU] = "ADDIU",
+	[OP_SUB] = "SUB", [OP_SUBU] = "SUBU", [OP_MULT] = "MULT", [OP_MULTU] = "MULTU",
+	[OP_DIV] = "DIV", [OP_DIVU] = "DIVU", [OP_AND] = "AND", [OP_ANDI] = "ANDI",
+	[OP_OR] = "OR", [OP_ORI] = "ORI", [OP_XOR] = "XOR", [OP_XORI] = "XORI",
+	[OP_NOR] = "NOR", [OP_SLT] = "SLT", [OP_SLTI] = "SLTI", [OP_SLL] = "SLL",
+	[OP_SRL] = "SRL", [OP_SRA] = "SRA", [OP_LUI] = "LUI", [OP_LW] = "LW",
+	[OP_LB] = "LB", [OP_LH] = "LH", [OP_SW] = "SW", [OP_SB] = "SB", [OP_SH] = "SH",
+	[OP_MFHI] = "MFHI", [OP_MFLO] = "MFLO", [OP_MTHI] = "MTHI", [OP_MTLO] = "MTLO",
+	[OP_BEQ] = "BEQ", [OP_BNE] = "BNE", [OP_BLEZ] = "BLEZ", [OP_BLTZ] = "BLTZ",
+	[OP_BGEZ] = "BGEZ", [OP_BGTZ] = "BGTZ", [OP_J] = "J", [OP_JR] = "JR",
+	[OP_JAL] = "JAL", [OP_JALR] = "JALR", [OP_SYSCALL] = "SYSCALL",
+	[OP_INVALID] = "Instruction not found"
+};
+
+mips_op_t GetRFunction(uint32_t funct)
+{
+	return R_FUNCTIONS[funct & 0x3F];
+}
+
+mips_op_t GetIFunction(uint32_t opcode, uint32_t rt)
+{
+	if(opcode == 0x01)
+	{
+		return REGIMM_FUNCTIONS[rt & 0x1F];
+	}
+	return I_FUNCTIONS[opcode & 0x3F];
+}
+
+mips_op_t GetJFunction(uint32_t opcode)
+{
+	return J_FUNCTIONS[opcode & 0x3F];
+}
+
+/************************************************************/
+/* Print the instruction at given memory address (in MIPS assembly format). */
+/************************************************************/
+void print_instruction(sim_context *ctx, uint32_t addr){
+	fprint_instruction(ctx, stdout, addr);
+}
+
+void fprint_instruction(sim_context *ctx, FILE* out, uint32_t addr){
+	char line[DISASM_MAX];
+
+	disasm_format(line, sizeof(line), mem_read_32(ctx, addr), addr);
+	fputs(line, out);
+	fputc('\n', out);
+}
+
+/***************************************************************/
+/* Batch mode: actions given on the command line, run in order. */
+/***************************************************************/
+typedef struct {
+	int action;
+	char *arg;
+} batch_action_t;
+
+/* ENGINE_* for an engine name, or -1 */
+static int parse_engine(const char *name) {
+	if (!strcmp(name, "interp")) {
+		return ENGINE_INTERP;
+	}
+	if (!strcmp(name, "block")) {
+		return ENGINE_BLOCK;
+	}
+	if (MU_JIT && !strcmp(name, "jit")) {
+		return ENGINE_JIT;
+	}
+	return -1;
+}
+
+static void usage(const char *name) {
+	printf("Usage: %s [options] <input program>\n", name);
+	printf("  -f, --format <fmt>\tprogram format: auto, hex, bin, binle, elf\n");
+	printf("  -e, --engine <name>\texecution engine: interp, block%s\n", MU_JIT ? ", jit" : "");
+	printf("  -v, --verbose <n>\t0 quiet, 1 summary, 2 trace\n");
+	printf("  -q, --quiet\t\tsame as -v 0\n");
+	printf("  -P, --pipeline <cfg>\tmodel a 5-stage pipeline: fwd|nofwd,id|ex (branch stage), or on\n");
+	printf("  -B, --predict <spec>\tadd a branch predictor, repeatable: nottaken, bimodal, gshare,\n");
+	printf("\t\t\ttournament[:<bits>[:<history>]]; btb:<n>, ras:<n>, penalty:<cycles>\n");
+	printf("  -C, --cache <spec>\tmodel caches, repeatable: on, mem:<cycles>, or\n");
+	printf("\t\t\tl1i|l1d|l2:<size>:<ways>:<line>[:lru|plru|random][:wb|wt][:<cycles>]\n");
+	printf("  -T, --sample <spec>\tsample the timing models, repeatable: on, period:<n>, warm:<n>,\n");
+	printf("\t\t\tdetail:<n>, simpoint:<phases>, per:<intervals per phase>\n");
+	printf("  -t, --record <file>\trecord every instruction to a binary trace file (see mu-trace-dump)\n");
+	printf("  -F, --profile <spec>\tprofile guest calls into folded stacks, repeatable: on,\n");
+	printf("\t\t\tevery:<instructions>, out:<file>, syms:<symbol map>\n");
+	printf("  -X, --replay <spec>\tcheckpoint for reverse stepping, repeatable: on, every:<instructions>,\n");
+	printf("\t\t\tbudget:<MB> (default every %u, %u MB)\n", REPLAY_DEFAULT_INTERVAL, REPLAY_DEFAULT_BUDGET >> 20);
+	printf("Batch actions, run in order; the simulator exits afterwards:\n");
+	printf("  -s, --sim\t\tsimulate program to completion\n");
+	printf("  -r, --run <n>\t\tsimulate program for <n> instructions\n");
+	printf("  -d, --rdump\t\tdump register values\n");
+	printf("  -S, --stats\t\tprint the instruction mix and the hottest PCs\n");
+	printf("  -m, --mdump <a:b>\tdump memory from <a> to <b> (hex)\n");
+	printf("  -x, --script <file>\texecute the commands in <file>\n");
+	printf("  -D, --diff <engine>\tsimulate to completion here and on <engine>, list where the results differ\n");
+	printf("  -E, --exit-reg <n>\texit status is the low byte of GPR <n>\n");
+	printf("Without -E the exit status is the guest exit code (syscall 17 $a0, 0 for syscall 10),\n");
+	printf("or 1 if --diff found a difference.\n");
+	printf("Regression mode, instead of an input program:\n");
+	printf("  -R, --regress <path>\tcheck every *.in in a directory, or the programs in a manifest\n");
+	printf("  -j, --jobs <n>\t\tworker threads (default: one per core)\n");
+	printf("  -l, --limit <n>\tinstructions before a program counts as hung (default %u)\n", REGRESS_DEFAULT_LIMIT);
+	printf("The exit status is 0 when every program passes.\n");
+	printf("Benchmark mode, with one or more input programs:\n");
+	printf("  -b, --bench <runs>\trun each program to completion <runs> times and print CSV timings\n\n");
+}
+
+static void run_batch_action(sim_context *ctx, batch_action_t *a) {
+	uint32_t start, stop;
+
+	switch (a->action) {
+		case 's':
+			runAll(ctx);
+			break;
+		case 'r':
+			run(ctx, atoi(a->arg));
+			break;
+		case 'd':
+			rdump(ctx);
+			break;
+		case 'S':
+			print_stats(ctx);
+			break;
+		case 'm':
+			if (sscanf(a->arg, "%x:%x", &start, &stop) == 2) {
+				mdump(ctx, start, stop);
+			}
+			else {
+				printf("Error: Bad memory range %s\n", a->arg);
+			}
+			break;
+		case 'x':
+			if (!run_script(ctx, a->arg)) {
+				exit(1);
+			}
+			break;
+		case 'D':
+			if (diff_engines(ctx, parse_engine(a->arg)) != 0) {
+				fflush(stdout);
+				exit(1);
+			}
+			break;
+	}
+}
+
+/***************************************************************/
+/* Main function. */
+/***************************************************************/
+int main(int argc, char *argv[]) {
+	static const struct option long_options[] = {
+		{ "format", required_argument, NULL, 'f' },
+		{ "engine", required_argument, NULL, 'e' },
+		{ "verbose", required_argument, NULL, 'v' },
+		{ "quiet", no_argument, NULL, 'q' },
+		{ "pipeline", required_argument, NULL, 'P' },
+		{ "cache", required_argument, NULL, 'C' },
+		{ "predict", required_argument, NULL, 'B' },
+		{ "profile", required_argument, NULL, 'F' },
+		{ "replay", required_argument, NULL, 'X' },
+		{ "sample", required_argument, NULL, 'T' },
+		{ "record", required_argument, NULL, 't' },
+		{ "sim", no_argument, NULL, 's' },
+		{ "run", required_argument, NULL, 'r' },
+		{ "rdump", no_argument, NULL, 'd' },
+		{ "stats", no_argument, NULL, 'S' },
+		{ "mdump", required_argument, NULL, 'm' },
+		{ "script", required_argument, NULL, 'x' },
+		{ "diff", required_argument, NULL, 'D' },
+		{ "exit-reg", required_argument, NULL, 'E' },
+		{ "regress", required_argument, NULL, 'R' },
+		{ "jobs", required_argument, NULL, 'j' },
+		{ "limit", required_argument, NULL, 'l' },
+		{ "bench", required_argument, NULL, 'b' },
+		{ "help", no_argument, NULL, 'h' },
+		{ NULL, 0, NULL, 0 }
+	};
+	sim_context *ctx = sim_create();
+	batch_action_t *actions = calloc(argc, sizeof(batch_action_t));
+	int num_actions = 0;
+	int exit_reg = -1;
+	char *regress_path = NULL;
+	int regress_jobs = 0;
+	uint32_t regress_limit = REGRESS_DEFAULT_LIMIT;
+	int bench_runs = 0;
+	char *record_path = NULL;
+	int opt, i;
+
+	while ((opt = getopt_long(argc, argv, "f:e:v:qP:C:B:F:X:T:t:sr:dSm:x:D:E:R:j:l:b:h", long_options, NULL)) != -1) {
+		switch (opt) {
+			case 'f':
+				ctx->PROG_FORMAT = parse_program_format(optarg);
+				if (ctx->PROG_FORMAT < 0) {
+					printf("Error: Unknown program format %s (auto, hex, bin, binle, elf)\n\n", optarg);
+					exit(1);
+				}
+				break;
+			case 'e':
+				ctx->ENGINE = parse_engine(optarg);
+				if (ctx->ENGINE < 0) {
+					printf("Error: Unknown engine %s (interp, block%s)\n\n", optarg, MU_JIT ? ", jit" : "");
+					exit(1);
+				}
+				break;
+			case 'v':
+				ctx->VERBOSITY = atoi(optarg);
+				break;
+			case 'q':
+				ctx->VERBOSITY = VERBOSITY_QUIET;
+				break;
+			case 'P':
+				if (!pipeline_configure(ctx, optarg)) {
+					printf("Error: Bad pipeline config %s (off, on, fwd, nofwd, id, ex)\n\n", optarg);
+					exit(1);
+				}
+				break;
+			case 'C':
+				if (!cache_configure(ctx, optarg)) {
+					printf("Error: Bad cache spec %s\n\n", optarg);
+					exit(1);
+				}
+				break;
+			case 'B':
+				if (!predict_configure(ctx, optarg)) {
+					printf("Error: Bad predictor spec %s\n\n", optarg);
+					exit(1);
+				}
+				break;
+			case 'F':
+				if (!profile_configure(ctx, optarg)) {
+					printf("Error: Bad profile spec %s\n\n", optarg);
+					exit(1);
+				}
+				break;
+			case 'X':
+				if (!replay_configure(ctx, optarg)) {
+					printf("Error: Bad replay spec %s\n\n", optarg);
+					exit(1);
+				}
+				break;
+			case 'T':
+				if (!sample_configure(ctx, optarg)) {
+					printf("Error: Bad sample spec %s\n\n", optarg);
+					exit(1);
+				}
+				break;
+			case 't':
+				record_path = optarg;
+				break;
+			case 'E':
+				exit_reg = atoi(optarg);
+				if (exit_reg < 0 || exit_reg >= MIPS_REGS) {
+					printf("Error: Bad register %s\n\n", optarg);
+					exit(1);
+				}
+				break;
+			case 'R':
+				regress_path = optarg;
+				break;
+			case 'j':
+				regress_jobs = atoi(optarg);
+				break;
+			case 'l':
+				regress_limit = strtoul(optarg, NULL, 0);
+				if (regress_limit == 0 || regress_limit > INT32_MAX) {
+					printf("Error: Bad instruction limit %s\n\n", optarg);
+					exit(1);
+				}
+				break;
+			case 'b':
+				bench_runs = atoi(optarg);
+				if (bench_runs <= 0) {
+					printf("Error: Bad run count %s\n\n", optarg);
+					exit(1);
+				}
+				break;
+			case 'D':
+				if (parse_engine(optarg) < 0) {
+					printf("Error: Unknown engine %s (interp, block%s)\n\n", optarg, MU_JIT ? ", jit" : "");
+					exit(1);
+				}
+				/* fall through */
+			case 's':
+			case 'r':
+			case 'd':
+			case 'S':
+			case 'm':
+			case 'x':
+				actions[num_actions].action = opt;
+				actions[num_actions].arg = optarg;
+				num_actions++;
+				break;
+			case 'h':
+				usage(argv[0]);
+				exit(0);
+			default:
+				usage(argv[0]);
+				exit(1);
+		}
+	}
+
+	if (regress_path != NULL) {
+		i = run_regression(ctx, regress_path, regress_jobs, regress_limit);
+		sim_destroy(ctx);
+		free(actions);
+		return i == 0 ? 0 : 1;
+	}
+
+	if (bench_runs > 0) {
+		if (optind >= argc) {
+			printf("Error: You should provide input files to benchmark.\n");
+			exit(1);
+		}
+		i = run_benchmarks(ctx, argv + optind, argc - optind, bench_runs);
+		sim_destroy(ctx);
+		free(actions);
+		return i == 0 ? 0 : 1;
+	}
+
+	if (num_actions == 0) {
+		printf("\n**************************\n");
+		printf("Welcome to MU-MIPS SIM...\n");
+		printf("**************************\n\n");
+	}
+
+	if (optind >= argc) {
+		printf("Error: You should provide input file.\n");
+		usage(argv[0]);
+		exit(1);
+	}
+
+	ctx->prog_file = argv[optind];
+	initialize(ctx);
+	if (!load_program(ctx)) {
+		exit(-1);
+	}
+	ctx->CURRENT_STATE.PC = ctx->PROGRAM_ENTRY;
+	ctx->NEXT_STATE = ctx->CURRENT_STATE;
+	if (record_path != NULL && !trace_start(ctx, record_path)) {
+		exit(1);
+	}
+
+	if (num_actions != 0) {
+		for (i = 0; i < num_actions; i++) {
+			run_batch_action(ctx, &actions[i]);
+		}
+		profile_write(ctx);
+		fflush(stdout);
+		i = (exit_reg >= 0 ? ctx->CURRENT_STATE.REGS[exit_reg] : ctx->EXIT_CODE) & 0xFF;
+		sim_destroy(ctx);
+		free(actions);
+		return i;
+	}
+
+	help();
+	while ((i = handle_command(ctx, stdin)) == COMMAND_OK);
+	if (i == COMMAND_QUIT) {
+		printf("**************************\n");
+		printf("Exiting MU-MIPS! Good Bye...\n");
+		printf("**************************\n");
+	}
+	profile_write(ctx);
+	sim_destroy(ctx);
+	free(actions);
+	return 0;
+}
@@ -1,108 +1,303 @@
-#include <stdint.h>
-#include <math.h>
-
-#define FALSE 0
-#define TRUE  1
-
-/******************************************************************************/
-/* MIPS memory layout                                                                                                                                      */
-/******************************************************************************/
-#define MEM_TEXT_BEGIN  0x00400000
-#define MEM_TEXT_END      0x0FFFFFFF
-/*Memory address 0x10000000 to 0x1000FFFF access by $gp*/
-#define MEM_DATA_BEGIN  0x10010000
-#define MEM_DATA_END   0x7FFFFFFF
-
-#define MEM_KTEXT_BEGIN 0x80000000
-#define MEM_KTEXT_END  0x8FFFFFFF
-
-#define MEM_KDATA_BEGIN 0x90000000
-#define MEM_KDATA_END  0xFFFEFFFF
-
-/*stack and data segments occupy the same memory space. Stack grows backward (from higher address to lower address) */
-#define MEM_STACK_BEGIN 0x7FFFFFFF
-#define MEM_STACK_END  0x10010000
-
-typedef struct {
-	uint32_t begin, end;
-	uint8_t *mem;
-} mem_region_t;
-
-/* memory will be dynamically allocated at initialization */
-mem_region_t MEM_REGIONS[] = {
-	{ MEM_TEXT_BEGIN, MEM_TEXT_END, NULL },
-	{ MEM_DATA_BEGIN, MEM_DATA_END, NULL },
-	{ MEM_KDATA_BEGIN, MEM_KDATA_END, NULL },
-	{ MEM_KTEXT_BEGIN, MEM_KTEXT_END, NULL }
-};
-
-#define NUM_MEM_REGION 4
-#define MIPS_REGS 32
-
-typedef struct CPU_State_Struct {
-
-  uint32_t PC;		                   /* program counter */
-  uint32_t REGS[MIPS_REGS]; /* register file. */
-  uint32_t HI, LO;                          /* special regs for mult/div. */
-} CPU_State;
-
-
-
-/***************************************************************/
-/* CPU State info.                                                                                                               */
-/***************************************************************/
-
-CPU_State CURRENT_STATE, NEXT_STATE;
-int RUN_FLAG;	/* run flag*/
-uint32_t INSTRUCTION_COUNT;
-uint32_t PROGRAM_SIZE; /*in words*/
-
-char prog_file[32];
-
-
-/***************************************************************/
-/* Function Declerations.                                                                                                */
-/***************************************************************/
-void help();
-uint32_t mem_read_32(uint32_t address);
-void mem_write_32(uint32_t address, uint32_t value);
-void cycle();
-void run(int num_cycles);
-void runAll();
-void mdump(uint32_t start, uint32_t stop) ;
-void rdump();
-void handle_command();
-void reset();
-void init_memory();
-void load_program();
-void handle_instruction(); /*IMPLEMENT THIS*/
-void initialize();
-void print_program(); /*IMPLEMENT THIS*/
-void print_instruction(uint32_t);
-
-/***************************************************************/
-/* HELPER Function Declerations.                                                                                                */
-/***************************************************************/
-typedef struct MIPS_INSTRUCT {
- char* op;
- int rs;
- int rt;
- int rd;
- uint32_t shamt;
- char* funct;
- uint32_t immediate;
- char* address;
-} MIPS;
-
-
-char* returnRegister(char* reg);
-char* hex_to_binary(char Hexdigit);
-char FindFormat(char* instruction);
-char* GetIFunction(char* instruction, char* rt);
-char* GetJFunction(char* instruction);
-int convertBinarytoDecimal(char * binary);
-void returnRFormat(char* instruction, MIPS*);
-void returnIFormat(char* instruction, MIPS*);
-void returnJFormat(char* instruction, MIPS*);
-void getSingleInstruct(MIPS*);
-
+#ifndef MU_MIPS_H
+#define MU_MIPS_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <math.h>
+
+#define FALSE 0
+#define TRUE  1
+
+/******************************************************************************/
+/* MIPS memory layout                                                                                                                                      */
+/******************************************************************************/
+#define MEM_TEXT_BEGIN  0x00400000
+#define MEM_TEXT_END      0x0FFFFFFF
+/*Memory address 0x10000000 to 0x1000FFFF access by $gp*/
+#define MEM_DATA_BEGIN  0x10010000
+#define MEM_DATA_END   0x7FFFFFFF
+
+#define MEM_KTEXT_BEGIN 0x80000000
+#define MEM_KTEXT_END  0x8FFFFFFF
+
+#define MEM_KDATA_BEGIN 0x90000000
+#define MEM_KDATA_END  0xFFFEFFFF
+
+/*stack and data segments occupy the same memory space. Stack grows backward (from higher address to lower address) */
+#define MEM_STACK_BEGIN 0x7FFFFFFF
+#define MEM_STACK_END  0x10010000
+
+typedef struct {
+	uint32_t begin, end;
+} mem_region_t;
+
+/* only addresses inside a region are backed by memory */
+extern const mem_region_t MEM_REGIONS[];
+
+#define NUM_MEM_REGION 4
+
+/******************************************************************************/
+/* Guest memory is a sparse two-level page table. Pages are allocated on first */
+/* write; reading a page that was never written returns zero. */
+/******************************************************************************/
+#define PAGE_SHIFT 12
+#define PAGE_SIZE  (1u << PAGE_SHIFT)
+#define PAGE_MASK  (PAGE_SIZE - 1)
+#define PAGE_TABLE_BITS 10	/* 1024 directory entries x 1024 pages x 4 KB = 4 GB */
+#define PAGE_TABLE_SIZE (1u << PAGE_TABLE_BITS)
+
+/* Direct-mapped software TLBs from guest page to host page. A tag holds the */
+/* page base address, so a misaligned access never matches and falls to the */
+/* slow path. Pages holding decoded text are never entered in TLB_WRITE. */
+#define TLB_BITS 8
+#define TLB_SIZE (1u << TLB_BITS)
+#define TLB_INVALID 1u
+#define TLB_INDEX(address) (((address) >> PAGE_SHIFT) & (TLB_SIZE - 1))
+
+typedef struct {
+	uint32_t tag;
+	uint8_t *host;
+} tlb_entry_t;
+
+/* Page flags, one byte per guest page next to its host pointer. */
+#define PAGE_FILE  1	/* lives in a mapped program file, which owns it */
+#define PAGE_COW   2	/* shared with a snapshot: copied before the first write */
+#define PAGE_DIRTY 4	/* written since the base snapshot */
+
+typedef struct {
+	uint8_t *page[PAGE_TABLE_SIZE];
+	uint8_t flags[PAGE_TABLE_SIZE];
+} page_table_t;
+
+/* Pages the simulator allocates are reference counted, so snapshots can */
+/* share them. The count lives in a header just below the page. */
+#define PAGE_HEADER_SIZE 64
+
+/* program files mapped into guest memory by the loader; shared with snapshots */
+typedef struct {
+	void *base;
+	size_t length;
+	int refs;
+} host_mapping_t;
+
+#define MIPS_REGS 32
+
+typedef struct CPU_State_Struct {
+
+  uint32_t PC;		                   /* program counter */
+  uint32_t REGS[MIPS_REGS]; /* register file. */
+  uint32_t HI, LO;                          /* special regs for mult/div. */
+} CPU_State;
+
+/* Operation ids produced by the decoder. OP_UNDECODED marks an empty decode cache slot. */
+typedef enum {
+	OP_UNDECODED = 0,
+	OP_ADD, OP_ADDU, OP_ADDI, OP_ADDIU, OP_SUB, OP_SUBU,
+	OP_MULT, OP_MULTU, OP_DIV, OP_DIVU,
+	OP_AND, OP_ANDI, OP_OR, OP_ORI, OP_XOR, OP_XORI, OP_NOR,
+	OP_SLT, OP_SLTI, OP_SLL, OP_SRL, OP_SRA,
+	OP_LUI, OP_LW, OP_LB, OP_LH, OP_SW, OP_SB, OP_SH,
+	OP_MFHI, OP_MFLO, OP_MTHI, OP_MTLO,
+	OP_BEQ, OP_BNE, OP_BLEZ, OP_BLTZ, OP_BGEZ, OP_BGTZ,
+	OP_J, OP_JR, OP_JAL, OP_JALR,
+	OP_SYSCALL,
+	OP_INVALID,
+	NUM_OPS
+} mips_op_t;
+
+/* Decoded instruction. Integer fields only, so it can be cached per PC. */
+typedef struct MIPS_INSTRUCT {
+	uint8_t op;		/* mips_op_t */
+	uint8_t rs;
+	uint8_t rt;
+	uint8_t rd;
+	uint8_t shamt;
+	uint32_t immediate;	/* sign-extended (zero-extended for ANDI/ORI/XORI, pre-shifted for LUI) */
+	uint32_t target;	/* branch/jump target address */
+} MIPS;
+
+/* handle_command() results */
+#define COMMAND_OK   0
+#define COMMAND_QUIT 1
+#define COMMAND_EOF  2
+
+/* How much the simulator prints while it runs. */
+#define VERBOSITY_QUIET   0	/* only what commands explicitly ask for */
+#define VERBOSITY_SUMMARY 1	/* start/stop and load messages */
+#define VERBOSITY_TRACE   2	/* every loaded word and executed instruction */
+#define TRACE_BUFFER_SIZE (1 << 20)
+
+/* Execution statistics. Build with -DMU_STATS=0 to compile the counters out. */
+#ifndef MU_STATS
+#define MU_STATS 1
+#endif
+#define STATS_TOP_PCS 10	/* hottest PCs listed by the stats command */
+#define STATS_CHUNK_BITS 10	/* per-PC counts are allocated 1024 words of text at a time */
+
+/* Superinstructions in the block engine. Build with -DMU_FUSE=0 to translate every instruction alone. */
+#ifndef MU_FUSE
+#define MU_FUSE 1
+#endif
+#define NUM_FUSIONS 13		/* entries in FUSION_TABLE */
+
+/***************************************************************/
+/* Simulator context. Everything one simulation needs: CPU state, */
+/* memory, caches and configuration. Contexts share nothing, so */
+/* independent simulations can run on different threads. */
+/***************************************************************/
+typedef struct sim_context_struct {
+	/* CPU State info. */
+	CPU_State CURRENT_STATE, NEXT_STATE;
+	int RUN_FLAG;			/* run flag*/
+	uint32_t EXIT_CODE;		/* set by the exit syscalls */
+	uint32_t INSTRUCTION_COUNT;
+
+	/* program */
+	char *prog_file;
+	int PROG_FORMAT;		/* FORMAT_* from mu-loader.h */
+	uint32_t PROGRAM_SIZE;		/*in words*/
+	uint32_t PROGRAM_ENTRY;		/* initial PC */
+
+	/* memory */
+	page_table_t *PAGE_DIRECTORY[PAGE_TABLE_SIZE];
+	uint32_t PAGES_ALLOCATED;	/* pages allocated by the simulator */
+	uint32_t PAGES_MAPPED;		/* pages backed by a mapped program file */
+	tlb_entry_t TLB_READ[TLB_SIZE], TLB_WRITE[TLB_SIZE];
+	host_mapping_t **HOST_MAPPINGS;
+	int NUM_HOST_MAPPINGS;
+
+	/* snapshots (mu-snapshot.c) */
+	uint32_t BASE_SNAPSHOT;		/* id of the snapshot memory last matched, 0 for none */
+	uint32_t *DIRTY_PAGES;		/* pages written since then */
+	uint32_t NUM_DIRTY_PAGES, DIRTY_PAGES_CAPACITY;
+	struct sim_snapshot_struct *LOAD_SNAPSHOT;	/* the image load_program() produced */
+	struct sim_snapshot_struct *USER_SNAPSHOT;	/* taken by the snapshot command */
+
+	/* decode cache: one pre-decoded record per word of the loaded text segment */
+	MIPS *DECODE_CACHE;
+	uint32_t *DECODE_WORDS;		/* the word each record was decoded from, for the trace recorder */
+	uint32_t DECODE_CACHE_SIZE;	/*in words*/
+	MIPS UNCACHED;			/* decode of an instruction outside the cache */
+	uint32_t UNCACHED_WORD;		/* and the word it was decoded from */
+
+	/* basic-block engine (mu-block.c) */
+	int ENGINE;
+	struct block_struct **BLOCK_MAP;	/* block starting at each word of decoded text */
+	uint32_t BLOCK_MAP_SIZE;		/* in words */
+	struct block_struct *ALL_BLOCKS;
+	int BLOCKS_STALE;
+	uint32_t BLOCK_GENERATION;	/* bumped whenever translated text changes */
+	uint64_t BLOCKS_EXECUTED;
+	uint32_t BLOCKS_TRANSLATED;
+	uint64_t BLOCKS_REPORTED;	/* BLOCKS_EXECUTED at the last speed report */
+
+	/* x86-64 translator (mu-jit.c) */
+	uint8_t *JIT_CACHE;		/* executable code cache, mapped on first use */
+	uint32_t JIT_CACHE_USED;	/* bytes */
+	uint32_t BLOCKS_COMPILED;
+
+	/* execution statistics (MU_STATS) */
+	uint64_t OP_COUNT[NUM_OPS];
+	uint64_t OP_REDIRECTS[NUM_OPS];	/* times an op did not continue at PC + 4 */
+	uint64_t **PC_COUNT;		/* per word of decoded text, in chunks allocated on first use */
+	uint32_t PC_COUNT_CHUNKS;
+	uint64_t FUSED_COUNT[NUM_FUSIONS];	/* pairs run by a FUSION_TABLE handler */
+	uint64_t NATIVE_COUNT;		/* instructions run as JIT code, without handlers */
+
+	/* timing models */
+	struct pipeline_struct *PIPELINE;	/* pipeline model (mu-pipeline.c), NULL when off */
+	struct cache_hierarchy_struct *CACHES;	/* cache model (mu-cache.c), NULL when off */
+	struct predict_set_struct *PREDICTORS;	/* branch predictors (mu-predict.c), NULL when off */
+	struct sample_struct *SAMPLER;		/* sampled runs (mu-sample.c), NULL when off */
+
+	/* call-graph profiler (mu-profile.c), NULL when off */
+	struct profile_struct *PROFILER;
+
+	/* breakpoints and watchpoints (mu-debug.c), NULL when none are set */
+	struct debug_struct *DEBUG;
+	int DEBUG_STOP;			/* the engine stopped at one; cleared when a run starts */
+
+	/* checkpoints for reverse stepping (mu-replay.c), NULL when off */
+	struct replay_struct *REPLAY;
+
+	/* output */
+	int VERBOSITY;
+	FILE *TRACE_FILE;
+	struct trace_recorder_struct *RECORDER;	/* binary trace (mu-trace.c), NULL when off */
+} sim_context;
+
+/***************************************************************/
+/* Function Declerations.                                                                                                */
+/***************************************************************/
+sim_context* sim_create();
+void sim_destroy(sim_context *ctx);
+void help();
+uint32_t mem_read_32(sim_context *ctx, uint32_t address);
+uint32_t mem_read_16(sim_context *ctx, uint32_t address);
+uint32_t mem_read_8(sim_context *ctx, uint32_t address);
+void mem_write_32(sim_context *ctx, uint32_t address, uint32_t value);
+void mem_write_16(sim_context *ctx, uint32_t address, uint32_t value);
+void mem_write_8(sim_context *ctx, uint32_t address, uint32_t value);
+void tlb_flush(sim_context *ctx);
+void cycle(sim_context *ctx);
+void run(sim_context *ctx, int num_cycles);
+void runAll(sim_context *ctx);
+void mdump(sim_context *ctx, uint32_t start, uint32_t stop) ;
+void rdump(sim_context *ctx);
+void print_stats(sim_context *ctx);
+void stats_reset(sim_context *ctx);
+uint64_t* stats_pc_count(sim_context *ctx, uint32_t index);
+int handle_command(sim_context *ctx, FILE *in);
+int run_script(sim_context *ctx, const char *path);
+int reset(sim_context *ctx);
+void init_memory(sim_context *ctx);
+void free_memory(sim_context *ctx);
+uint8_t* mem_page(sim_context *ctx, uint32_t address, int allocate);
+int mem_map_host_page(sim_context *ctx, uint32_t address, uint8_t *host);
+void mem_add_mapping(sim_context *ctx, void *base, size_t length);
+uint8_t* mem_page_alloc();
+void mem_page_ref(uint8_t *page, int flags);
+void mem_page_release(uint8_t *page, int flags);
+void mem_mapping_release(host_mapping_t *mapping);
+int load_program(sim_context *ctx);
+void handle_instruction(sim_context *ctx); /*IMPLEMENT THIS*/
+void initialize(sim_context *ctx);
+void print_program(sim_context *ctx); /*IMPLEMENT THIS*/
+void print_instruction(sim_context *ctx, uint32_t);
+void fprint_instruction(sim_context *ctx, FILE*, uint32_t);
+int set_trace_file(sim_context *ctx, const char *path);
+void trace_flush(sim_context *ctx);
+uint32_t execute(sim_context *ctx, uint32_t n);
+double now_seconds();
+
+/***************************************************************/
+/* HELPER Function Declerations.                                                                                                */
+/***************************************************************/
+/* executes one decoded instruction against a CPU state, returns the next PC */
+typedef uint32_t (*mips_handler_t)(sim_context*, CPU_State*, const MIPS*);
+
+extern const mips_handler_t EXEC_TABLE[NUM_OPS];
+extern const char* const OP_NAMES[NUM_OPS];
+
+/* superinstructions: a common pair of adjacent instructions run by one handler */
+typedef struct {
+	uint8_t first, second;		/* mips_op_t of each instruction */
+	mips_handler_t handler;		/* given the pair's two decoded records, returns the next PC */
+} mips_fusion_t;
+
+extern const mips_fusion_t FUSION_TABLE[NUM_FUSIONS];
+int find_fusion(uint8_t first, uint8_t second);
+
+void decode_instruction(uint32_t word, uint32_t pc, MIPS*);
+void init_decode_cache(sim_context *ctx, uint32_t num_words);
+void invalidate_decode_cache(sim_context *ctx, uint32_t address);
+int decode_cache_overlaps(sim_context *ctx, uint32_t address, uint32_t length);
+const MIPS* getSingleInstruct(sim_context *ctx);
+const MIPS* fetch_decoded(sim_context *ctx, uint32_t pc);
+
+mips_op_t GetRFunction(uint32_t funct);
+mips_op_t GetIFunction(uint32_t opcode, uint32_t rt);
+mips_op_t GetJFunction(uint32_t opcode);
+
+#endif
@@ -0,0 +1,299 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "mu-mips.h"
+#include "mu-pipeline.h"
+
+/***************************************************************/
+/* Turn the timing model on or off. config is "off", or a comma */
+/* separated list of "fwd"/"nofwd" and "id"/"ex" (where branches */
+/* resolve); "on" means "fwd,ex". Returns FALSE for a bad config, */
+/* leaving the model as it was. */
+/***************************************************************/
+int pipeline_configure(sim_context *ctx, const char *config)
+{
+	int forwarding = TRUE, branch_stage = PIPE_EX;
+	char buffer[64], *token, *save;
+
+	if (!strcmp(config, "off")) {
+		free(ctx->PIPELINE);
+		ctx->PIPELINE = NULL;
+		return TRUE;
+	}
+	snprintf(buffer, sizeof(buffer), "%s", config);
+	for (token = strtok_r(buffer, ",", &save); token != NULL; token = strtok_r(NULL, ",", &save)) {
+		if (!strcmp(token, "fwd")) {
+			forwarding = TRUE;
+		}
+		else if (!strcmp(token, "nofwd")) {
+			forwarding = FALSE;
+		}
+		else if (!strcmp(token, "id")) {
+			branch_stage = PIPE_ID;
+		}
+		else if (!strcmp(token, "ex")) {
+			branch_stage = PIPE_EX;
+		}
+		else if (strcmp(token, "on")) {
+			return FALSE;
+		}
+	}
+	if (ctx->PIPELINE == NULL) {
+		ctx->PIPELINE = malloc(sizeof(pipeline_t));
+		if (ctx->PIPELINE == NULL) {
+			printf("Error: Can't allocate pipeline model\n");
+			exit(-1);
+		}
+	}
+	ctx->PIPELINE->forwarding = forwarding;
+	ctx->PIPELINE->branch_stage = branch_stage;
+	pipeline_reset(ctx->PIPELINE);
+	return TRUE;
+}
+
+/***************************************************************/
+/* Empty the pipeline and zero the counts, keeping the config. */
+/***************************************************************/
+void pipeline_reset(pipeline_t *p)
+{
+	int forwarding = p->forwarding, branch_stage = p->branch_stage;
+
+	memset(p, 0, sizeof(pipeline_t));
+	p->forwarding = forwarding;
+	p->branch_stage = branch_stage;
+}
+
+/***************************************************************/
+/* Fill a latch with the registers an instruction reads and */
+/* writes, and the stages it needs and produces them in. */
+/***************************************************************/
+static void pipe_operands(const pipeline_t *p, const MIPS *instr, uint32_t pc, pipe_latch_t *l)
+{
+	l->valid = TRUE;
+	l->op = instr->op;
+	l->pc = pc;
+	l->src[0] = l->src[1] = PIPE_NO_REG;
+	l->dest[0] = l->dest[1] = PIPE_NO_REG;
+	l->need = PIPE_EX;
+	l->ready = PIPE_EX;
+
+	switch (instr->op) {
+		case OP_ADD: case OP_ADDU: case OP_SUB: case OP_SUBU:
+		case OP_AND: case OP_OR: case OP_XOR: case OP_NOR: case OP_SLT:
+			l->src[0] = instr->rs;
+			l->src[1] = instr->rt;
+			l->dest[0] = instr->rd;
+			break;
+		case OP_ADDI: case OP_ADDIU: case OP_ANDI: case OP_ORI: case OP_XORI: case OP_SLTI:
+			l->src[0] = instr->rs;
+			l->dest[0] = instr->rt;
+			break;
+		case OP_SLL: case OP_SRL: case OP_SRA:
+			l->src[0] = instr->rt;
+			l->dest[0] = instr->rd;
+			break;
+		case OP_LUI:
+			l->dest[0] = instr->rt;
+			break;
+		case OP_LW: case OP_LB: case OP_LH:
+			l->src[0] = instr->rs;
+			l->dest[0] = instr->rt;
+			l->ready = PIPE_MEM;
+			break;
+		case OP_SW: case OP_SB: case OP_SH:
+			l->src[0] = instr->rs;
+			l->src[1] = instr->rt;
+			break;
+		case OP_MULT: case OP_MULTU: case OP_DIV: case OP_DIVU:
+			l->src[0] = instr->rs;
+			l->src[1] = instr->rt;
+			l->dest[0] = PIPE_HI;
+			l->dest[1] = PIPE_LO;
+			break;
+		case OP_MFHI:
+			l->src[0] = PIPE_HI;
+			l->dest[0] = instr->rd;
+			break;
+		case OP_MFLO:
+			l->src[0] = PIPE_LO;
+			l->dest[0] = instr->rd;
+			break;
+		case OP_MTHI:
+			l->src[0] = instr->rs;
+			l->dest[0] = PIPE_HI;
+			break;
+		case OP_MTLO:
+			l->src[0] = instr->rs;
+			l->dest[0] = PIPE_LO;
+			break;
+		case OP_BEQ: case OP_BNE:
+			l->src[1] = instr->rt;
+			/* fall through */
+		case OP_BLEZ: case OP_BLTZ: case OP_BGEZ: case OP_BGTZ:
+			l->src[0] = instr->rs;
+			l->need = p->branch_stage;
+			break;
+		case OP_JAL:
+			l->dest[0] = 31;
+			break;
+		case OP_JALR:
+			l->dest[0] = instr->rd;
+			/* fall through */
+		case OP_JR:
+			l->src[0] = instr->rs;
+			l->need = PIPE_ID;
+			break;
+		case OP_SYSCALL:
+			l->src[0] = 2;	/* $v0: service */
+			l->src[1] = 4;	/* $a0: argument */
+			break;
+	}
+	/* $zero never carries a dependency */
+	if (l->dest[0] == 0) {
+		l->dest[0] = PIPE_NO_REG;
+	}
+}
+
+static int writes(const pipe_latch_t *l, uint8_t reg)
+{
+	return l->valid && reg != PIPE_NO_REG && (l->dest[0] == reg || l->dest[1] == reg);
+}
+
+/* one clock: everything moves a stage, in enters EX (NULL: a bubble) */
+static void advance(pipeline_t *p, const pipe_latch_t *in)
+{
+	p->MEM_WB = p->EX_MEM;
+	p->EX_MEM = p->ID_EX;
+	if (in != NULL) {
+		p->ID_EX = *in;
+	}
+	else {
+		p->ID_EX.valid = FALSE;
+	}
+	p->cycles++;
+}
+
+/***************************************************************/
+/* Account for one executed instruction. redirected is set when */
+/* it did not continue at pc + 4. */
+/***************************************************************/
+void pipeline_step(pipeline_t *p, const MIPS *instr, uint32_t pc, int redirected)
+{
+	const pipe_latch_t *ahead[3] = { &p->ID_EX, &p->EX_MEM, &p->MEM_WB };
+	int distance[2] = { 0, 0 };	/* of the producer of each source, 0 for the register file */
+	int stall = 0, penalty = 0;
+	pipe_latch_t l;
+	int s, d, need;
+
+	pipe_operands(p, instr, pc, &l);
+
+	/* RAW hazards against the closest earlier writer of each source */
+	for (s = 0; s < 2; s++) {
+		for (d = 0; d < 3; d++) {
+			if (writes(ahead[d], l.src[s])) {
+				distance[s] = d + 1;
+				if (p->forwarding) {
+					need = ahead[d]->ready + 1 - l.need - (d + 1);
+				}
+				else {
+					need = PIPE_WB - PIPE_ID - (d + 1);
+				}
+				if (need > stall) {
+					stall = need;
+				}
+				break;
+			}
+		}
+	}
+	if (stall > 0) {
+		if (l.need == PIPE_ID) {
+			p->stall_branch += stall;
+		}
+		else if (p->forwarding) {
+			p->stall_load_use += stall;
+		}
+		else {
+			p->stall_data += stall;
+		}
+	}
+	if (p->forwarding) {
+		/* closer than WB after stalling: the value comes off a latch */
+		for (s = 0; s < 2; s++) {
+			if (distance[s] != 0 && distance[s] + stall < PIPE_WB - PIPE_ID) {
+				p->forwarded++;
+			}
+		}
+	}
+	for (d = 0; d < stall; d++) {
+		advance(p, NULL);
+	}
+	advance(p, &l);
+	p->instructions++;
+
+	/* squash what was fetched past a redirect */
+	switch (l.op) {
+		case OP_BEQ: case OP_BNE: case OP_BLEZ: case OP_BLTZ: case OP_BGEZ: case OP_BGTZ:
+			if (redirected) {
+				penalty = p->branch_stage - PIPE_IF;
+				p->flush_branch += penalty;
+			}
+			break;
+		case OP_J: case OP_JAL: case OP_JR: case OP_JALR:
+			penalty = PIPE_ID - PIPE_IF;
+			p->flush_jump += penalty;
+			break;
+	}
+	for (d = 0; d < penalty; d++) {
+		advance(p, NULL);
+	}
+}
+
+/***************************************************************/
+/* Freeze the pipeline for cycles, waiting on memory. */
+/***************************************************************/
+void pipeline_memory_stall(pipeline_t *p, uint32_t cycles)
+{
+	p->stall_memory += cycles;
+	p->cycles += cycles;
+}
+
+static double per_instruction(uint64_t count, uint64_t instructions)
+{
+	return instructions ? (double)count / instructions : 0.0;
+}
+
+/***************************************************************/
+/* Print cycles, CPI and where the stall cycles went. */
+/***************************************************************/
+void pipeline_report(sim_context *ctx)
+{
+	const pipeline_t *p = ctx->PIPELINE;
+	uint64_t cycles;
+
+	if (p == NULL) {
+		return;
+	}
+	/* the last instruction still has to get through the pipeline */
+	cycles = p->cycles + (p->instructions ? PIPE_DEPTH - 1 : 0);
+	printf("-------------------------------------\n");
+	printf("Pipeline (%s, branches resolve in %s)\n", p->forwarding ? "forwarding" : "no forwarding",
+			p->branch_stage == PIPE_ID ? "ID" : "EX");
+	printf("-------------------------------------\n");
+	printf("Cycles\t\t: %llu\n", (unsigned long long)cycles);
+	printf("Instructions\t: %llu\n", (unsigned long long)p->instructions);
+	printf("CPI\t\t: %.3f\n", per_instruction(cycles, p->instructions));
+	printf("-------------------------------------\n");
+	printf("[Stall]\t\t[Cycles]\t[Per instr]\n");
+	printf("-------------------------------------\n");
+	printf("load-use\t%-12llu\t%.3f\n", (unsigned long long)p->stall_load_use, per_instruction(p->stall_load_use, p->instructions));
+	printf("data\t\t%-12llu\t%.3f\n", (unsigned long long)p->stall_data, per_instruction(p->stall_data, p->instructions));
+	printf("branch operand\t%-12llu\t%.3f\n", (unsigned long long)p->stall_branch, per_instruction(p->stall_branch, p->instructions));
+	printf("branch flush\t%-12llu\t%.3f\n", (unsigned long long)p->flush_branch, per_instruction(p->flush_branch, p->instructions));
+	printf("jump flush\t%-12llu\t%.3f\n", (unsigned long long)p->flush_jump, per_instruction(p->flush_jump, p->instructions));
+	printf("memory\t\t%-12llu\t%.3f\n", (unsigned long long)p->stall_memory, per_instruction(p->stall_memory, p->instructions));
+	printf("-------------------------------------\n");
+	printf("Forwarded operands\t: %llu\n", (unsigned long long)p->forwarded);
+	printf("-------------------------------------\n");
+}
@@ -0,0 +1,65 @@
+#ifndef MU_PIPELINE_H
+#define MU_PIPELINE_H
+
+#include "mu-mips.h"
+
+/***************************************************************/
+/* Timing model of the classic IF/ID/EX/MEM/WB pipeline. It does */
+/* not execute anything: the interpreter feeds it each instruction */
+/* after running it, and it works out how many cycles that takes. */
+/* */
+/* ALU results are ready after EX, loads after MEM. Without */
+/* forwarding a value can only be read in ID once its producer */
+/* is in WB. Branches are predicted not taken and resolve in ID */
+/* or EX; jumps redirect fetch from ID. MULT/DIV take one EX */
+/* cycle. */
+/***************************************************************/
+#define PIPE_IF  0
+#define PIPE_ID  1
+#define PIPE_EX  2
+#define PIPE_MEM 3
+#define PIPE_WB  4
+#define PIPE_DEPTH 5
+
+#define PIPE_NO_REG 0xFF
+#define PIPE_HI (MIPS_REGS)	/* HI and LO are tracked like GPRs */
+#define PIPE_LO (MIPS_REGS + 1)
+
+/* what an instruction holds in a pipeline latch */
+typedef struct {
+	uint8_t valid;		/* FALSE: a bubble */
+	uint8_t op;		/* mips_op_t */
+	uint8_t src[2];		/* registers read, PIPE_NO_REG if unused */
+	uint8_t dest[2];	/* registers written, PIPE_NO_REG if unused */
+	uint8_t need;		/* stage that reads the sources */
+	uint8_t ready;		/* stage after which dest can be forwarded */
+	uint32_t pc;
+} pipe_latch_t;
+
+typedef struct pipeline_struct {
+	/* configuration */
+	int forwarding;
+	int branch_stage;	/* PIPE_ID or PIPE_EX */
+
+	/* the instructions ahead of the one in ID */
+	pipe_latch_t ID_EX, EX_MEM, MEM_WB;
+
+	/* statistics */
+	uint64_t instructions;
+	uint64_t cycles;		/* without the final drain */
+	uint64_t stall_load_use;	/* operand of the next instruction comes from a load */
+	uint64_t stall_data;		/* RAW hazards without forwarding */
+	uint64_t stall_branch;		/* branch or JR operands not ready in ID */
+	uint64_t flush_branch;		/* taken branches */
+	uint64_t flush_jump;
+	uint64_t stall_memory;		/* cache misses (mu-cache.c), the whole pipeline waits */
+	uint64_t forwarded;		/* operands taken from a latch, not the register file */
+} pipeline_t;
+
+int pipeline_configure(sim_context *ctx, const char *config);
+void pipeline_reset(pipeline_t *p);
+void pipeline_step(pipeline_t *p, const MIPS *instr, uint32_t pc, int redirected);
+void pipeline_memory_stall(pipeline_t *p, uint32_t cycles);
+void pipeline_report(sim_context *ctx);
+
+#endif
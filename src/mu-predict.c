@@ -0,0 +1,424 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "mu-mips.h"
+#include "mu-predict.h"
+
+static uint8_t* counter_table(uint32_t bits)
+{
+	uint8_t *table = malloc(1u << bits);
+
+	if (table == NULL) {
+		printf("Error: Can't allocate predictor tables\n");
+		exit(-1);
+	}
+	return table;
+}
+
+static uint32_t* word_table(uint32_t entries)
+{
+	uint32_t *table = malloc((entries ? entries : 1) * sizeof(uint32_t));
+
+	if (table == NULL) {
+		printf("Error: Can't allocate predictor tables\n");
+		exit(-1);
+	}
+	return table;
+}
+
+static int is_power_of_two(uint32_t n)
+{
+	return n != 0 && (n & (n - 1)) == 0;
+}
+
+/***************************************************************/
+/* Add a predictor, or change the shared settings, from one spec: */
+/*   nottaken | bimodal[:<bits>] | gshare[:<bits>[:<history>]] */
+/*   tournament[:<bits>[:<history>]] */
+/*   btb:<entries> | ras:<depth> | penalty:<cycles> | off */
+/* Table sizes are log2 entries. Returns FALSE for a bad spec. */
+/* Anything that changes empties every table. */
+/***************************************************************/
+int predict_configure(sim_context *ctx, const char *spec)
+{
+	predict_set_t *set = ctx->PREDICTORS;
+	char buffer[64], *name, *arg1, *arg2, *save;
+	uint32_t n1, n2;
+	int kind;
+
+	if (!strcmp(spec, "off")) {
+		predict_free(set);
+		ctx->PREDICTORS = NULL;
+		return TRUE;
+	}
+	snprintf(buffer, sizeof(buffer), "%s", spec);
+	name = strtok_r(buffer, ":", &save);
+	arg1 = strtok_r(NULL, ":", &save);
+	arg2 = strtok_r(NULL, ":", &save);
+	if (name == NULL) {
+		return FALSE;
+	}
+	n1 = arg1 ? strtoul(arg1, NULL, 0) : 0;
+	n2 = arg2 ? strtoul(arg2, NULL, 0) : 0;
+
+	if (!strcmp(name, "nottaken")) {
+		kind = PREDICT_NOT_TAKEN;
+	}
+	else if (!strcmp(name, "bimodal")) {
+		kind = PREDICT_BIMODAL;
+	}
+	else if (!strcmp(name, "gshare")) {
+		kind = PREDICT_GSHARE;
+	}
+	else if (!strcmp(name, "tournament")) {
+		kind = PREDICT_TOURNAMENT;
+	}
+	else if ((!strcmp(name, "btb") && is_power_of_two(n1)) || (!strcmp(name, "ras") && arg1 != NULL)
+			|| (!strcmp(name, "penalty") && arg1 != NULL)) {
+		kind = -1;
+	}
+	else {
+		return FALSE;
+	}
+	if (kind >= 0 && (n1 > 24 || n2 > 32 || (set != NULL && set->num_predictors == PREDICT_MAX))) {
+		return FALSE;
+	}
+
+	if (set == NULL) {
+		set = calloc(1, sizeof(predict_set_t));
+		if (set == NULL) {
+			printf("Error: Can't allocate predictors\n");
+			exit(-1);
+		}
+		set->penalty = PREDICT_DEFAULT_PENALTY;
+		ctx->PREDICTORS = set;
+	}
+	if (kind >= 0) {
+		predictor_t *p = &set->predictor[set->num_predictors++];
+		p->kind = kind;
+		p->bits = n1 ? n1 : PREDICT_DEFAULT_BITS;
+		p->history_bits = kind == PREDICT_GSHARE || kind == PREDICT_TOURNAMENT ? (arg2 ? n2 : p->bits) : 0;
+		if (kind == PREDICT_BIMODAL || kind == PREDICT_TOURNAMENT) {
+			p->local = counter_table(p->bits);
+		}
+		if (kind == PREDICT_GSHARE || kind == PREDICT_TOURNAMENT) {
+			p->global = counter_table(p->bits);
+		}
+		if (kind == PREDICT_TOURNAMENT) {
+			p->chooser = counter_table(p->bits);
+		}
+		if (kind == PREDICT_NOT_TAKEN) {
+			snprintf(p->name, sizeof(p->name), "nottaken");
+		}
+		else if (kind == PREDICT_BIMODAL) {
+			snprintf(p->name, sizeof(p->name), "bimodal:%u", p->bits);
+		}
+		else {
+			snprintf(p->name, sizeof(p->name), "%s:%u:%u", name, p->bits, p->history_bits);
+		}
+	}
+	else if (!strcmp(name, "btb")) {
+		free(set->btb_pc);
+		free(set->btb_target);
+		set->btb_entries = n1;
+		set->btb_pc = word_table(n1);
+		set->btb_target = word_table(n1);
+	}
+	else if (!strcmp(name, "ras")) {
+		free(set->ras);
+		set->ras_depth = n1;
+		set->ras = word_table(n1);
+	}
+	else {
+		set->penalty = n1;
+	}
+	predict_reset(set);
+	return TRUE;
+}
+
+/***************************************************************/
+/* Forget everything learned and zero the counts. Counters start */
+/* weakly not taken. */
+/***************************************************************/
+void predict_reset(predict_set_t *set)
+{
+	int i;
+
+	for (i = 0; i < set->num_predictors; i++) {
+		predictor_t *p = &set->predictor[i];
+		if (p->local != NULL) {
+			memset(p->local, 1, 1u << p->bits);
+		}
+		if (p->global != NULL) {
+			memset(p->global, 1, 1u << p->bits);
+		}
+		if (p->chooser != NULL) {
+			memset(p->chooser, 1, 1u << p->bits);
+		}
+		p->history = 0;
+		p->mispredicted = 0;
+	}
+	if (set->btb_entries != 0) {
+		memset(set->btb_pc, 0, set->btb_entries * sizeof(uint32_t));
+	}
+	set->ras_count = set->ras_top = 0;
+	set->branches = 0;
+	set->jumps = set->jump_misses = 0;
+	set->returns = set->return_misses = 0;
+	free(set->sites);
+	set->sites = NULL;
+	set->sites_capacity = set->num_sites = 0;
+}
+
+void predict_free(predict_set_t *set)
+{
+	int i;
+
+	if (set == NULL) {
+		return;
+	}
+	for (i = 0; i < set->num_predictors; i++) {
+		free(set->predictor[i].local);
+		free(set->predictor[i].global);
+		free(set->predictor[i].chooser);
+	}
+	free(set->btb_pc);
+	free(set->btb_target);
+	free(set->ras);
+	free(set->sites);
+	free(set);
+}
+
+/***************************************************************/
+/* The statistics slot of the branch at pc, created on first use. */
+/***************************************************************/
+static branch_site_t* branch_site(predict_set_t *set, uint32_t pc)
+{
+	uint32_t i, mask;
+
+	if (2 * (set->num_sites + 1) > set->sites_capacity) {
+		branch_site_t *old = set->sites;
+		uint32_t old_capacity = set->sites_capacity;
+		set->sites_capacity = old_capacity ? 2 * old_capacity : 256;
+		set->num_sites = 0;
+		set->sites = calloc(set->sites_capacity, sizeof(branch_site_t));
+		if (set->sites == NULL) {
+			printf("Error: Can't allocate branch statistics\n");
+			exit(-1);
+		}
+		for (i = 0; i < old_capacity; i++) {
+			if (old[i].pc != 0) {
+				*branch_site(set, old[i].pc) = old[i];
+			}
+		}
+		free(old);
+	}
+	mask = set->sites_capacity - 1;
+	for (i = (pc >> 2) * 0x9E3779B1u & mask; set->sites[i].pc != pc; i = (i + 1) & mask) {
+		if (set->sites[i].pc == 0) {
+			set->sites[i].pc = pc;
+			set->num_sites++;
+			break;
+		}
+	}
+	return &set->sites[i];
+}
+
+static void train(uint8_t *counter, int taken)
+{
+	if (taken && *counter < 3) {
+		(*counter)++;
+	}
+	else if (!taken && *counter > 0) {
+		(*counter)--;
+	}
+}
+
+/***************************************************************/
+/* Predict a conditional branch at pc, then learn its outcome. */
+/***************************************************************/
+static int predict_direction(predictor_t *p, uint32_t pc, int taken)
+{
+	uint32_t mask = (1u << p->bits) - 1;
+	uint32_t local = (pc >> 2) & mask;
+	uint32_t global = ((pc >> 2) ^ p->history) & mask;
+	int predicted = FALSE, by_local, by_global;
+
+	switch (p->kind) {
+		case PREDICT_BIMODAL:
+			predicted = p->local[local] >= 2;
+			train(&p->local[local], taken);
+			break;
+		case PREDICT_GSHARE:
+			predicted = p->global[global] >= 2;
+			train(&p->global[global], taken);
+			break;
+		case PREDICT_TOURNAMENT:
+			by_local = p->local[local] >= 2;
+			by_global = p->global[global] >= 2;
+			predicted = p->chooser[local] >= 2 ? by_global : by_local;
+			if (by_local != by_global) {
+				train(&p->chooser[local], by_global == taken);
+			}
+			train(&p->local[local], taken);
+			train(&p->global[global], taken);
+			break;
+	}
+	if (p->history_bits != 0) {
+		p->history = ((p->history << 1) | taken) & (uint32_t)((1ull << p->history_bits) - 1);
+	}
+	return predicted;
+}
+
+/* the BTB entry for pc knows target */
+static int btb_hit(predict_set_t *set, uint32_t pc, uint32_t target)
+{
+	uint32_t i = (pc >> 2) & (set->btb_entries - 1);
+	return set->btb_pc[i] == pc && set->btb_target[i] == target;
+}
+
+static void btb_update(predict_set_t *set, uint32_t pc, uint32_t target)
+{
+	uint32_t i = (pc >> 2) & (set->btb_entries - 1);
+	set->btb_pc[i] = pc;
+	set->btb_target[i] = target;
+}
+
+/***************************************************************/
+/* Account for an executed instruction that went from pc to */
+/* next_pc. Anything but a branch or jump is ignored. */
+/***************************************************************/
+void predict_branch(predict_set_t *set, const MIPS *instr, uint32_t pc, uint32_t next_pc)
+{
+	int taken = next_pc != pc + 4, i, miss;
+	branch_site_t *site;
+
+	switch (instr->op) {
+		case OP_BEQ: case OP_BNE: case OP_BLEZ: case OP_BLTZ: case OP_BGEZ: case OP_BGTZ:
+			set->branches++;
+			site = branch_site(set, pc);
+			site->executed++;
+			site->taken += taken;
+			for (i = 0; i < set->num_predictors; i++) {
+				int predicted = predict_direction(&set->predictor[i], pc, taken);
+				miss = predicted != taken || (taken && set->btb_entries != 0 && !btb_hit(set, pc, next_pc));
+				set->predictor[i].mispredicted += miss;
+				site->mispredicted[i] += miss;
+			}
+			if (taken && set->btb_entries != 0) {
+				btb_update(set, pc, next_pc);
+			}
+			break;
+		case OP_JR:
+			if (instr->rs == 31 && set->ras_depth != 0) {
+				set->returns++;
+				if (set->ras_count == 0) {
+					set->return_misses++;
+					break;
+				}
+				set->ras_top = (set->ras_top + set->ras_depth - 1) % set->ras_depth;
+				set->ras_count--;
+				set->return_misses += set->ras[set->ras_top] != next_pc;
+				break;
+			}
+			/* fall through */
+		case OP_J: case OP_JAL: case OP_JALR:
+			set->jumps++;
+			if (set->btb_entries != 0) {
+				set->jump_misses += !btb_hit(set, pc, next_pc);
+				btb_update(set, pc, next_pc);
+			}
+			else {
+				/* direct targets are decoded in time; indirect ones are not */
+				set->jump_misses += instr->op == OP_JR || instr->op == OP_JALR;
+			}
+			if ((instr->op == OP_JAL || instr->op == OP_JALR) && set->ras_depth != 0) {
+				/* a full stack loses its oldest entry */
+				set->ras[set->ras_top] = pc + 4;
+				set->ras_top = (set->ras_top + 1) % set->ras_depth;
+				if (set->ras_count < set->ras_depth) {
+					set->ras_count++;
+				}
+			}
+			break;
+	}
+}
+
+static double accuracy(uint64_t mispredicted, uint64_t total)
+{
+	return total ? 100.0 * (total - mispredicted) / total : 100.0;
+}
+
+/***************************************************************/
+/* Print each predictor's accuracy and cost, then the busiest */
+/* branches with the accuracy of every predictor on them. */
+/***************************************************************/
+void predict_report(sim_context *ctx)
+{
+	const predict_set_t *set = ctx->PREDICTORS;
+	uint32_t top[STATS_TOP_PCS];
+	int num_top = 0, i, j;
+	uint32_t k;
+
+	if (set == NULL) {
+		return;
+	}
+	printf("-------------------------------------\n");
+	printf("Branch Prediction (%u cycles per miss)\n", set->penalty);
+	printf("-------------------------------------\n");
+	printf("Conditional branches\t: %llu\n", (unsigned long long)set->branches);
+	printf("-------------------------------------\n");
+	printf("[#] [Predictor]\t\t[Misses]\t[Accuracy]\t[Penalty cycles]\n");
+	printf("-------------------------------------\n");
+	for (i = 0; i < set->num_predictors; i++) {
+		const predictor_t *p = &set->predictor[i];
+		printf("%d   %-16s\t%-12llu\t%6.2f%%\t\t%llu\n", i + 1, p->name, (unsigned long long)p->mispredicted,
+				accuracy(p->mispredicted, set->branches), (unsigned long long)(p->mispredicted * set->penalty));
+	}
+	printf("-------------------------------------\n");
+	printf("Jumps\t\t: %llu, %llu missed (%s)\n", (unsigned long long)set->jumps, (unsigned long long)set->jump_misses,
+			set->btb_entries ? "BTB" : "no BTB");
+	if (set->ras_depth != 0) {
+		printf("Returns\t\t: %llu, %llu missed (%u-entry RAS)\n", (unsigned long long)set->returns,
+				(unsigned long long)set->return_misses, set->ras_depth);
+	}
+	printf("Jump penalty\t: %llu cycles\n",
+			(unsigned long long)((set->jump_misses + set->return_misses) * set->penalty));
+
+	/* keep the STATS_TOP_PCS most executed branches, in order */
+	for (k = 0; k < set->sites_capacity; k++) {
+		if (set->sites[k].pc == 0 || (num_top == STATS_TOP_PCS && set->sites[k].executed <= set->sites[top[num_top - 1]].executed)) {
+			continue;
+		}
+		if (num_top < STATS_TOP_PCS) {
+			num_top++;
+		}
+		for (j = num_top - 1; j > 0 && set->sites[top[j - 1]].executed < set->sites[k].executed; j--) {
+			top[j] = top[j - 1];
+		}
+		top[j] = k;
+	}
+	if (num_top == 0) {
+		printf("-------------------------------------\n");
+		return;
+	}
+	printf("-------------------------------------\n");
+	printf("[PC]\t\t[Count]\t\t[Taken]");
+	for (i = 0; i < set->num_predictors; i++) {
+		printf("\t[%d]", i + 1);
+	}
+	printf("\n");
+	printf("-------------------------------------\n");
+	for (j = 0; j < num_top; j++) {
+		const branch_site_t *site = &set->sites[top[j]];
+		printf("0x%08x\t%-12llu\t%6.2f%%", site->pc, (unsigned long long)site->executed,
+				100.0 * site->taken / site->executed);
+		for (i = 0; i < set->num_predictors; i++) {
+			printf("\t%6.2f%%", accuracy(site->mispredicted[i], site->executed));
+		}
+		printf("\n");
+	}
+	printf("-------------------------------------\n");
+}
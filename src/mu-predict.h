@@ -0,0 +1,72 @@
+#ifndef MU_PREDICT_H
+#define MU_PREDICT_H
+
+#include "mu-mips.h"
+
+/***************************************************************/
+/* Branch prediction models. Several direction predictors run side */
+/* by side on the same branch stream, each charged separately. */
+/* Targets come from a BTB and a return-address stack that all the */
+/* predictors share: both learn only from what the program really */
+/* did, so they behave the same whichever predictor is asking. */
+/* */
+/* A conditional branch is mispredicted when its direction is */
+/* wrong, or when it is predicted taken and the BTB (if there is */
+/* one) has no target for it. Jumps miss when the BTB has no */
+/* target; JR $ra misses when the return stack is wrong, other JRs */
+/* when the BTB is. Without a BTB, J and JAL always hit. */
+/***************************************************************/
+#define PREDICT_MAX 8			/* predictors in one run */
+#define PREDICT_DEFAULT_BITS 12		/* log2 of table entries */
+#define PREDICT_DEFAULT_PENALTY 2	/* cycles lost per misprediction: branches resolve in EX */
+
+#define PREDICT_NOT_TAKEN  0
+#define PREDICT_BIMODAL    1
+#define PREDICT_GSHARE     2
+#define PREDICT_TOURNAMENT 3
+
+typedef struct {
+	int kind;
+	uint32_t bits;
+	uint32_t history_bits;		/* gshare and tournament */
+	uint8_t *local;			/* 2-bit counters by PC: bimodal, tournament */
+	uint8_t *global;		/* 2-bit counters by PC ^ history: gshare, tournament */
+	uint8_t *chooser;		/* tournament: >= 2 trusts global */
+	uint32_t history;
+	uint64_t mispredicted;
+	char name[32];
+} predictor_t;
+
+/* one conditional branch in the program */
+typedef struct {
+	uint32_t pc;			/* 0: free slot */
+	uint64_t executed, taken;
+	uint64_t mispredicted[PREDICT_MAX];
+} branch_site_t;
+
+typedef struct predict_set_struct {
+	predictor_t predictor[PREDICT_MAX];
+	int num_predictors;
+	uint32_t penalty;
+
+	/* shared target prediction, 0 entries when absent */
+	uint32_t btb_entries;
+	uint32_t *btb_pc, *btb_target;
+	uint32_t ras_depth, ras_count, ras_top;
+	uint32_t *ras;
+
+	/* statistics */
+	uint64_t branches;
+	uint64_t jumps, jump_misses;
+	uint64_t returns, return_misses;
+	branch_site_t *sites;		/* open addressing by PC */
+	uint32_t sites_capacity, num_sites;
+} predict_set_t;
+
+int predict_configure(sim_context *ctx, const char *spec);
+void predict_reset(predict_set_t *set);
+void predict_free(predict_set_t *set);
+void predict_branch(predict_set_t *set, const MIPS *instr, uint32_t pc, uint32_t next_pc);
+void predict_report(sim_context *ctx);
+
+#endif
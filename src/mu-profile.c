@@ -0,0 +1,404 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "mu-mips.h"
+#include "mu-pipeline.h"
+#include "mu-cache.h"
+#include "mu-profile.h"
+
+static char* copy_string(const char *s)
+{
+	char *copy = malloc(strlen(s) + 1);
+
+	if (copy == NULL) {
+		printf("Error: Can't allocate profiler\n");
+		exit(-1);
+	}
+	return strcpy(copy, s);
+}
+
+/* cycles the timing models have counted; one per instruction without them */
+static uint64_t modelled_cycles(sim_context *ctx)
+{
+	profile_t *p = ctx->PROFILER;
+
+	if (ctx->PIPELINE != NULL) {
+		return ctx->PIPELINE->cycles;
+	}
+	return p->instructions + (ctx->CACHES != NULL ? ctx->CACHES->stall_cycles : 0);
+}
+
+static int compare_symbols(const void *a, const void *b)
+{
+	uint32_t x = ((const profile_symbol_t *)a)->address, y = ((const profile_symbol_t *)b)->address;
+
+	return x < y ? -1 : x > y;
+}
+
+static void free_symbols(profile_t *p)
+{
+	uint32_t i;
+
+	for (i = 0; i < p->num_symbols; i++) {
+		free(p->symbols[i].name);
+	}
+	free(p->symbols);
+	p->symbols = NULL;
+	p->num_symbols = 0;
+}
+
+/***************************************************************/
+/* Read a symbol map, replacing the current one. Returns FALSE if */
+/* the file can't be read. */
+/***************************************************************/
+static int load_symbols(profile_t *p, const char *path)
+{
+	FILE *fp = fopen(path, "r");
+	char line[256], field[3][128];
+	uint32_t capacity = 0;
+
+	if (fp == NULL) {
+		printf("Error: Can't open symbol map %s\n", path);
+		return FALSE;
+	}
+	free_symbols(p);
+	while (fgets(line, sizeof(line), fp) != NULL) {
+		int n = sscanf(line, "%127s %127s %127s", field[0], field[1], field[2]);
+		char *end;
+		uint32_t address;
+
+		if (n < 2 || field[0][0] == '#') {
+			continue;
+		}
+		address = strtoul(field[0], &end, 16);
+		if (*end != '\0') {
+			continue;
+		}
+		if (p->num_symbols == capacity) {
+			capacity = capacity ? 2 * capacity : 256;
+			p->symbols = realloc(p->symbols, capacity * sizeof(profile_symbol_t));
+			if (p->symbols == NULL) {
+				printf("Error: Can't allocate symbol map\n");
+				exit(-1);
+			}
+		}
+		p->symbols[p->num_symbols].address = address;
+		p->symbols[p->num_symbols].name = copy_string(field[n == 2 ? 1 : 2]);
+		p->num_symbols++;
+	}
+	fclose(fp);
+	qsort(p->symbols, p->num_symbols, sizeof(profile_symbol_t), compare_symbols);
+	return TRUE;
+}
+
+/* name of the function at address: a symbol, symbol+offset, or the address */
+static void function_name(const profile_t *p, uint32_t address, char *out, size_t size)
+{
+	uint32_t low = 0, high = p->num_symbols;
+
+	/* last symbol at or below address */
+	while (low < high) {
+		uint32_t mid = (low + high) / 2;
+		if (p->symbols[mid].address <= address) {
+			low = mid + 1;
+		}
+		else {
+			high = mid;
+		}
+	}
+	if (low == 0) {
+		snprintf(out, size, "0x%08x", address);
+	}
+	else if (p->symbols[low - 1].address == address) {
+		snprintf(out, size, "%s", p->symbols[low - 1].name);
+	}
+	else {
+		snprintf(out, size, "%s+0x%x", p->symbols[low - 1].name, address - p->symbols[low - 1].address);
+	}
+}
+
+/***************************************************************/
+/* Change the profiler from one spec: */
+/*   on | off | every:<instructions> | out:<file> | syms:<file> */
+/* Anything but off turns profiling on. Returns FALSE for a bad */
+/* spec. */
+/***************************************************************/
+int profile_configure(sim_context *ctx, const char *spec)
+{
+	profile_t *p = ctx->PROFILER;
+	const char *arg = strchr(spec, ':');
+	char *end;
+
+	if (!strcmp(spec, "off")) {
+		profile_free(p);
+		ctx->PROFILER = NULL;
+		return TRUE;
+	}
+	if (strcmp(spec, "on") && strncmp(spec, "every:", 6) && strncmp(spec, "out:", 4) && strncmp(spec, "syms:", 5)) {
+		return FALSE;
+	}
+	if (arg != NULL && arg[1] == '\0') {
+		return FALSE;
+	}
+	if (p == NULL) {
+		p = calloc(1, sizeof(profile_t));
+		if (p == NULL) {
+			printf("Error: Can't allocate profiler\n");
+			exit(-1);
+		}
+		p->interval = PROFILE_DEFAULT_INTERVAL;
+		p->output = copy_string(PROFILE_DEFAULT_OUTPUT);
+		ctx->PROFILER = p;
+		profile_reset(p);
+		p->last_cycles = modelled_cycles(ctx);
+	}
+	if (!strcmp(spec, "on")) {
+		return TRUE;
+	}
+	arg++;
+	if (!strncmp(spec, "every:", 6)) {
+		uint32_t interval = strtoul(arg, &end, 0);
+		if (*end != '\0' || interval == 0) {
+			return FALSE;
+		}
+		p->interval = interval;
+		if (p->countdown > interval) {
+			p->countdown = interval;
+		}
+		return TRUE;
+	}
+	if (!strncmp(spec, "out:", 4)) {
+		free(p->output);
+		p->output = copy_string(arg);
+		return TRUE;
+	}
+	if (!strncmp(spec, "syms:", 5)) {
+		return load_symbols(p, arg);
+	}
+	return FALSE;
+}
+
+/***************************************************************/
+/* Forget every calling context and sample. The next instruction */
+/* profiled starts the root frame. */
+/***************************************************************/
+void profile_reset(profile_t *p)
+{
+	free(p->nodes);
+	free(p->children);
+	p->nodes = NULL;
+	p->children = NULL;
+	p->num_nodes = p->nodes_capacity = p->children_capacity = 0;
+	p->depth = p->overflow = 0;
+	p->countdown = p->interval;
+	p->last_cycles = 0;
+	p->instructions = p->samples = 0;
+}
+
+void profile_free(profile_t *p)
+{
+	if (p == NULL) {
+		return;
+	}
+	free(p->nodes);
+	free(p->children);
+	free(p->output);
+	free_symbols(p);
+	free(p);
+}
+
+static uint32_t child_hash(uint32_t parent, uint32_t function)
+{
+	return (parent * 0x9E3779B1u) ^ ((function >> 2) * 0x85EBCA6Bu);
+}
+
+/***************************************************************/
+/* The node for function called from parent, created on first */
+/* use. */
+/***************************************************************/
+static uint32_t profile_node(profile_t *p, uint32_t parent, uint32_t function)
+{
+	uint32_t i, mask;
+
+	if (p->num_nodes + 1 >= p->nodes_capacity) {
+		p->nodes_capacity = p->nodes_capacity ? 2 * p->nodes_capacity : 256;
+		p->nodes = realloc(p->nodes, p->nodes_capacity * sizeof(profile_node_t));
+		if (p->nodes == NULL) {
+			printf("Error: Can't allocate profiler\n");
+			exit(-1);
+		}
+		if (p->num_nodes == 0) {
+			p->num_nodes = 1;
+		}
+	}
+	if (2 * (p->num_nodes + 1) > p->children_capacity) {
+		p->children_capacity = p->children_capacity ? 2 * p->children_capacity : 512;
+		free(p->children);
+		p->children = calloc(p->children_capacity, sizeof(uint32_t));
+		if (p->children == NULL) {
+			printf("Error: Can't allocate profiler\n");
+			exit(-1);
+		}
+		mask = p->children_capacity - 1;
+		for (i = 1; i < p->num_nodes; i++) {
+			uint32_t k = child_hash(p->nodes[i].parent, p->nodes[i].function) & mask;
+			while (p->children[k] != 0) {
+				k = (k + 1) & mask;
+			}
+			p->children[k] = i;
+		}
+	}
+
+	mask = p->children_capacity - 1;
+	for (i = child_hash(parent, function) & mask; p->children[i] != 0; i = (i + 1) & mask) {
+		profile_node_t *n = &p->nodes[p->children[i]];
+		if (n->parent == parent && n->function == function) {
+			return p->children[i];
+		}
+	}
+	p->children[i] = p->num_nodes;
+	p->nodes[p->num_nodes].parent = parent;
+	p->nodes[p->num_nodes].function = function;
+	p->nodes[p->num_nodes].instructions = 0;
+	p->nodes[p->num_nodes].cycles = 0;
+	return p->num_nodes++;
+}
+
+/* charge what ran since the last sample to the context on top */
+static void profile_sample(sim_context *ctx, uint32_t instructions)
+{
+	profile_t *p = ctx->PROFILER;
+	profile_node_t *n = &p->nodes[p->stack[p->depth - 1].node];
+	uint64_t cycles = modelled_cycles(ctx);
+
+	n->instructions += instructions;
+	n->cycles += cycles > p->last_cycles ? cycles - p->last_cycles : 0;
+	p->last_cycles = cycles;
+	p->samples++;
+}
+
+/***************************************************************/
+/* Follow count instructions run from start_pc, the last of them */
+/* last, which went on to next_pc: take a sample if one is due, */
+/* then keep the shadow stack. */
+/***************************************************************/
+void profile_block(sim_context *ctx, uint32_t start_pc, uint32_t count, const MIPS *last, uint32_t next_pc)
+{
+	profile_t *p = ctx->PROFILER;
+	uint32_t pc = start_pc + 4 * (count - 1);
+
+	if (p->depth == 0) {
+		/* the root frame is wherever profiling starts */
+		p->stack[0].node = profile_node(p, 0, start_pc);
+		p->stack[0].return_pc = 0;
+		p->depth = 1;
+	}
+	p->instructions += count;
+	if (count >= p->countdown) {
+		profile_sample(ctx, p->interval - p->countdown + count);
+		p->countdown = p->interval;
+	}
+	else {
+		p->countdown -= count;
+	}
+
+	switch (last->op) {
+		case OP_JAL:
+		case OP_JALR:
+			if (p->depth == PROFILE_MAX_DEPTH) {
+				p->overflow++;
+				break;
+			}
+			p->stack[p->depth].node = profile_node(p, p->stack[p->depth - 1].node, next_pc);
+			p->stack[p->depth].return_pc = pc + 4;
+			p->depth++;
+			break;
+		case OP_JR:
+			if (last->rs == 31) {
+				uint32_t d;
+
+				if (p->overflow != 0) {
+					p->overflow--;
+					break;
+				}
+				/* unwind to the call this returns from; other jumps through $ra are not returns */
+				for (d = p->depth - 1; d > 0; d--) {
+					if (p->stack[d].return_pc == next_pc) {
+						p->depth = d;
+						break;
+					}
+				}
+			}
+			break;
+	}
+}
+
+static int write_folded(profile_t *p, const char *path, int cycles, uint32_t *stacks)
+{
+	FILE *fp = fopen(path, "w");
+	uint32_t path_nodes[PROFILE_MAX_DEPTH + 1];
+	char name[160];
+	uint32_t i;
+
+	if (fp == NULL) {
+		printf("Error: Can't open profile output %s\n", path);
+		return FALSE;
+	}
+	*stacks = 0;
+	for (i = 1; i < p->num_nodes; i++) {
+		uint64_t count = cycles ? p->nodes[i].cycles : p->nodes[i].instructions;
+		uint32_t n = 0, node;
+		int d;
+
+		if (count == 0) {
+			continue;
+		}
+		for (node = i; node != 0; node = p->nodes[node].parent) {
+			path_nodes[n++] = node;
+		}
+		for (d = n - 1; d >= 0; d--) {
+			function_name(p, p->nodes[path_nodes[d]].function, name, sizeof(name));
+			fputs(name, fp);
+			fputc(d ? ';' : ' ', fp);
+		}
+		fprintf(fp, "%llu\n", (unsigned long long)count);
+		(*stacks)++;
+	}
+	fclose(fp);
+	return TRUE;
+}
+
+/***************************************************************/
+/* Charge the instructions since the last sample, then write the */
+/* folded stacks. Returns FALSE if a file can't be written. */
+/***************************************************************/
+int profile_write(sim_context *ctx)
+{
+	profile_t *p = ctx->PROFILER;
+	char path[1024];
+	uint32_t stacks;
+
+	if (p == NULL || p->depth == 0) {
+		return TRUE;
+	}
+	if (p->countdown != p->interval) {
+		profile_sample(ctx, p->interval - p->countdown);
+		p->countdown = p->interval;
+	}
+	if (!write_folded(p, p->output, FALSE, &stacks)) {
+		return FALSE;
+	}
+	if (ctx->VERBOSITY >= VERBOSITY_SUMMARY) {
+		printf("Profile: %llu instructions, %llu samples, %u stacks written to %s\n",
+				(unsigned long long)p->instructions, (unsigned long long)p->samples, stacks, p->output);
+	}
+	if (ctx->PIPELINE != NULL || ctx->CACHES != NULL) {
+		snprintf(path, sizeof(path), "%s.cycles", p->output);
+		if (!write_folded(p, path, TRUE, &stacks)) {
+			return FALSE;
+		}
+	}
+	return TRUE;
+}
@@ -0,0 +1,77 @@
+#ifndef MU_PROFILE_H
+#define MU_PROFILE_H
+
+#include "mu-mips.h"
+
+/***************************************************************/
+/* Guest call-graph profiler. A shadow call stack follows JAL and */
+/* JALR (push) and JR $ra (pop back to the frame that made the */
+/* matching call), as a tree of calling contexts. At the first */
+/* block exit after every interval instructions, the context on */
+/* top is charged with the instructions and modelled cycles since */
+/* the last sample. Calls and returns end blocks, so a block's */
+/* instructions all ran in that context, and the engines only */
+/* report block exits (single instructions for the interpreter). */
+/* */
+/* The result is written in the folded-stack format flame graph */
+/* tools read, one "caller;callee;... <count>" line per context: */
+/* instructions to the output file, and modelled cycles to */
+/* <output>.cycles when a pipeline or cache model is on. Without */
+/* one, every instruction is a cycle. */
+/* */
+/* Functions are named from an optional symbol map, one */
+/* "<hex address> <name>" or nm-style "<address> <type> <name>" */
+/* per line; addresses past a symbol show as name+0x<offset>. */
+/***************************************************************/
+#define PROFILE_DEFAULT_INTERVAL 100	/* instructions per sample */
+#define PROFILE_DEFAULT_OUTPUT "profile.folded"
+#define PROFILE_MAX_DEPTH 1024		/* deeper calls are charged to the deepest frame */
+
+typedef struct {
+	uint32_t parent;		/* node index, 0 for the root */
+	uint32_t function;		/* entry address */
+	uint64_t instructions, cycles;
+} profile_node_t;
+
+typedef struct {
+	uint32_t node;
+	uint32_t return_pc;
+} profile_frame_t;
+
+typedef struct {
+	uint32_t address;
+	char *name;
+} profile_symbol_t;
+
+typedef struct profile_struct {
+	uint32_t interval;
+	char *output;
+
+	/* calling-context tree; node 0 is unused */
+	profile_node_t *nodes;
+	uint32_t num_nodes, nodes_capacity;
+	uint32_t *children;		/* open addressing by (parent, function): node index, 0 if free */
+	uint32_t children_capacity;
+
+	/* shadow call stack */
+	profile_frame_t stack[PROFILE_MAX_DEPTH];
+	uint32_t depth;
+	uint32_t overflow;		/* calls not pushed because the stack was full */
+
+	/* sampling */
+	uint32_t countdown;		/* instructions until the next sample */
+	uint64_t last_cycles;		/* modelled cycles at the last sample */
+	uint64_t instructions;
+	uint64_t samples;
+
+	profile_symbol_t *symbols;	/* sorted by address */
+	uint32_t num_symbols;
+} profile_t;
+
+int profile_configure(sim_context *ctx, const char *spec);
+void profile_reset(profile_t *p);
+void profile_free(profile_t *p);
+void profile_block(sim_context *ctx, uint32_t start_pc, uint32_t count, const MIPS *last, uint32_t next_pc);
+int profile_write(sim_context *ctx);
+
+#endif
@@ -0,0 +1,407 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <stdint.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "mu-mips.h"
+#include "mu-regress.h"
+
+typedef struct {
+	regress_job_t *jobs;
+	int num_jobs;
+	int capacity;
+} regress_corpus_t;
+
+/* Per-worker job deque. The owner pops from the tail; idle workers */
+/* steal from the head, so the oldest work is the first stolen. */
+typedef struct {
+	pthread_mutex_t lock;
+	int *jobs;
+	int head, tail;
+} job_queue_t;
+
+typedef struct {
+	const sim_context *config;
+	uint32_t limit;
+	regress_job_t *jobs;
+	job_queue_t *queues;
+	int num_queues;
+} regress_pool_t;
+
+typedef struct {
+	regress_pool_t *pool;
+	int id;
+	pthread_t thread;
+} regress_worker_t;
+
+static char* join_path(const char *dir, size_t dir_length, const char *name)
+{
+	char *path = malloc(dir_length + strlen(name) + 2);
+
+	if (path == NULL) {
+		printf("Error: Can't allocate path\n");
+		exit(-1);
+	}
+	if (dir_length == 0 || name[0] == '/') {
+		strcpy(path, name);
+	}
+	else {
+		sprintf(path, "%.*s/%s", (int)dir_length, dir, name);
+	}
+	return path;
+}
+
+/* takes ownership of program and expect */
+static void add_job(regress_corpus_t *corpus, char *program, char *expect)
+{
+	if (corpus->num_jobs == corpus->capacity) {
+		corpus->capacity = corpus->capacity ? 2 * corpus->capacity : 64;
+		corpus->jobs = realloc(corpus->jobs, corpus->capacity * sizeof(regress_job_t));
+		if (corpus->jobs == NULL) {
+			printf("Error: Can't allocate regression jobs\n");
+			exit(-1);
+		}
+	}
+	memset(&corpus->jobs[corpus->num_jobs], 0, sizeof(regress_job_t));
+	corpus->jobs[corpus->num_jobs].program = program;
+	corpus->jobs[corpus->num_jobs].expect = expect;
+	corpus->num_jobs++;
+}
+
+static int compare_names(const void *a, const void *b)
+{
+	return strcmp(*(char * const *)a, *(char * const *)b);
+}
+
+/***************************************************************/
+/* Every *.in file in dir, in name order, with its *.expect file. */
+/***************************************************************/
+static int load_directory(regress_corpus_t *corpus, const char *dir)
+{
+	DIR *d = opendir(dir);
+	struct dirent *entry;
+	char **names = NULL;
+	int num_names = 0, i;
+
+	if (d == NULL) {
+		printf("Error: Can't open regression directory %s\n", dir);
+		return FALSE;
+	}
+	while ((entry = readdir(d)) != NULL) {
+		size_t length = strlen(entry->d_name);
+		if (length > 3 && !strcmp(entry->d_name + length - 3, ".in")) {
+			names = realloc(names, (num_names + 1) * sizeof(char *));
+			if (names == NULL || (names[num_names] = strdup(entry->d_name)) == NULL) {
+				printf("Error: Can't allocate regression jobs\n");
+				exit(-1);
+			}
+			num_names++;
+		}
+	}
+	closedir(d);
+	qsort(names, num_names, sizeof(char *), compare_names);
+
+	for (i = 0; i < num_names; i++) {
+		char *program = join_path(dir, strlen(dir), names[i]);
+		size_t length = strlen(program) - 3;
+		char *expect = malloc(length + sizeof(".expect"));
+
+		if (expect == NULL) {
+			printf("Error: Can't allocate path\n");
+			exit(-1);
+		}
+		sprintf(expect, "%.*s.expect", (int)length, program);
+		if (access(expect, R_OK) != 0) {
+			free(expect);
+			expect = NULL;
+		}
+		add_job(corpus, program, expect);
+		free(names[i]);
+	}
+	free(names);
+	return TRUE;
+}
+
+/***************************************************************/
+/* One "<program> [<expect file>]" per line; relative paths are */
+/* taken from the manifest's directory. */
+/***************************************************************/
+static int load_manifest(regress_corpus_t *corpus, const char *path)
+{
+	FILE *fp = fopen(path, "r");
+	const char *slash = strrchr(path, '/');
+	size_t dir_length = slash ? (size_t)(slash - path) : 0;
+	char line[1024], program[512], expect[512];
+	int n;
+
+	if (fp == NULL) {
+		printf("Error: Can't open regression manifest %s\n", path);
+		return FALSE;
+	}
+	while (fgets(line, sizeof(line), fp) != NULL) {
+		n = sscanf(line, "%511s %511s", program, expect);
+		if (n < 1 || program[0] == '#') {
+			continue;
+		}
+		add_job(corpus, join_path(path, dir_length, program),
+				n == 2 && expect[0] != '#' ? join_path(path, dir_length, expect) : NULL);
+	}
+	fclose(fp);
+	return TRUE;
+}
+
+/***************************************************************/
+/* Compare the final state against job->expect. Records the first */
+/* mismatch in job->message and returns FALSE if there is one. */
+/***************************************************************/
+static int check_expectations(sim_context *ctx, regress_job_t *job)
+{
+	FILE *fp = fopen(job->expect, "r");
+	char line[256], key[16], arg1[32], arg2[32];
+	uint32_t actual, expected, address;
+	unsigned long reg;
+	char *end;
+	int n, line_no = 0;
+
+	if (fp == NULL) {
+		snprintf(job->message, sizeof(job->message), "can't open %s", job->expect);
+		return FALSE;
+	}
+	while (fgets(line, sizeof(line), fp) != NULL) {
+		line_no++;
+		n = sscanf(line, "%15s %31s %31s", key, arg1, arg2);
+		if (n < 1 || key[0] == '#') {
+			continue;
+		}
+		expected = strtoul(arg1, NULL, 0);
+		if (!strcmp(key, "mem") && n == 3) {
+			address = expected;
+			expected = strtoul(arg2, NULL, 0);
+			actual = mem_read_32(ctx, address);
+			snprintf(key, sizeof(key), "[0x%08x]", address);
+		}
+		else if ((key[0] == 'r' || key[0] == 'R') && n == 2 && isdigit((unsigned char)key[1])
+				&& (reg = strtoul(key + 1, &end, 10)) < MIPS_REGS && *end == '\0') {
+			actual = ctx->CURRENT_STATE.REGS[reg];
+		}
+		else if (!strcmp(key, "hi") && n == 2) {
+			actual = ctx->CURRENT_STATE.HI;
+		}
+		else if (!strcmp(key, "lo") && n == 2) {
+			actual = ctx->CURRENT_STATE.LO;
+		}
+		else if (!strcmp(key, "pc") && n == 2) {
+			actual = ctx->CURRENT_STATE.PC;
+		}
+		else if (!strcmp(key, "count") && n == 2) {
+			actual = ctx->INSTRUCTION_COUNT;
+		}
+		else {
+			snprintf(job->message, sizeof(job->message), "%s:%d: bad expectation", job->expect, line_no);
+			fclose(fp);
+			return FALSE;
+		}
+		if (actual != expected) {
+			snprintf(job->message, sizeof(job->message), "%s is 0x%08x, expected 0x%08x", key, actual, expected);
+			fclose(fp);
+			return FALSE;
+		}
+	}
+	fclose(fp);
+	return TRUE;
+}
+
+/***************************************************************/
+/* Simulate one program in its own context and check the result. */
+/***************************************************************/
+static void run_job(const sim_context *config, regress_job_t *job, uint32_t limit)
+{
+	sim_context *ctx = sim_create();
+	double start = now_seconds();
+
+	ctx->PROG_FORMAT = config->PROG_FORMAT;
+	ctx->ENGINE = config->ENGINE;
+	ctx->VERBOSITY = VERBOSITY_QUIET;
+	ctx->prog_file = job->program;
+
+	if (!load_program(ctx)) {
+		snprintf(job->message, sizeof(job->message), "can't load program");
+	}
+	else {
+		ctx->CURRENT_STATE.PC = ctx->PROGRAM_ENTRY;
+		ctx->NEXT_STATE = ctx->CURRENT_STATE;
+		ctx->RUN_FLAG = TRUE;
+		run(ctx, limit);
+
+		if (ctx->RUN_FLAG) {
+			snprintf(job->message, sizeof(job->message), "did not halt within %u instructions", limit);
+		}
+		else {
+			job->passed = job->expect == NULL || check_expectations(ctx, job);
+		}
+	}
+	job->instructions = ctx->INSTRUCTION_COUNT;
+	job->seconds = now_seconds() - start;
+	sim_destroy(ctx);
+}
+
+static int queue_pop(job_queue_t *q)
+{
+	int job = -1;
+
+	pthread_mutex_lock(&q->lock);
+	if (q->tail > q->head) {
+		job = q->jobs[--q->tail];
+	}
+	pthread_mutex_unlock(&q->lock);
+	return job;
+}
+
+static int queue_steal(job_queue_t *q)
+{
+	int job = -1;
+
+	pthread_mutex_lock(&q->lock);
+	if (q->tail > q->head) {
+		job = q->jobs[q->head++];
+	}
+	pthread_mutex_unlock(&q->lock);
+	return job;
+}
+
+/***************************************************************/
+/* Run jobs from this worker's queue, then steal from the others. */
+/* Jobs never create jobs, so once every queue is empty the worker */
+/* is done. */
+/***************************************************************/
+static void* regress_worker(void *arg)
+{
+	regress_worker_t *w = arg;
+	regress_pool_t *pool = w->pool;
+	int job, i;
+
+	for (;;) {
+		job = queue_pop(&pool->queues[w->id]);
+		for (i = 1; job < 0 && i < pool->num_queues; i++) {
+			job = queue_steal(&pool->queues[(w->id + i) % pool->num_queues]);
+		}
+		if (job < 0) {
+			return NULL;
+		}
+		run_job(pool->config, &pool->jobs[job], pool->limit);
+	}
+}
+
+static void run_pool(regress_pool_t *pool, int num_jobs)
+{
+	regress_worker_t *workers = calloc(pool->num_queues, sizeof(regress_worker_t));
+	int i;
+
+	pool->queues = calloc(pool->num_queues, sizeof(job_queue_t));
+	if (workers == NULL || pool->queues == NULL) {
+		printf("Error: Can't allocate thread pool\n");
+		exit(-1);
+	}
+	for (i = 0; i < pool->num_queues; i++) {
+		pthread_mutex_init(&pool->queues[i].lock, NULL);
+		pool->queues[i].jobs = malloc((num_jobs / pool->num_queues + 1) * sizeof(int));
+		if (pool->queues[i].jobs == NULL) {
+			printf("Error: Can't allocate thread pool\n");
+			exit(-1);
+		}
+	}
+	/* deal the jobs out round-robin; stealing evens out the rest */
+	for (i = 0; i < num_jobs; i++) {
+		job_queue_t *q = &pool->queues[i % pool->num_queues];
+		q->jobs[q->tail++] = i;
+	}
+
+	for (i = 0; i < pool->num_queues; i++) {
+		workers[i].pool = pool;
+		workers[i].id = i;
+		if (pthread_create(&workers[i].thread, NULL, regress_worker, &workers[i]) != 0) {
+			printf("Error: Can't start worker thread\n");
+			exit(-1);
+		}
+	}
+	for (i = 0; i < pool->num_queues; i++) {
+		pthread_join(workers[i].thread, NULL);
+	}
+
+	for (i = 0; i < pool->num_queues; i++) {
+		pthread_mutex_destroy(&pool->queues[i].lock);
+		free(pool->queues[i].jobs);
+	}
+	free(pool->queues);
+	free(workers);
+}
+
+/***************************************************************/
+/* Run the corpus at path (a directory or a manifest) on threads */
+/* workers (0 for one per host core) using the engine and program */
+/* format of config. Prints one line per program and a summary, */
+/* and returns the number of failures, or -1 if the corpus can't */
+/* be read. */
+/***************************************************************/
+int run_regression(const sim_context *config, const char *path, int threads, uint32_t limit)
+{
+	regress_corpus_t corpus = { NULL, 0, 0 };
+	regress_pool_t pool;
+	struct stat st;
+	uint64_t total_instructions = 0;
+	double start, elapsed;
+	int failed = 0, i;
+
+	if (stat(path, &st) == 0 && S_ISDIR(st.st_mode)) {
+		if (!load_directory(&corpus, path)) {
+			return -1;
+		}
+	}
+	else if (!load_manifest(&corpus, path)) {
+		return -1;
+	}
+	if (threads <= 0) {
+		threads = sysconf(_SC_NPROCESSORS_ONLN);
+	}
+	if (threads > corpus.num_jobs) {
+		threads = corpus.num_jobs;
+	}
+	if (threads < 1) {
+		threads = 1;
+	}
+
+	pool.config = config;
+	pool.limit = limit;
+	pool.jobs = corpus.jobs;
+	pool.num_queues = threads;
+	start = now_seconds();
+	run_pool(&pool, corpus.num_jobs);
+	elapsed = now_seconds() - start;
+
+	for (i = 0; i < corpus.num_jobs; i++) {
+		regress_job_t *job = &corpus.jobs[i];
+
+		printf("%s  %-32s %12u instructions %10.6f s", job->passed ? "PASS" : "FAIL",
+				job->program, job->instructions, job->seconds);
+		if (!job->passed) {
+			printf("  (%s)", job->message);
+			failed++;
+		}
+		printf("\n");
+		total_instructions += job->instructions;
+		free(job->program);
+		free(job->expect);
+	}
+	free(corpus.jobs);
+
+	printf("-------------------------------------\n");
+	printf("%d programs: %d passed, %d failed\n", corpus.num_jobs, corpus.num_jobs - failed, failed);
+	printf("%llu instructions in %.6f s on %d threads\n\n", (unsigned long long)total_instructions, elapsed, threads);
+	fflush(stdout);
+	return failed;
+}
@@ -0,0 +1,34 @@
+#ifndef MU_REGRESS_H
+#define MU_REGRESS_H
+
+#include "mu-mips.h"
+
+/***************************************************************/
+/* Regression runner. Simulates a corpus of programs concurrently */
+/* and checks each one's final state against an expectation file. */
+/* */
+/* The corpus is either a directory, where every *.in program is */
+/* checked against the *.expect file of the same name (if any), or */
+/* a manifest listing "<program> [<expect file>]" per line. */
+/* */
+/* Expectation files hold one check per line: */
+/*   r<n> <value>      final value of GPR n */
+/*   hi|lo|pc <value>  final HI, LO or PC */
+/*   mem <addr> <value>  final word at addr */
+/*   count <n>         instructions executed */
+/* Every program must also halt within the instruction limit. */
+/***************************************************************/
+#define REGRESS_DEFAULT_LIMIT 100000000u	/* instructions per program */
+
+typedef struct {
+	char *program;
+	char *expect;		/* NULL: the program only has to halt */
+	int passed;
+	uint32_t instructions;
+	double seconds;
+	char message[128];	/* why it failed */
+} regress_job_t;
+
+int run_regression(const sim_context *config, const char *path, int threads, uint32_t limit);
+
+#endif
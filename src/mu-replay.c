@@ -0,0 +1,343 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "mu-mips.h"
+#include "mu-snapshot.h"
+#include "mu-debug.h"
+#include "mu-replay.h"
+
+/***************************************************************/
+/* Change replay from one spec: */
+/*   on | off | every:<instructions> | budget:<megabytes> */
+/* Anything but off turns it on; the first checkpoint is taken */
+/* when the simulator next runs. Returns FALSE for a bad spec. */
+/***************************************************************/
+int replay_configure(sim_context *ctx, const char *spec)
+{
+	replay_t *r = ctx->REPLAY;
+	const char *arg = strchr(spec, ':');
+	unsigned long value = 0;
+	char *end;
+
+	if (!strcmp(spec, "off")) {
+		replay_free(r);
+		ctx->REPLAY = NULL;
+		return TRUE;
+	}
+	if (strcmp(spec, "on") && strncmp(spec, "every:", 6) && strncmp(spec, "budget:", 7)) {
+		return FALSE;
+	}
+	if (arg != NULL) {
+		value = strtoul(arg + 1, &end, 0);
+		if (arg[1] == '\0' || *end != '\0' || value == 0 || value > UINT32_MAX) {
+			return FALSE;
+		}
+	}
+	if (r == NULL) {
+		r = calloc(1, sizeof(replay_t));
+		if (r == NULL) {
+			printf("Error: Can't allocate replay history\n");
+			exit(-1);
+		}
+		r->base_interval = REPLAY_DEFAULT_INTERVAL;
+		r->budget = REPLAY_DEFAULT_BUDGET;
+		replay_reset(r);
+		r->next_at = ctx->INSTRUCTION_COUNT;
+		ctx->REPLAY = r;
+	}
+	if (!strncmp(spec, "every:", 6)) {
+		/* the spacing of the history so far is left as it is */
+		r->base_interval = r->interval = value;
+		if (r->num_checkpoints != 0) {
+			r->next_at = r->checkpoints[r->num_checkpoints - 1]->INSTRUCTION_COUNT + value;
+		}
+	}
+	else if (!strncmp(spec, "budget:", 7)) {
+		r->budget = (uint64_t)value << 20;
+	}
+	return TRUE;
+}
+
+/***************************************************************/
+/* Forget the history. The next run starts it again. */
+/***************************************************************/
+void replay_reset(replay_t *r)
+{
+	uint32_t i;
+
+	for (i = 0; i < r->num_checkpoints; i++) {
+		snapshot_free(r->checkpoints[i]);
+	}
+	r->num_checkpoints = 0;
+	r->bytes = 0;
+	r->interval = r->base_interval;
+	r->next_at = 0;
+	r->replaying = FALSE;
+}
+
+void replay_free(replay_t *r)
+{
+	if (r == NULL) {
+		return;
+	}
+	replay_reset(r);
+	free(r->checkpoints);
+	free(r);
+}
+
+/***************************************************************/
+/* Memory only the history keeps: page tables, and page versions */
+/* that neither the previous checkpoint nor the live simulator */
+/* shares. A version lives in a run of consecutive checkpoints, */
+/* so comparing with the previous one counts each version once. */
+/***************************************************************/
+static uint64_t history_bytes(sim_context *ctx)
+{
+	replay_t *r = ctx->REPLAY;
+	uint64_t bytes = 0;
+	uint32_t k, i, j;
+
+	for (k = 0; k < r->num_checkpoints; k++) {
+		const sim_snapshot *snap = r->checkpoints[k];
+		const sim_snapshot *prev = k != 0 ? r->checkpoints[k - 1] : NULL;
+
+		bytes += sizeof(sim_snapshot);
+		for (i = 0; i < PAGE_TABLE_SIZE; i++) {
+			const page_table_t *table = snap->PAGE_DIRECTORY[i];
+			const page_table_t *older = prev != NULL ? prev->PAGE_DIRECTORY[i] : NULL;
+			const page_table_t *live = ctx->PAGE_DIRECTORY[i];
+
+			if (table == NULL) {
+				continue;
+			}
+			bytes += sizeof(page_table_t);
+			for (j = 0; j < PAGE_TABLE_SIZE; j++) {
+				uint8_t *page = table->page[j];
+
+				if (page == NULL || (table->flags[j] & PAGE_FILE)
+						|| (older != NULL && older->page[j] == page)
+						|| (live != NULL && live->page[j] == page)) {
+					continue;
+				}
+				bytes += PAGE_SIZE;
+			}
+		}
+	}
+	return bytes;
+}
+
+static void drop_checkpoint(replay_t *r, uint32_t index)
+{
+	snapshot_free(r->checkpoints[index]);
+	memmove(&r->checkpoints[index], &r->checkpoints[index + 1],
+			(r->num_checkpoints - index - 1) * sizeof(sim_snapshot *));
+	r->num_checkpoints--;
+}
+
+/***************************************************************/
+/* Get the history back under budget: drop every other checkpoint */
+/* between the first and the latest and double the interval, or */
+/* with nothing between them, let go of the oldest. */
+/***************************************************************/
+static void thin_history(sim_context *ctx)
+{
+	replay_t *r = ctx->REPLAY;
+	uint32_t i;
+
+	while ((r->bytes = history_bytes(ctx)) > r->budget && r->num_checkpoints > 1) {
+		if (r->num_checkpoints > 2) {
+			for (i = 1; i < r->num_checkpoints - 1; i++) {
+				drop_checkpoint(r, i);
+			}
+			if (r->interval <= UINT32_MAX / 2) {
+				r->interval *= 2;
+			}
+		}
+		else {
+			drop_checkpoint(r, 0);
+		}
+	}
+}
+
+/***************************************************************/
+/* Called before the engine runs: take a checkpoint if one is */
+/* due. Returns how many instructions may run before the next. */
+/***************************************************************/
+uint32_t replay_checkpoint(sim_context *ctx)
+{
+	replay_t *r = ctx->REPLAY;
+
+	if (r->replaying) {
+		return UINT32_MAX;
+	}
+	if (ctx->INSTRUCTION_COUNT >= r->next_at) {
+		if (r->num_checkpoints == r->capacity) {
+			r->capacity = r->capacity ? 2 * r->capacity : 64;
+			r->checkpoints = realloc(r->checkpoints, r->capacity * sizeof(sim_snapshot *));
+			if (r->checkpoints == NULL) {
+				printf("Error: Can't allocate replay history\n");
+				exit(-1);
+			}
+		}
+		r->checkpoints[r->num_checkpoints++] = snapshot_take(ctx);
+		r->next_at = ctx->INSTRUCTION_COUNT + r->interval;
+		thin_history(ctx);
+	}
+	return r->next_at - ctx->INSTRUCTION_COUNT;
+}
+
+/***************************************************************/
+/* The user changed registers: checkpoint again before running */
+/* on, since replaying from an earlier one would not redo that. */
+/***************************************************************/
+void replay_state_changed(sim_context *ctx)
+{
+	if (ctx->REPLAY != NULL) {
+		ctx->REPLAY->next_at = ctx->INSTRUCTION_COUNT;
+	}
+}
+
+/* run forward to instruction count target, through any breakpoints */
+static void replay_to(sim_context *ctx, uint32_t target)
+{
+	while (ctx->RUN_FLAG && ctx->INSTRUCTION_COUNT < target) {
+		ctx->DEBUG_STOP = FALSE;
+		execute(ctx, target - ctx->INSTRUCTION_COUNT);
+	}
+	ctx->DEBUG_STOP = FALSE;
+}
+
+/* latest checkpoint at or before count, or the oldest */
+static uint32_t checkpoint_before(const replay_t *r, uint32_t count)
+{
+	uint32_t k = r->num_checkpoints - 1;
+
+	while (k > 0 && r->checkpoints[k]->INSTRUCTION_COUNT > count) {
+		k--;
+	}
+	return k;
+}
+
+static void restore_checkpoint(sim_context *ctx, uint32_t k)
+{
+	snapshot_restore(ctx, ctx->REPLAY->checkpoints[k]);
+	if (ctx->DEBUG != NULL) {
+		ctx->DEBUG->resuming = FALSE;
+	}
+}
+
+/***************************************************************/
+/* Bring the simulator to instruction count target (or the start */
+/* of the history, if that is later) and make that the present: */
+/* later checkpoints are dropped, and taken again as it runs on. */
+/* Returns FALSE if the history does not reach back to target. */
+/***************************************************************/
+static int replay_go_to(sim_context *ctx, uint32_t target)
+{
+	replay_t *r = ctx->REPLAY;
+	uint32_t k = checkpoint_before(r, target);
+	uint32_t start = r->checkpoints[k]->INSTRUCTION_COUNT;
+
+	restore_checkpoint(ctx, k);
+	while (r->num_checkpoints > k + 1) {
+		drop_checkpoint(r, k + 1);
+	}
+	r->next_at = start + r->interval;
+	replay_to(ctx, target);
+	/* continuing from here runs the instruction at PC first, even on a breakpoint */
+	if (ctx->DEBUG != NULL) {
+		ctx->DEBUG->resuming = TRUE;
+		ctx->DEBUG->resume_pc = ctx->CURRENT_STATE.PC;
+	}
+	return start <= target;
+}
+
+static void report_position(sim_context *ctx, int reached)
+{
+	if (!reached) {
+		printf("Reached the start of the history.\n");
+	}
+	printf("At instruction %u, PC 0x%08x\n\n", ctx->INSTRUCTION_COUNT, ctx->CURRENT_STATE.PC);
+}
+
+static int replay_ready(sim_context *ctx)
+{
+	if (ctx->REPLAY == NULL || ctx->REPLAY->num_checkpoints == 0) {
+		printf("No history: turn replay on and run first.\n");
+		return FALSE;
+	}
+	return TRUE;
+}
+
+/***************************************************************/
+/* Go back n instructions. */
+/***************************************************************/
+void replay_step_back(sim_context *ctx, uint32_t n)
+{
+	uint32_t target;
+
+	if (!replay_ready(ctx)) {
+		return;
+	}
+	target = n > ctx->INSTRUCTION_COUNT ? 0 : ctx->INSTRUCTION_COUNT - n;
+	report_position(ctx, replay_go_to(ctx, target));
+}
+
+/***************************************************************/
+/* Go back to the last breakpoint or watchpoint hit before the */
+/* present, or to the start of the history if there was none. */
+/* Each interval, latest first, is run again from its checkpoint */
+/* watching for hits. */
+/***************************************************************/
+void replay_continue_back(sim_context *ctx)
+{
+	replay_t *r;
+	uint32_t now = ctx->INSTRUCTION_COUNT;
+	uint32_t k, end, hit_at = 0, hit_address = 0;
+	int found = FALSE, hit_mode = 0;
+
+	if (!replay_ready(ctx)) {
+		return;
+	}
+	r = ctx->REPLAY;
+	r->replaying = TRUE;
+	for (k = checkpoint_before(r, now); ctx->DEBUG != NULL && !found; k--) {
+		if (r->checkpoints[k]->INSTRUCTION_COUNT >= now) {
+			if (k == 0) {
+				break;
+			}
+			continue;
+		}
+		end = k + 1 < r->num_checkpoints && r->checkpoints[k + 1]->INSTRUCTION_COUNT < now
+				? r->checkpoints[k + 1]->INSTRUCTION_COUNT : now;
+		restore_checkpoint(ctx, k);
+		while (ctx->RUN_FLAG && ctx->INSTRUCTION_COUNT < end) {
+			ctx->DEBUG_STOP = FALSE;
+			execute(ctx, end - ctx->INSTRUCTION_COUNT);
+			if (ctx->DEBUG_STOP && ctx->INSTRUCTION_COUNT < now) {
+				found = TRUE;
+				hit_at = ctx->INSTRUCTION_COUNT;
+				hit_mode = ctx->DEBUG->stop_mode;
+				hit_address = ctx->DEBUG->stop_address;
+			}
+		}
+		if (k == 0) {
+			break;
+		}
+	}
+	r->replaying = FALSE;
+	ctx->DEBUG_STOP = FALSE;
+
+	if (!found) {
+		replay_go_to(ctx, r->checkpoints[0]->INSTRUCTION_COUNT);
+		report_position(ctx, FALSE);
+		return;
+	}
+	replay_go_to(ctx, hit_at);
+	ctx->DEBUG_STOP = TRUE;
+	ctx->DEBUG->stop_mode = hit_mode;
+	ctx->DEBUG->stop_address = hit_address;
+	debug_report(ctx);
+}
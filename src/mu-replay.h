@@ -0,0 +1,45 @@
+#ifndef MU_REPLAY_H
+#define MU_REPLAY_H
+
+#include "mu-mips.h"
+#include "mu-snapshot.h"
+
+/***************************************************************/
+/* Reverse execution by checkpoint and replay. While replay is */
+/* on, every run takes a copy-on-write snapshot of the simulator */
+/* each interval instructions; a checkpoint then costs one page */
+/* table copy plus the pages the program dirties before the next */
+/* one. The simulator is deterministic, so going back to any */
+/* earlier instruction count is a restore of the nearest earlier */
+/* checkpoint and a re-execution up to that count. */
+/* */
+/* The memory the history costs is measured as the page versions */
+/* only checkpoints still hold, plus their page tables. Over */
+/* budget, every other checkpoint between the first and the */
+/* latest is dropped and the interval doubles, so a reverse step */
+/* never re-executes more than one interval. */
+/***************************************************************/
+#define REPLAY_DEFAULT_INTERVAL 10000000	/* instructions between checkpoints */
+#define REPLAY_DEFAULT_BUDGET (256u << 20)	/* bytes */
+
+typedef struct replay_struct {
+	uint32_t interval;		/* current; doubles when the history is thinned */
+	uint32_t base_interval;		/* as configured */
+	uint64_t budget;		/* bytes */
+	uint64_t bytes;			/* held by the history at the last checkpoint */
+
+	sim_snapshot **checkpoints;	/* oldest first */
+	uint32_t num_checkpoints, capacity;
+	uint32_t next_at;		/* instruction count of the next checkpoint */
+	int replaying;			/* re-executing history: take no checkpoints */
+} replay_t;
+
+int replay_configure(sim_context *ctx, const char *spec);
+void replay_reset(replay_t *r);
+void replay_free(replay_t *r);
+uint32_t replay_checkpoint(sim_context *ctx);
+void replay_state_changed(sim_context *ctx);
+void replay_step_back(sim_context *ctx, uint32_t n);
+void replay_continue_back(sim_context *ctx);
+
+#endif
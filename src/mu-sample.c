@@ -0,0 +1,680 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+
+#include "mu-mips.h"
+#include "mu-block.h"
+#include "mu-jit.h"
+#include "mu-snapshot.h"
+#include "mu-pipeline.h"
+#include "mu-cache.h"
+#include "mu-predict.h"
+#include "mu-debug.h"
+#include "mu-sample.h"
+
+/* the timing models and engine a sampled run was started with */
+typedef struct {
+	pipeline_t *pipeline;
+	cache_hierarchy_t *caches;
+	predict_set_t *predictors;
+	int engine;
+} sample_models_t;
+
+/***************************************************************/
+/* Change sampling from one spec: */
+/*   on | off | period:<n> | warm:<n> | detail:<n> */
+/*   | simpoint:<phases> (0 for systematic) | per:<intervals> */
+/* Anything but off turns it on. Returns FALSE for a bad spec. */
+/***************************************************************/
+int sample_configure(sim_context *ctx, const char *spec)
+{
+	sample_t *s = ctx->SAMPLER;
+	const char *arg = strchr(spec, ':');
+	unsigned long value = 0;
+	char *end;
+
+	if (!strcmp(spec, "off")) {
+		sample_free(s);
+		ctx->SAMPLER = NULL;
+		return TRUE;
+	}
+	if (strcmp(spec, "on") && strncmp(spec, "period:", 7) && strncmp(spec, "warm:", 5)
+			&& strncmp(spec, "detail:", 7) && strncmp(spec, "simpoint:", 9) && strncmp(spec, "per:", 4)) {
+		return FALSE;
+	}
+	if (arg != NULL) {
+		value = strtoul(arg + 1, &end, 0);
+		if (arg[1] == '\0' || *end != '\0' || value > UINT32_MAX) {
+			return FALSE;
+		}
+		if (value == 0 && strncmp(spec, "warm:", 5) && strncmp(spec, "simpoint:", 9)) {
+			return FALSE;
+		}
+	}
+	if (!strncmp(spec, "simpoint:", 9) && value != 0 && !MU_STATS) {
+		printf("SimPoint sampling needs the execution statistics (MU_STATS).\n");
+		return FALSE;
+	}
+	if (s == NULL) {
+		s = calloc(1, sizeof(sample_t));
+		if (s == NULL) {
+			printf("Error: Can't allocate sampler\n");
+			exit(-1);
+		}
+		s->period = SAMPLE_DEFAULT_PERIOD;
+		s->warm = SAMPLE_DEFAULT_WARM;
+		s->detail = SAMPLE_DEFAULT_DETAIL;
+		s->per_cluster = SAMPLE_DEFAULT_PER_CLUSTER;
+		ctx->SAMPLER = s;
+	}
+	if (!strncmp(spec, "period:", 7)) {
+		s->period = value;
+	}
+	else if (!strncmp(spec, "warm:", 5)) {
+		s->warm = value;
+	}
+	else if (!strncmp(spec, "detail:", 7)) {
+		s->detail = value;
+	}
+	else if (!strncmp(spec, "simpoint:", 9)) {
+		s->clusters = value;
+	}
+	else if (!strncmp(spec, "per:", 4)) {
+		s->per_cluster = value;
+	}
+	return TRUE;
+}
+
+void sample_free(sample_t *s)
+{
+	free(s);
+}
+
+/***************************************************************/
+/* Cycles the timing models have counted so far. */
+/***************************************************************/
+static uint64_t model_cycles(sim_context *ctx)
+{
+	const predict_set_t *p = ctx->PREDICTORS;
+	uint64_t cycles;
+
+	if (ctx->PIPELINE != NULL) {
+		return ctx->PIPELINE->cycles;
+	}
+	cycles = ctx->INSTRUCTION_COUNT;
+	if (ctx->CACHES != NULL) {
+		cycles += ctx->CACHES->stall_cycles;
+	}
+	if (p != NULL && p->num_predictors != 0) {
+		cycles += (p->predictor[0].mispredicted + p->jump_misses + p->return_misses) * p->penalty;
+	}
+	return cycles;
+}
+
+static void models_on(sim_context *ctx, const sample_models_t *m)
+{
+	ctx->PIPELINE = m->pipeline;
+	ctx->CACHES = m->caches;
+	ctx->PREDICTORS = m->predictors;
+	ctx->ENGINE = m->engine;
+}
+
+/* fast-forward: no models, on the fastest engine */
+static void models_off(sim_context *ctx)
+{
+	ctx->PIPELINE = NULL;
+	ctx->CACHES = NULL;
+	ctx->PREDICTORS = NULL;
+	ctx->ENGINE = MU_JIT ? ENGINE_JIT : ENGINE_BLOCK;
+}
+
+static uint32_t run_for(sim_context *ctx, uint32_t n)
+{
+	if (n == 0 || !ctx->RUN_FLAG || ctx->DEBUG_STOP) {
+		return 0;
+	}
+	return execute(ctx, n);
+}
+
+static uint32_t min_u32(uint32_t a, uint32_t b)
+{
+	return a < b ? a : b;
+}
+
+/* two-sided 95% Student t for df degrees of freedom */
+static double t_95(uint32_t df)
+{
+	static const double table[30] = {
+		12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+		2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+		2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042
+	};
+
+	if (df == 0) {
+		return 0;
+	}
+	if (df <= 30) {
+		return table[df - 1];
+	}
+	return df <= 40 ? 2.021 : df <= 60 ? 2.000 : df <= 120 ? 1.980 : 1.960;
+}
+
+/* mean and sample variance of n values */
+static double mean_of(const double *x, uint32_t n, double *variance)
+{
+	double mean = 0, sum = 0;
+	uint32_t i;
+
+	for (i = 0; i < n; i++) {
+		mean += x[i];
+	}
+	mean = n ? mean / n : 0;
+	for (i = 0; i < n; i++) {
+		sum += (x[i] - mean) * (x[i] - mean);
+	}
+	*variance = n > 1 ? sum / (n - 1) : 0;
+	return mean;
+}
+
+/***************************************************************/
+/* Systematic sampling: warm, measure, then fast-forward to the */
+/* next period. A window the run ends inside is only used when */
+/* there is no other. */
+/***************************************************************/
+static uint32_t run_systematic(sim_context *ctx, sample_t *s, const sample_models_t *m, uint32_t n)
+{
+	uint32_t executed = 0, done, num = 0, capacity = 0;
+	double *cpi = NULL, partial = -1, variance;
+	uint64_t cycles;
+
+	while (executed < n && ctx->RUN_FLAG && !ctx->DEBUG_STOP) {
+		models_on(ctx, m);
+		done = run_for(ctx, min_u32(s->warm, n - executed));
+		executed += done;
+		s->warmed += done;
+
+		cycles = model_cycles(ctx);
+		done = run_for(ctx, min_u32(s->detail, n - executed));
+		executed += done;
+		s->measured += done;
+		if (done == s->detail) {
+			if (num == capacity) {
+				capacity = capacity ? 2 * capacity : 64;
+				cpi = realloc(cpi, capacity * sizeof(double));
+				if (cpi == NULL) {
+					printf("Error: Can't allocate samples\n");
+					exit(-1);
+				}
+			}
+			cpi[num++] = (double)(model_cycles(ctx) - cycles) / done;
+		}
+		else if (done != 0) {
+			partial = (double)(model_cycles(ctx) - cycles) / done;
+		}
+
+		models_off(ctx);
+		executed += run_for(ctx, min_u32(s->period - s->warm - s->detail, n - executed));
+	}
+	models_on(ctx, m);
+
+	if (num == 0 && partial >= 0) {
+		s->windows = 1;
+		s->cpi = partial;
+		s->error = -1;
+	}
+	else {
+		s->windows = num;
+		s->cpi = mean_of(cpi, num, &variance);
+		s->error = num > 1 ? t_95(num - 1) * sqrt(variance / num) : -1;
+	}
+	s->instructions = executed;
+	free(cpi);
+	return executed;
+}
+
+/* deterministic pseudo-random numbers (splitmix64) */
+static uint64_t mix64(uint64_t x)
+{
+	x += 0x9E3779B97F4A7C15ull;
+	x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+	x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+	return x ^ (x >> 31);
+}
+
+static uint64_t next_random(uint64_t *state)
+{
+	*state += 0x9E3779B97F4A7C15ull;
+	return mix64(*state);
+}
+
+/* the fixed random projection of text word index onto dimension d, in [-1, 1) */
+static double projection(uint32_t index, uint32_t d)
+{
+	return (mix64((uint64_t)index * SAMPLE_DIMS + d) >> 11) * (2.0 / 9007199254740992.0) - 1.0;
+}
+
+/***************************************************************/
+/* Project how often each word of text ran since the last call, */
+/* per instruction of the interval, into v (if not NULL), and */
+/* remember the counts in last. */
+/***************************************************************/
+static void interval_vector(sim_context *ctx, uint64_t *last, uint32_t words, uint32_t length, double *v)
+{
+	const uint32_t mask = (1u << STATS_CHUNK_BITS) - 1;
+	uint32_t i, d;
+
+	if (v != NULL) {
+		memset(v, 0, SAMPLE_DIMS * sizeof(double));
+	}
+	block_stats_fold(ctx);
+	for (i = 0; i < words; i++) {
+		const uint64_t *chunk = ctx->PC_COUNT[i >> STATS_CHUNK_BITS];
+		uint64_t delta;
+
+		if (chunk == NULL) {
+			i |= mask;
+			continue;
+		}
+		delta = chunk[i & mask] - last[i];
+		if (delta == 0) {
+			continue;
+		}
+		last[i] = chunk[i & mask];
+		for (d = 0; v != NULL && d < SAMPLE_DIMS; d++) {
+			v[d] += (double)delta / length * projection(i, d);
+		}
+	}
+}
+
+static double distance(const double *a, const double *b)
+{
+	double sum = 0;
+	uint32_t d;
+
+	for (d = 0; d < SAMPLE_DIMS; d++) {
+		sum += (a[d] - b[d]) * (a[d] - b[d]);
+	}
+	return sum;
+}
+
+/***************************************************************/
+/* k-means over n vectors, seeded k-means++ style. Leaves each */
+/* vector's cluster in cluster[] and the centres in centre[]. */
+/***************************************************************/
+static void kmeans(const double *v, uint32_t n, uint32_t k, uint32_t *cluster, double *centre)
+{
+	double *nearest = malloc(n * sizeof(double));
+	uint32_t *size = malloc(k * sizeof(uint32_t));
+	uint64_t random = 1;
+	uint32_t i, c, d, iteration;
+
+	if (nearest == NULL || size == NULL) {
+		printf("Error: Can't allocate sampler\n");
+		exit(-1);
+	}
+	/* each further centre is a vector drawn in proportion to its squared distance from the nearest so far */
+	memcpy(centre, &v[(next_random(&random) % n) * SAMPLE_DIMS], SAMPLE_DIMS * sizeof(double));
+	for (i = 0; i < n; i++) {
+		nearest[i] = distance(&v[i * SAMPLE_DIMS], centre);
+	}
+	for (c = 1; c < k; c++) {
+		double total = 0, pick;
+
+		for (i = 0; i < n; i++) {
+			total += nearest[i];
+		}
+		pick = (next_random(&random) >> 11) * (1.0 / 9007199254740992.0) * total;
+		for (i = 0; i < n - 1 && (pick -= nearest[i]) >= 0; i++);
+		memcpy(&centre[c * SAMPLE_DIMS], &v[i * SAMPLE_DIMS], SAMPLE_DIMS * sizeof(double));
+		for (i = 0; i < n; i++) {
+			double dist = distance(&v[i * SAMPLE_DIMS], &centre[c * SAMPLE_DIMS]);
+			if (dist < nearest[i]) {
+				nearest[i] = dist;
+			}
+		}
+	}
+
+	for (iteration = 0; iteration < SAMPLE_KMEANS_ITERATIONS; iteration++) {
+		int changed = FALSE;
+
+		for (i = 0; i < n; i++) {
+			uint32_t best = 0;
+			double best_dist = distance(&v[i * SAMPLE_DIMS], centre);
+
+			for (c = 1; c < k; c++) {
+				double dist = distance(&v[i * SAMPLE_DIMS], &centre[c * SAMPLE_DIMS]);
+				if (dist < best_dist) {
+					best = c;
+					best_dist = dist;
+				}
+			}
+			if (iteration == 0 || cluster[i] != best) {
+				cluster[i] = best;
+				changed = TRUE;
+			}
+		}
+		if (!changed) {
+			break;
+		}
+		/* an empty cluster keeps its centre */
+		memset(size, 0, k * sizeof(uint32_t));
+		for (i = 0; i < n; i++) {
+			if (size[cluster[i]]++ == 0) {
+				memset(&centre[cluster[i] * SAMPLE_DIMS], 0, SAMPLE_DIMS * sizeof(double));
+			}
+			for (d = 0; d < SAMPLE_DIMS; d++) {
+				centre[cluster[i] * SAMPLE_DIMS + d] += v[i * SAMPLE_DIMS + d];
+			}
+		}
+		for (c = 0; c < k; c++) {
+			for (d = 0; size[c] != 0 && d < SAMPLE_DIMS; d++) {
+				centre[c * SAMPLE_DIMS + d] /= size[c];
+			}
+		}
+	}
+	free(nearest);
+	free(size);
+}
+
+/***************************************************************/
+/* Pick the intervals of each cluster to measure: the one nearest */
+/* its centre, and up to per - 1 more at random. */
+/***************************************************************/
+static void choose_intervals(const double *v, uint32_t n, uint32_t k, const uint32_t *cluster,
+		const double *centre, uint32_t per, uint8_t *chosen)
+{
+	uint32_t *members = malloc(n * sizeof(uint32_t));
+	uint64_t random = 2;
+	uint32_t c, i, count, best, swap;
+
+	if (members == NULL) {
+		printf("Error: Can't allocate sampler\n");
+		exit(-1);
+	}
+	memset(chosen, 0, n);
+	for (c = 0; c < k; c++) {
+		count = best = 0;
+		for (i = 0; i < n; i++) {
+			if (cluster[i] != c) {
+				continue;
+			}
+			if (count != 0 && distance(&v[i * SAMPLE_DIMS], &centre[c * SAMPLE_DIMS])
+					< distance(&v[members[best] * SAMPLE_DIMS], &centre[c * SAMPLE_DIMS])) {
+				best = count;
+			}
+			members[count++] = i;
+		}
+		if (count == 0) {
+			continue;
+		}
+		swap = members[0];
+		members[0] = members[best];
+		members[best] = swap;
+		chosen[members[0]] = TRUE;
+		for (i = 1; i < per && i < count; i++) {
+			uint32_t j = i + next_random(&random) % (count - i);
+			swap = members[i];
+			members[i] = members[j];
+			members[j] = swap;
+			chosen[members[i]] = TRUE;
+		}
+	}
+	free(members);
+}
+
+/***************************************************************/
+/* Stratified estimate over the clusters: each contributes its */
+/* measured mean CPI by its share of the instructions. */
+/***************************************************************/
+static void estimate_clusters(sample_t *s, uint32_t n, uint32_t k, const uint32_t *cluster,
+		const uint32_t *length, const uint8_t *chosen, const double *cpi, uint64_t total)
+{
+	double *x = malloc(n * sizeof(double));
+	double variance = 0, cluster_variance, mean, w;
+	uint32_t c, i, m, size, df = 0;
+	uint64_t instructions;
+	int known = TRUE;
+
+	if (x == NULL) {
+		printf("Error: Can't allocate sampler\n");
+		exit(-1);
+	}
+	s->cpi = 0;
+	s->phases = 0;
+	for (c = 0; c < k; c++) {
+		m = size = 0;
+		instructions = 0;
+		for (i = 0; i < n; i++) {
+			if (cluster[i] != c) {
+				continue;
+			}
+			size++;
+			instructions += length[i];
+			if (chosen[i]) {
+				x[m++] = cpi[i];
+			}
+		}
+		if (size == 0 || m == 0) {
+			continue;
+		}
+		w = (double)instructions / total;
+		s->phases++;
+		mean = mean_of(x, m, &cluster_variance);
+		s->cpi += w * mean;
+		if (m < size) {
+			if (m == 1) {
+				known = FALSE;
+			}
+			variance += w * w * cluster_variance / m * (1.0 - (double)m / size);
+			df += m - 1;
+		}
+	}
+	s->error = !known ? -1 : df != 0 ? t_95(df) * sqrt(variance) : 0;
+	free(x);
+}
+
+/***************************************************************/
+/* SimPoint sampling. The first pass runs with no models and none */
+/* of the recorder, profiler or trace watching, so the second, */
+/* from a snapshot, is the run everything sees. The execution */
+/* statistics are put back to what one run counts. */
+/***************************************************************/
+static uint32_t run_simpoint(sim_context *ctx, sample_t *s, const sample_models_t *m, uint32_t limit)
+{
+	struct profile_struct *profiler = ctx->PROFILER;
+	struct trace_recorder_struct *recorder = ctx->RECORDER;
+	int verbosity = ctx->VERBOSITY;
+	int resuming = ctx->DEBUG != NULL ? ctx->DEBUG->resuming : FALSE;
+	uint32_t resume_pc = ctx->DEBUG != NULL ? ctx->DEBUG->resume_pc : 0;
+	uint64_t op_count[NUM_OPS], op_redirects[NUM_OPS], fused_count[NUM_FUSIONS], native_count;
+	uint32_t words = min_u32(ctx->DECODE_CACHE_SIZE, ctx->PC_COUNT_CHUNKS << STATS_CHUNK_BITS);
+	uint64_t *last = calloc(words + 1, sizeof(uint64_t));
+	uint32_t *length = NULL, *cluster;
+	uint32_t n = 0, capacity = 0, k, i, done, executed = 0, position = 0, offset = 0, target;
+	double *vectors = NULL, *centre, *cpi;
+	uint8_t *chosen;
+	sim_snapshot *start;
+	uint64_t cycles;
+
+	if (last == NULL) {
+		printf("Error: Can't allocate sampler\n");
+		exit(-1);
+	}
+	start = snapshot_take(ctx);
+	ctx->PROFILER = NULL;
+	ctx->RECORDER = NULL;
+	if (ctx->VERBOSITY > VERBOSITY_SUMMARY) {
+		ctx->VERBOSITY = VERBOSITY_SUMMARY;
+	}
+	models_off(ctx);
+	interval_vector(ctx, last, words, 1, NULL);
+	while (executed < limit && ctx->RUN_FLAG && !ctx->DEBUG_STOP) {
+		done = run_for(ctx, min_u32(s->period, limit - executed));
+		if (done == 0) {
+			break;
+		}
+		if (n == capacity) {
+			capacity = capacity ? 2 * capacity : 256;
+			length = realloc(length, capacity * sizeof(uint32_t));
+			vectors = realloc(vectors, capacity * SAMPLE_DIMS * sizeof(double));
+			if (length == NULL || vectors == NULL) {
+				printf("Error: Can't allocate sampler\n");
+				exit(-1);
+			}
+		}
+		interval_vector(ctx, last, words, done, &vectors[n * SAMPLE_DIMS]);
+		length[n++] = done;
+		executed += done;
+	}
+	ctx->PROFILER = profiler;
+	ctx->RECORDER = recorder;
+	ctx->VERBOSITY = verbosity;
+
+	s->instructions = executed;
+	s->intervals = n;
+	if (n == 0 || ctx->DEBUG_STOP) {
+		/* stopped at a breakpoint: that is where the run is */
+		models_on(ctx, m);
+		snapshot_free(start);
+		free(last);
+		free(length);
+		free(vectors);
+		s->windows = s->phases = 0;
+		s->error = -1;
+		return executed;
+	}
+
+	k = min_u32(s->clusters, n);
+	cluster = malloc(n * sizeof(uint32_t));
+	centre = malloc(k * SAMPLE_DIMS * sizeof(double));
+	cpi = calloc(n, sizeof(double));
+	chosen = malloc(n);
+	if (cluster == NULL || centre == NULL || cpi == NULL || chosen == NULL) {
+		printf("Error: Can't allocate sampler\n");
+		exit(-1);
+	}
+	kmeans(vectors, n, k, cluster, centre);
+	choose_intervals(vectors, n, k, cluster, centre, s->per_cluster, chosen);
+
+	/* what one run counts */
+	block_stats_fold(ctx);
+	memcpy(op_count, ctx->OP_COUNT, sizeof(op_count));
+	memcpy(op_redirects, ctx->OP_REDIRECTS, sizeof(op_redirects));
+	memcpy(fused_count, ctx->FUSED_COUNT, sizeof(fused_count));
+	native_count = ctx->NATIVE_COUNT;
+
+	snapshot_restore(ctx, start);
+	snapshot_free(start);
+	if (ctx->DEBUG != NULL) {
+		ctx->DEBUG->resuming = resuming;
+		ctx->DEBUG->resume_pc = resume_pc;
+	}
+	s->windows = 0;
+	for (i = 0; i < n; offset += length[i++]) {
+		if (!chosen[i]) {
+			continue;
+		}
+		target = offset > s->warm ? offset - s->warm : 0;
+		if (position < target) {
+			models_off(ctx);
+			position += run_for(ctx, target - position);
+		}
+		models_on(ctx, m);
+		done = run_for(ctx, offset - position);
+		position += done;
+		s->warmed += done;
+
+		cycles = model_cycles(ctx);
+		done = run_for(ctx, length[i]);
+		position += done;
+		s->measured += done;
+		s->windows++;
+		cpi[i] = done ? (double)(model_cycles(ctx) - cycles) / done : 0;
+	}
+	models_off(ctx);
+	run_for(ctx, executed - position);
+	models_on(ctx, m);
+
+	block_stats_fold(ctx);
+	memcpy(ctx->OP_COUNT, op_count, sizeof(op_count));
+	memcpy(ctx->OP_REDIRECTS, op_redirects, sizeof(op_redirects));
+	memcpy(ctx->FUSED_COUNT, fused_count, sizeof(fused_count));
+	ctx->NATIVE_COUNT = native_count;
+	for (i = 0; i < words; i++) {
+		if (last[i] != 0 || ctx->PC_COUNT[i >> STATS_CHUNK_BITS] != NULL) {
+			*stats_pc_count(ctx, i) = last[i];
+		}
+	}
+
+	estimate_clusters(s, n, k, cluster, length, chosen, cpi, executed);
+	free(last);
+	free(length);
+	free(vectors);
+	free(cluster);
+	free(centre);
+	free(cpi);
+	free(chosen);
+	return executed;
+}
+
+/***************************************************************/
+/* Run up to n instructions sampled, in place of execute(). */
+/***************************************************************/
+uint32_t sample_run(sim_context *ctx, uint32_t n)
+{
+	sample_t *s = ctx->SAMPLER;
+	sample_models_t m = { ctx->PIPELINE, ctx->CACHES, ctx->PREDICTORS, ctx->ENGINE };
+
+	if (m.pipeline == NULL && m.caches == NULL && m.predictors == NULL) {
+		printf("Nothing to sample: turn on the pipeline, cache or predict model.\n");
+		return execute(ctx, n);
+	}
+	if (s->clusters == 0 && (uint64_t)s->warm + s->detail > s->period) {
+		printf("Sampling windows (warm %u + detail %u) are longer than the period %u.\n", s->warm, s->detail, s->period);
+		return execute(ctx, n);
+	}
+	s->instructions = s->warmed = s->measured = 0;
+	s->windows = s->intervals = s->phases = 0;
+	if (s->clusters != 0) {
+		return run_simpoint(ctx, s, &m, n);
+	}
+	return run_systematic(ctx, s, &m, n);
+}
+
+/***************************************************************/
+/* Print the estimate from the last sampled run. */
+/***************************************************************/
+void sample_report(sim_context *ctx)
+{
+	const sample_t *s = ctx->SAMPLER;
+
+	if (s == NULL || s->instructions == 0) {
+		return;
+	}
+	printf("-------------------------------------\n");
+	if (s->clusters == 0) {
+		printf("Sampling (every %u instructions: %u warm, %u detailed)\n", s->period, s->warm, s->detail);
+	}
+	else {
+		printf("Sampling (SimPoint: %u phases in %u intervals of %u, up to %u measured per phase)\n",
+				s->phases, s->intervals, s->period, s->per_cluster);
+	}
+	printf("-------------------------------------\n");
+	printf("Instructions\t: %llu\n", (unsigned long long)s->instructions);
+	printf("Detailed\t: %llu (%.2f%%) in %u windows, %llu warming\n", (unsigned long long)s->measured,
+			100.0 * s->measured / s->instructions, s->windows, (unsigned long long)s->warmed);
+	if (s->windows == 0) {
+		printf("CPI\t\t: no window was measured\n");
+	}
+	else if (s->error < 0) {
+		printf("CPI\t\t: %.3f (too few windows for a confidence interval)\n", s->cpi);
+		printf("Cycles\t\t: %.0f (extrapolated)\n", s->cpi * s->instructions);
+	}
+	else {
+		printf("CPI\t\t: %.3f +/- %.3f (95%% confidence)\n", s->cpi, s->error);
+		printf("Cycles\t\t: %.0f +/- %.0f (extrapolated)\n", s->cpi * s->instructions, s->error * s->instructions);
+	}
+	printf("-------------------------------------\n");
+}
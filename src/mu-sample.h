@@ -0,0 +1,56 @@
+#ifndef MU_SAMPLE_H
+#define MU_SAMPLE_H
+
+#include "mu-mips.h"
+
+/***************************************************************/
+/* Sampled simulation. The timing models (pipeline, caches, */
+/* branch predictors) only see short windows of the run: before */
+/* each window they are warmed for a while and their results */
+/* thrown away, then the window is measured, and the rest of the */
+/* run fast-forwards without them on the fastest engine. */
+/* */
+/* Systematic sampling puts a window at the start of every period. */
+/* SimPoint sampling first runs the whole program functionally, */
+/* cutting it into period-long intervals, each summarised by how */
+/* often every word of text ran (randomly projected down to */
+/* SAMPLE_DIMS numbers). k-means groups the intervals into phases; */
+/* the interval nearest each centre, plus a few drawn at random, */
+/* are then measured whole in a second run from a snapshot. */
+/* */
+/* Both estimate the CPI of the whole run, with a 95% confidence */
+/* interval from the spread between windows (within each phase, */
+/* for SimPoint). A window's cycles are the pipeline's when it is */
+/* on; otherwise one per instruction plus cache stalls plus the */
+/* first predictor's misprediction penalty. */
+/***************************************************************/
+#define SAMPLE_DEFAULT_PERIOD 1000000
+#define SAMPLE_DEFAULT_WARM   20000
+#define SAMPLE_DEFAULT_DETAIL 10000
+#define SAMPLE_DEFAULT_PER_CLUSTER 3	/* SimPoint intervals measured per phase */
+#define SAMPLE_DIMS 15			/* projected size of an interval's vector */
+#define SAMPLE_KMEANS_ITERATIONS 100
+
+typedef struct sample_struct {
+	/* configuration */
+	uint32_t period;		/* instructions */
+	uint32_t warm, detail;		/* systematic: instructions at the start of each period */
+	uint32_t clusters;		/* SimPoint phases, 0 for systematic sampling */
+	uint32_t per_cluster;
+
+	/* the last sampled run */
+	uint64_t instructions;
+	uint64_t warmed, measured;	/* instructions the models saw */
+	uint32_t windows;
+	uint32_t intervals;		/* SimPoint: intervals the run was cut into */
+	uint32_t phases;		/* SimPoint: clusters actually found */
+	double cpi;
+	double error;			/* half width of the interval, < 0 if it can't be told */
+} sample_t;
+
+int sample_configure(sim_context *ctx, const char *spec);
+void sample_free(sample_t *s);
+uint32_t sample_run(sim_context *ctx, uint32_t n);
+void sample_report(sim_context *ctx);
+
+#endif
@@ -0,0 +1,197 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "mu-mips.h"
+#include "mu-block.h"
+#include "mu-snapshot.h"
+
+static uint32_t SNAPSHOT_SERIAL;	/* last snapshot id handed out, shared by all contexts */
+
+/***************************************************************/
+/* Capture the CPU state and memory of ctx. Every page becomes */
+/* shared and copy-on-write, so this costs one page table copy, */
+/* not a copy of memory. The snapshot becomes ctx's base. */
+/***************************************************************/
+sim_snapshot* snapshot_take(sim_context *ctx)
+{
+	sim_snapshot *snap = calloc(1, sizeof(sim_snapshot));
+	uint32_t i, j;
+
+	if (snap == NULL) {
+		printf("Error: Can't allocate snapshot\n");
+		exit(-1);
+	}
+	snap->id = __atomic_add_fetch(&SNAPSHOT_SERIAL, 1, __ATOMIC_RELAXED);
+	snap->state = ctx->CURRENT_STATE;
+	snap->RUN_FLAG = ctx->RUN_FLAG;
+	snap->EXIT_CODE = ctx->EXIT_CODE;
+	snap->INSTRUCTION_COUNT = ctx->INSTRUCTION_COUNT;
+	snap->PROGRAM_SIZE = ctx->PROGRAM_SIZE;
+	snap->PROGRAM_ENTRY = ctx->PROGRAM_ENTRY;
+
+	for (i = 0; i < PAGE_TABLE_SIZE; i++) {
+		page_table_t *table = ctx->PAGE_DIRECTORY[i];
+		if (table == NULL) {
+			continue;
+		}
+		for (j = 0; j < PAGE_TABLE_SIZE; j++) {
+			if (table->page[j] != NULL) {
+				mem_page_ref(table->page[j], table->flags[j]);
+				table->flags[j] = (table->flags[j] & PAGE_FILE) | PAGE_COW;
+				snap->num_pages++;
+			}
+		}
+		snap->PAGE_DIRECTORY[i] = malloc(sizeof(page_table_t));
+		if (snap->PAGE_DIRECTORY[i] == NULL) {
+			printf("Error: Can't allocate snapshot\n");
+			exit(-1);
+		}
+		memcpy(snap->PAGE_DIRECTORY[i], table, sizeof(page_table_t));
+	}
+
+	snap->HOST_MAPPINGS = malloc((ctx->NUM_HOST_MAPPINGS + 1) * sizeof(host_mapping_t *));
+	if (snap->HOST_MAPPINGS == NULL) {
+		printf("Error: Can't allocate snapshot\n");
+		exit(-1);
+	}
+	for (i = 0; i < ctx->NUM_HOST_MAPPINGS; i++) {
+		snap->HOST_MAPPINGS[i] = ctx->HOST_MAPPINGS[i];
+		__atomic_add_fetch(&snap->HOST_MAPPINGS[i]->refs, 1, __ATOMIC_RELAXED);
+	}
+	snap->NUM_HOST_MAPPINGS = ctx->NUM_HOST_MAPPINGS;
+
+	/* no page may be written in place any more */
+	tlb_flush(ctx);
+	ctx->BASE_SNAPSHOT = snap->id;
+	ctx->NUM_DIRTY_PAGES = 0;
+	return snap;
+}
+
+/***************************************************************/
+/* Put the snapshot's page back at address, replacing the page */
+/* ctx dirtied there. */
+/***************************************************************/
+static void restore_page(sim_context *ctx, const sim_snapshot *snap, uint32_t address)
+{
+	uint32_t dir = address >> (PAGE_SHIFT + PAGE_TABLE_BITS);
+	uint32_t page = (address >> PAGE_SHIFT) & (PAGE_TABLE_SIZE - 1);
+	page_table_t *table = ctx->PAGE_DIRECTORY[dir];
+	const page_table_t *saved = snap->PAGE_DIRECTORY[dir];
+	uint32_t offset;
+
+	if (table->page[page] != NULL) {
+		mem_page_release(table->page[page], table->flags[page]);
+	}
+	if (saved != NULL && saved->page[page] != NULL) {
+		table->page[page] = saved->page[page];
+		table->flags[page] = saved->flags[page];
+		mem_page_ref(table->page[page], table->flags[page]);
+	}
+	else {
+		table->page[page] = NULL;
+		table->flags[page] = 0;
+	}
+	if (decode_cache_overlaps(ctx, address, PAGE_SIZE)) {
+		for (offset = 0; offset < PAGE_SIZE; offset += 4) {
+			invalidate_decode_cache(ctx, address + offset);
+		}
+	}
+}
+
+/***************************************************************/
+/* Make ctx's CPU state and memory equal to the snapshot. If the */
+/* snapshot is ctx's base, only the pages dirtied since then are */
+/* put back; otherwise the whole page table is replaced. */
+/***************************************************************/
+void snapshot_restore(sim_context *ctx, const sim_snapshot *snap)
+{
+	uint32_t i, j;
+
+	if (ctx->BASE_SNAPSHOT == snap->id) {
+		for (i = 0; i < ctx->NUM_DIRTY_PAGES; i++) {
+			restore_page(ctx, snap, ctx->DIRTY_PAGES[i]);
+		}
+	}
+	else {
+		free_memory(ctx);
+		for (i = 0; i < PAGE_TABLE_SIZE; i++) {
+			if (snap->PAGE_DIRECTORY[i] == NULL) {
+				continue;
+			}
+			ctx->PAGE_DIRECTORY[i] = malloc(sizeof(page_table_t));
+			if (ctx->PAGE_DIRECTORY[i] == NULL) {
+				printf("Error: Can't allocate page table\n");
+				exit(-1);
+			}
+			memcpy(ctx->PAGE_DIRECTORY[i], snap->PAGE_DIRECTORY[i], sizeof(page_table_t));
+			for (j = 0; j < PAGE_TABLE_SIZE; j++) {
+				uint8_t *page = snap->PAGE_DIRECTORY[i]->page[j];
+				if (page != NULL) {
+					mem_page_ref(page, snap->PAGE_DIRECTORY[i]->flags[j]);
+				}
+			}
+		}
+		ctx->HOST_MAPPINGS = realloc(ctx->HOST_MAPPINGS, (snap->NUM_HOST_MAPPINGS + 1) * sizeof(host_mapping_t *));
+		if (ctx->HOST_MAPPINGS == NULL) {
+			printf("Error: Can't allocate mapping list\n");
+			exit(-1);
+		}
+		for (i = 0; i < snap->NUM_HOST_MAPPINGS; i++) {
+			ctx->HOST_MAPPINGS[i] = snap->HOST_MAPPINGS[i];
+			__atomic_add_fetch(&ctx->HOST_MAPPINGS[i]->refs, 1, __ATOMIC_RELAXED);
+		}
+		ctx->NUM_HOST_MAPPINGS = snap->NUM_HOST_MAPPINGS;
+
+		/* any of the text may differ */
+		if (ctx->DECODE_CACHE_SIZE == snap->PROGRAM_SIZE) {
+			memset(ctx->DECODE_CACHE, 0, ctx->DECODE_CACHE_SIZE * sizeof(MIPS));
+			block_cache_invalidate(ctx);
+		}
+		else {
+			init_decode_cache(ctx, snap->PROGRAM_SIZE);
+		}
+	}
+
+	ctx->CURRENT_STATE = snap->state;
+	ctx->NEXT_STATE = snap->state;
+	ctx->RUN_FLAG = snap->RUN_FLAG;
+	ctx->EXIT_CODE = snap->EXIT_CODE;
+	ctx->INSTRUCTION_COUNT = snap->INSTRUCTION_COUNT;
+	ctx->PROGRAM_SIZE = snap->PROGRAM_SIZE;
+	ctx->PROGRAM_ENTRY = snap->PROGRAM_ENTRY;
+
+	tlb_flush(ctx);
+	ctx->BASE_SNAPSHOT = snap->id;
+	ctx->NUM_DIRTY_PAGES = 0;
+}
+
+/***************************************************************/
+/* Drop the snapshot's references to its pages and mappings. */
+/***************************************************************/
+void snapshot_free(sim_snapshot *snap)
+{
+	uint32_t i, j;
+
+	if (snap == NULL) {
+		return;
+	}
+	for (i = 0; i < PAGE_TABLE_SIZE; i++) {
+		page_table_t *table = snap->PAGE_DIRECTORY[i];
+		if (table == NULL) {
+			continue;
+		}
+		for (j = 0; j < PAGE_TABLE_SIZE; j++) {
+			if (table->page[j] != NULL) {
+				mem_page_release(table->page[j], table->flags[j]);
+			}
+		}
+		free(table);
+	}
+	for (i = 0; i < snap->NUM_HOST_MAPPINGS; i++) {
+		mem_mapping_release(snap->HOST_MAPPINGS[i]);
+	}
+	free(snap->HOST_MAPPINGS);
+	free(snap);
+}
@@ -0,0 +1,34 @@
+#ifndef MU_SNAPSHOT_H
+#define MU_SNAPSHOT_H
+
+#include "mu-mips.h"
+
+/***************************************************************/
+/* Copy-on-write snapshots of a simulator: CPU state plus memory. */
+/* A snapshot shares every page with the simulator it was taken */
+/* from; the simulator copies a shared page before writing it. */
+/* The simulator remembers which pages it dirtied since its base */
+/* snapshot (the last one taken or restored), so restoring that */
+/* snapshot again only touches those pages. A snapshot stays */
+/* valid after its simulator is reset or destroyed, and can be */
+/* restored into any simulator. */
+/***************************************************************/
+typedef struct sim_snapshot_struct {
+	uint32_t id;			/* unique in the process, never 0 */
+	CPU_State state;
+	int RUN_FLAG;
+	uint32_t EXIT_CODE;
+	uint32_t INSTRUCTION_COUNT;
+	uint32_t PROGRAM_SIZE;
+	uint32_t PROGRAM_ENTRY;
+	page_table_t *PAGE_DIRECTORY[PAGE_TABLE_SIZE];
+	host_mapping_t **HOST_MAPPINGS;
+	int NUM_HOST_MAPPINGS;
+	uint32_t num_pages;
+} sim_snapshot;
+
+sim_snapshot* snapshot_take(sim_context *ctx);
+void snapshot_restore(sim_context *ctx, const sim_snapshot *snap);
+void snapshot_free(sim_snapshot *snap);
+
+#endif
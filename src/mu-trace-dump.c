@@ -0,0 +1,94 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <getopt.h>
+
+#include "mu-tracefile.h"
+
+/***************************************************************/
+/* mu-trace-dump: print a binary trace written by "record", one */
+/* instruction per line, or just its totals. */
+/***************************************************************/
+static void usage(const char *name)
+{
+	printf("Usage: %s [options] <trace file>\n", name);
+	printf("  -n, --count <n>\tprint only the first <n> records\n");
+	printf("  -s, --summary\t\tprint only the totals\n");
+	printf("  -h, --help\t\tshow this message\n");
+}
+
+int main(int argc, char *argv[])
+{
+	static const struct option long_options[] = {
+		{ "count", required_argument, NULL, 'n' },
+		{ "summary", no_argument, NULL, 's' },
+		{ "help", no_argument, NULL, 'h' },
+		{ NULL, 0, NULL, 0 }
+	};
+	uint64_t limit = UINT64_MAX, records = 0, loads = 0, stores = 0;
+	int summary = 0, opt;
+	trace_reader_t *r;
+	trace_record_t record;
+	char *end;
+
+	while ((opt = getopt_long(argc, argv, "n:sh", long_options, NULL)) != -1) {
+		switch (opt) {
+			case 'n':
+				limit = strtoull(optarg, &end, 0);
+				if (*end != '\0') {
+					printf("Error: Bad record count %s\n\n", optarg);
+					return 1;
+				}
+				break;
+			case 's':
+				summary = 1;
+				break;
+			case 'h':
+				usage(argv[0]);
+				return 0;
+			default:
+				usage(argv[0]);
+				return 1;
+		}
+	}
+	if (optind != argc - 1) {
+		usage(argv[0]);
+		return 1;
+	}
+	r = trace_reader_open(argv[optind]);
+	if (r == NULL) {
+		return 1;
+	}
+
+	if (!summary) {
+		printf("# entry 0x%08x\n# pc\tword\taddress\tvalue\n", r->header.entry_pc);
+	}
+	while (records < limit && trace_reader_next(r, &record)) {
+		records++;
+		if (TRACE_IS_MEMORY(record.word)) {
+			if (TRACE_IS_STORE(record.word)) {
+				stores++;
+			}
+			else {
+				loads++;
+			}
+		}
+		if (summary) {
+			continue;
+		}
+		if (TRACE_IS_MEMORY(record.word)) {
+			printf("0x%08x\t0x%08x\t%s 0x%08x\t0x%08x\n", record.pc, record.word,
+					TRACE_IS_STORE(record.word) ? "st" : "ld", record.address, record.value);
+		}
+		else {
+			printf("0x%08x\t0x%08x\n", record.pc, record.word);
+		}
+	}
+	if (summary) {
+		printf("%llu instructions, %llu loads, %llu stores\n",
+				(unsigned long long)records, (unsigned long long)loads, (unsigned long long)stores);
+	}
+	trace_reader_close(r);
+	return 0;
+}
@@ -0,0 +1,150 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "mu-mips.h"
+#include "mu-trace.h"
+
+static void sleep_ns(long ns)
+{
+	struct timespec ts = { 0, ns };
+	nanosleep(&ts, NULL);
+}
+
+/***************************************************************/
+/* Writer thread: write out whatever the simulation has published, */
+/* in at most two pieces (the ring may wrap), until asked to stop */
+/* and the ring is empty. */
+/***************************************************************/
+static void* trace_writer(void *arg)
+{
+	trace_recorder_t *r = arg;
+	uint64_t tail = r->tail;
+
+	for (;;) {
+		int stop = __atomic_load_n(&r->stop, __ATOMIC_ACQUIRE);
+		uint64_t head = __atomic_load_n(&r->head, __ATOMIC_ACQUIRE);
+
+		if (head == tail) {
+			if (stop) {
+				break;
+			}
+			sleep_ns(TRACE_WRITER_IDLE_NS);
+			continue;
+		}
+		while (tail != head) {
+			uint32_t start = tail & (TRACE_RING_SIZE - 1);
+			uint32_t n = head - tail < TRACE_RING_SIZE - start ? head - tail : TRACE_RING_SIZE - start;
+
+			if (!r->error && fwrite(&r->ring[start], sizeof(trace_record_t), n, r->fp) != n) {
+				r->error = TRUE;
+			}
+			tail += n;
+		}
+		__atomic_store_n(&r->tail, tail, __ATOMIC_RELEASE);
+	}
+	return NULL;
+}
+
+/***************************************************************/
+/* Start recording every instruction to path, replacing any */
+/* recording in progress. Returns FALSE if the file can't be */
+/* created. */
+/***************************************************************/
+int trace_start(sim_context *ctx, const char *path)
+{
+	trace_recorder_t *r;
+	trace_file_header_t header;
+	FILE *fp;
+
+	trace_stop(ctx);
+	fp = fopen(path, "wb");
+	if (fp == NULL) {
+		printf("Error: Can't open trace file %s\n", path);
+		return FALSE;
+	}
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, TRACE_FILE_MAGIC, sizeof(TRACE_FILE_MAGIC));
+	header.version = TRACE_LE32(TRACE_FILE_VERSION);
+	header.record_size = TRACE_LE32((uint32_t)sizeof(trace_record_t));
+	header.entry_pc = TRACE_LE32(ctx->NEXT_STATE.PC);
+	if (fwrite(&header, sizeof(header), 1, fp) != 1) {
+		printf("Error: Can't write trace file %s\n", path);
+		fclose(fp);
+		return FALSE;
+	}
+
+	r = calloc(1, sizeof(trace_recorder_t));
+	if (r == NULL || (r->ring = malloc(TRACE_RING_SIZE * sizeof(trace_record_t))) == NULL) {
+		printf("Error: Can't allocate trace buffer\n");
+		exit(-1);
+	}
+	r->fp = fp;
+	r->path = malloc(strlen(path) + 1);
+	if (r->path == NULL) {
+		printf("Error: Can't allocate trace buffer\n");
+		exit(-1);
+	}
+	strcpy(r->path, path);
+	if (pthread_create(&r->writer, NULL, trace_writer, r) != 0) {
+		printf("Error: Can't start the trace writer\n");
+		fclose(fp);
+		free(r->path);
+		free(r->ring);
+		free(r);
+		return FALSE;
+	}
+	ctx->RECORDER = r;
+	return TRUE;
+}
+
+/***************************************************************/
+/* Let the writer drain the ring, then close the trace file. */
+/***************************************************************/
+void trace_stop(sim_context *ctx)
+{
+	trace_recorder_t *r = ctx->RECORDER;
+
+	if (r == NULL) {
+		return;
+	}
+	ctx->RECORDER = NULL;
+	__atomic_store_n(&r->stop, TRUE, __ATOMIC_RELEASE);
+	pthread_join(r->writer, NULL);
+	if (fclose(r->fp) != 0) {
+		r->error = TRUE;
+	}
+	if (r->error) {
+		printf("Error: Writing trace file %s failed\n", r->path);
+	}
+	else if (ctx->VERBOSITY >= VERBOSITY_SUMMARY) {
+		printf("Recorded %llu instructions to %s", (unsigned long long)r->head, r->path);
+		if (r->waits != 0) {
+			printf(" (waited for the writer %llu times)", (unsigned long long)r->waits);
+		}
+		printf("\n\n");
+	}
+	free(r->path);
+	free(r->ring);
+	free(r);
+}
+
+/***************************************************************/
+/* The ring looked full: catch up with the writer, and wait for */
+/* it if the ring really is full. */
+/***************************************************************/
+void trace_wait(trace_recorder_t *r)
+{
+	r->tail_seen = __atomic_load_n(&r->tail, __ATOMIC_ACQUIRE);
+	if (r->head - r->tail_seen < TRACE_RING_SIZE) {
+		return;
+	}
+	r->waits++;
+	while (r->head - r->tail_seen == TRACE_RING_SIZE) {
+		sleep_ns(TRACE_PRODUCER_WAIT_NS);
+		r->tail_seen = __atomic_load_n(&r->tail, __ATOMIC_ACQUIRE);
+	}
+}
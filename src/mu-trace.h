@@ -0,0 +1,92 @@
+#ifndef MU_TRACE_H
+#define MU_TRACE_H
+
+#include <pthread.h>
+
+#include "mu-mips.h"
+#include "mu-tracefile.h"
+
+/***************************************************************/
+/* Binary trace recorder. Each executed instruction is appended */
+/* as a fixed-size record (mu-tracefile.h) to a single-producer, */
+/* single-consumer ring buffer; a writer thread drains the ring */
+/* to the trace file in large writes. The simulation thread only */
+/* stores the record and publishes the new head, and waits only */
+/* when the ring is full. */
+/***************************************************************/
+#define TRACE_RING_BITS 16		/* 64K records, 1 MB: stays in cache */
+#define TRACE_RING_SIZE (1u << TRACE_RING_BITS)
+#define TRACE_WRITER_IDLE_NS 500000	/* writer sleep when the ring is empty */
+#define TRACE_PRODUCER_WAIT_NS 50000	/* simulation sleep when the ring is full */
+
+typedef struct trace_recorder_struct {
+	trace_record_t *ring;
+
+	/* producer side: the simulation thread */
+	uint64_t head;			/* records published */
+	uint64_t tail_seen;		/* last tail read, so the full check rarely touches the writer's line */
+	uint64_t waits;			/* times the ring was full */
+	char pad[64];
+
+	/* consumer side: the writer thread */
+	uint64_t tail;			/* records written out */
+	int stop;			/* set to drain the ring and exit */
+	int error;			/* a write failed; later records are dropped */
+
+	FILE *fp;
+	char *path;
+	pthread_t writer;
+} trace_recorder_t;
+
+int trace_start(sim_context *ctx, const char *path);
+void trace_stop(sim_context *ctx);
+void trace_wait(trace_recorder_t *r);
+
+/***************************************************************/
+/* Reserve the record for the instruction about to run at pc and */
+/* fill in what is known before it runs. */
+/***************************************************************/
+static inline trace_record_t* trace_begin(sim_context *ctx, const MIPS *instr, uint32_t pc)
+{
+	trace_recorder_t *r = ctx->RECORDER;
+	uint32_t index = (pc - MEM_TEXT_BEGIN) >> 2;
+	trace_record_t *record;
+
+	if (r->head - r->tail_seen == TRACE_RING_SIZE) {
+		trace_wait(r);
+	}
+	record = &r->ring[r->head & (TRACE_RING_SIZE - 1)];
+	record->pc = pc;
+	/* instr was just fetched through the decode cache, which kept its word */
+	record->word = index < ctx->DECODE_CACHE_SIZE && (pc & 3) == 0 ? ctx->DECODE_WORDS[index] : ctx->UNCACHED_WORD;
+	record->address = 0;
+	record->value = 0;
+	if (instr->op >= OP_LW && instr->op <= OP_SH) {
+		record->address = ctx->CURRENT_STATE.REGS[instr->rs] + instr->immediate;
+		record->value = ctx->CURRENT_STATE.REGS[instr->rt];
+		if (instr->op == OP_SB) {
+			record->value &= 0xFF;
+		}
+		else if (instr->op == OP_SH) {
+			record->value &= 0xFFFF;
+		}
+	}
+	return record;
+}
+
+/* add the loaded value and publish the record */
+static inline void trace_end(sim_context *ctx, const MIPS *instr, trace_record_t *record)
+{
+	trace_recorder_t *r = ctx->RECORDER;
+
+	if (instr->op >= OP_LW && instr->op <= OP_LH) {
+		record->value = ctx->CURRENT_STATE.REGS[instr->rt];
+	}
+	record->pc = TRACE_LE32(record->pc);
+	record->word = TRACE_LE32(record->word);
+	record->address = TRACE_LE32(record->address);
+	record->value = TRACE_LE32(record->value);
+	__atomic_store_n(&r->head, r->head + 1, __ATOMIC_RELEASE);
+}
+
+#endif
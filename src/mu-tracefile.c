@@ -0,0 +1,77 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "mu-tracefile.h"
+
+/***************************************************************/
+/* Open a trace file and check its header. Returns NULL, after */
+/* saying why, if it can't be read. */
+/***************************************************************/
+trace_reader_t* trace_reader_open(const char *path)
+{
+	trace_reader_t *r;
+	trace_file_header_t *h;
+
+	r = calloc(1, sizeof(trace_reader_t));
+	if (r == NULL) {
+		printf("Error: Can't allocate trace reader\n");
+		exit(-1);
+	}
+	r->fp = fopen(path, "rb");
+	if (r->fp == NULL) {
+		printf("Error: Can't open trace file %s\n", path);
+		free(r);
+		return NULL;
+	}
+	h = &r->header;
+	if (fread(h, sizeof(trace_file_header_t), 1, r->fp) != 1 || memcmp(h->magic, TRACE_FILE_MAGIC, sizeof(TRACE_FILE_MAGIC))) {
+		printf("Error: %s is not a trace file\n", path);
+		trace_reader_close(r);
+		return NULL;
+	}
+	h->version = TRACE_LE32(h->version);
+	h->record_size = TRACE_LE32(h->record_size);
+	h->entry_pc = TRACE_LE32(h->entry_pc);
+	if (h->version != TRACE_FILE_VERSION || h->record_size != sizeof(trace_record_t)) {
+		printf("Error: %s has unsupported trace version %u\n", path, h->version);
+		trace_reader_close(r);
+		return NULL;
+	}
+	return r;
+}
+
+/***************************************************************/
+/* Read the next record. Returns 1, or 0 at the end of the trace. */
+/* A record cut short by the end of the file is ignored. */
+/***************************************************************/
+int trace_reader_next(trace_reader_t *r, trace_record_t *record)
+{
+	trace_record_t *next;
+
+	if (r->next == r->count) {
+		r->count = fread(r->buffer, sizeof(trace_record_t), TRACE_READ_RECORDS, r->fp);
+		r->next = 0;
+		if (r->count == 0) {
+			return 0;
+		}
+	}
+	next = &r->buffer[r->next++];
+	record->pc = TRACE_LE32(next->pc);
+	record->word = TRACE_LE32(next->word);
+	record->address = TRACE_LE32(next->address);
+	record->value = TRACE_LE32(next->value);
+	return 1;
+}
+
+void trace_reader_close(trace_reader_t *r)
+{
+	if (r == NULL) {
+		return;
+	}
+	if (r->fp != NULL) {
+		fclose(r->fp);
+	}
+	free(r);
+}
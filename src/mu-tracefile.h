@@ -0,0 +1,70 @@
+#ifndef MU_TRACEFILE_H
+#define MU_TRACEFILE_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+/***************************************************************/
+/* Binary execution trace file, written by the recorder */
+/* (mu-trace.c, "record <file>") and read with the functions */
+/* below or the mu-trace-dump tool. All fields are little-endian. */
+/* */
+/*   header, 32 bytes: */
+/*     char     magic[8]     "MUTRACE\0" */
+/*     uint32_t version      TRACE_FILE_VERSION */
+/*     uint32_t record_size  sizeof(trace_record_t), 16 */
+/*     uint32_t entry_pc     PC when recording started */
+/*     uint32_t reserved[3]  zero */
+/*   then one 16-byte record per executed instruction, in order, */
+/*   up to the end of the file: */
+/*     uint32_t pc */
+/*     uint32_t word         the instruction as fetched */
+/*     uint32_t address      effective address of a load or store */
+/*     uint32_t value        the value stored, or the loaded value */
+/*                           as written to rt (0 if rt is $zero) */
+/*   address and value are 0 for every other instruction; the */
+/*   opcode in word (0x20 to 0x2B) tells loads and stores apart. */
+/***************************************************************/
+#define TRACE_FILE_MAGIC "MUTRACE"
+#define TRACE_FILE_VERSION 1
+
+typedef struct {
+	char magic[8];
+	uint32_t version;
+	uint32_t record_size;
+	uint32_t entry_pc;
+	uint32_t reserved[3];
+} trace_file_header_t;
+
+typedef struct {
+	uint32_t pc;
+	uint32_t word;
+	uint32_t address;
+	uint32_t value;
+} trace_record_t;
+
+/* host <-> file byte order */
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+#define TRACE_LE32(x) __builtin_bswap32(x)
+#else
+#define TRACE_LE32(x) (x)
+#endif
+
+/* opcodes 0x20 to 0x2B are the loads and stores, 0x28 and up store */
+#define TRACE_IS_MEMORY(word) (((word) >> 26) >= 0x20 && ((word) >> 26) <= 0x2B)
+#define TRACE_IS_STORE(word) (((word) >> 26) >= 0x28 && ((word) >> 26) <= 0x2B)
+
+#define TRACE_READ_RECORDS 4096	/* records read from the file at a time */
+
+typedef struct {
+	FILE *fp;
+	trace_file_header_t header;	/* in host byte order */
+	trace_record_t buffer[TRACE_READ_RECORDS];
+	size_t count, next;
+} trace_reader_t;
+
+trace_reader_t* trace_reader_open(const char *path);
+int trace_reader_next(trace_reader_t *r, trace_record_t *record);
+void trace_reader_close(trace_reader_t *r);
+
+#endif